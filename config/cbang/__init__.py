@@ -81,7 +81,16 @@ def configure_deps(conf, local = True, with_openssl = True,
     if conf.CBConfig('event', False): conf.CBConfig('re2', not local)
 
     # EPoll support
-    if conf.CBCheckFunc('epoll_create1'): env.CBConfigDef('HAVE_EPOLL')
+    if conf.CBCheckFunc('epoll_create1'):
+        env.CBConfigDef('HAVE_EPOLL')
+
+        # io_uring support, checked at runtime
+        if conf.CBCheckCHeader('linux/io_uring.h'):
+            env.CBConfigDef('HAVE_IO_URING')
+
+    # Zero-copy file writes
+    if conf.CBCheckCHeader('sys/sendfile.h'):
+        env.CBConfigDef('HAVE_SENDFILE')
 
     if with_openssl: conf.CBConfig('openssl', False, version = '1.1.0')
     conf.CBConfig('v8', False)
@@ -40,10 +40,14 @@ import time
 import textwrap
 import stat
 import shutil
+import gzip
+import hashlib
+import io
+import mimetypes
 
 from SCons.Script import *
 
-resource_version = 2
+resource_version = 3
 
 
 class ResourceContext:
@@ -91,6 +95,59 @@ def is_excluded(exclude, path):
   return exclude != None and exclude.search(path) != None
 
 
+def write_data(ctx, output, out, name, data):
+  prototype = 'extern const unsigned char %s[]' % name
+  write_string(ctx, output, '%s;\n' % prototype)
+  write_string(ctx, out, prototype + ' = {')
+
+  for c in bytearray(data):
+    write_string(ctx, out, '%d,' % c)
+
+  write_string(ctx, out, '0};\n')
+
+
+def compress_gzip(data):
+  buf = io.BytesIO()
+
+  # Zero mtime so builds are reproducible
+  with gzip.GzipFile(fileobj = buf, mode = 'wb', compresslevel = 9,
+                     mtime = 0) as f:
+    f.write(data)
+
+  return buf.getvalue()
+
+
+def compress_lz4(data):
+  import lz4.frame
+  return lz4.frame.compress(
+    data, compression_level = lz4.frame.COMPRESSIONLEVEL_MAX)
+
+
+def get_variants(ctx, data):
+  variants = []
+  if len(data) < ctx.env.get('RESOURCES_COMPRESS_MIN'): return variants
+
+  # A single encoding may be given as a string
+  for encoding in Split(ctx.env.get('RESOURCES_COMPRESS')):
+    if encoding == 'gzip': ext, compress = 'gz', compress_gzip
+    elif encoding == 'lz4': ext, compress = 'lz4', compress_lz4
+    else: raise Exception('Unsupported resource encoding "%s"' % encoding)
+
+    try:
+      encoded = compress(data)
+    except ImportError:
+      if not encoding in ctx.warned:
+        print('WARNING: Python %s module not found, not embedding %s '
+              'resources' % (encoding, encoding))
+        ctx.warned.add(encoding)
+      continue
+
+    # Only keep variants which save space
+    if len(encoded) < len(data): variants.append((ext, encoded))
+
+  return variants
+
+
 def write_resource(ctx, output, data_dir, path, children = None,
                    exclude = None):
   name = os.path.basename(path)
@@ -121,29 +178,24 @@ def write_resource(ctx, output, data_dir, path, children = None,
     print('Writing resource: %s to %s' % (path, out_path))
 
     typeStr = 'File'
-    with open(path, 'rb') as f:
-      prototype = 'extern const unsigned char data%d[]' % id
+    with open(path, 'rb') as f: data = f.read()
+    length = len(data)
+    etag = hashlib.sha256(data).hexdigest()[:16]
+    variants = get_variants(ctx, data)
 
-      write_string(ctx, output, '%s;\n' % prototype)
+    with open(out_path, 'w') as out:
+      start_file(ctx, out)
+      write_data(ctx, output, out, 'data%d' % id, data)
 
-      with open(out_path, 'w') as out:
-        start_file(ctx, out)
+      for ext, encoded in variants:
+        write_data(ctx, output, out, 'data%d_%s' % (id, ext), encoded)
 
-        write_string(ctx, out, prototype + ' = {')
+      end_file(ctx, out)
 
-        while True:
-          count = 0
-          for c in f.read(102400):
-            if not isinstance(c, int): c = ord(c)
-            write_string(ctx, out, '%d,' % c)
-            count += 1
-
-          if count == 0: break
-          length += count
-
-        write_string(ctx, out, '0};\n')
-
-        end_file(ctx, out)
+    for ext, encoded in variants:
+      output.write('extern const FileResource resource%d_%s("%s", '
+                   '(const char *)data%d_%s, %d, "\\"%s-%s\\"");\n' %
+                   (id, ext, name, id, ext, len(encoded), etag, ext))
 
   if children != None: children.append(id)
 
@@ -151,7 +203,16 @@ def write_resource(ctx, output, data_dir, path, children = None,
                (typeStr, id, name))
 
   if is_dir: output.write('children%d' % id)
-  else: output.write('(const char *)data%d, %d' % (id, length))
+  else:
+    contentType = mimetypes.guess_type(name, strict = False)[0]
+    encoded = [ext for ext, _ in variants]
+
+    output.write('(const char *)data%d, %d, "\\"%s\\"", ' %
+                 (id, length, etag))
+    output.write('"%s", ' % contentType if contentType else '0, ')
+    output.write(', '.join(['&resource%d_%s' % (id, ext)
+                            if ext in encoded else '0'
+                            for ext in ('gz', 'lz4')]))
 
   output.write(');\n')
 
@@ -173,6 +234,7 @@ def resources_build(target, source, env):
   ctx.exclude = get_exclude(env)
   ctx.next_id = 0
   ctx.col = 0
+  ctx.warned = set()
 
   target = str(target[0])
 
@@ -230,6 +292,8 @@ def modify_targets(target, source, env):
 def generate(env):
   env.SetDefault(RESOURCES_NS = '')
   env.SetDefault(RESOURCES_EXCLUDES = [r'\.svn', r'~$'])
+  env.SetDefault(RESOURCES_COMPRESS = []) # 'gzip', 'lz4' or a list of both
+  env.SetDefault(RESOURCES_COMPRESS_MIN = 256)
 
   bld = env.Builder(action = resources_build,
                     source_factory = SCons.Node.FS.Entry,
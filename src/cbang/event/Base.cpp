@@ -42,6 +42,7 @@
 #include <cbang/net/Socket.h>
 #include <cbang/os/SysError.h>
 #include <cbang/dns/Base.h>
+#include <cbang/config/Options.h>
 
 using namespace std;
 using namespace cb;
@@ -100,6 +101,22 @@ FDPool &Base::getPool() {
 }
 
 
+void Base::addOptions(Options &options) {
+  options.pushCategory("Event");
+  options.addTarget("event-pool", poolType, "The FD pool implementation.  "
+                    "One of 'epoll', 'io_uring' or 'event'.  If empty, the "
+                    "CBANG_EVENT_POOL environment variable or the platform "
+                    "default is used.");
+  options.addTarget("event-pool-threads", poolThreads, "Number of epoll "
+                    "threads.  If greater than one, FDs are divided between "
+                    "several epoll loops.");
+  options.addTarget("event-pool-balance", poolBalance, "How FDs are assigned "
+                    "to epoll threads.  Either 'round-robin' or "
+                    "'least-loaded'.");
+  options.popCategory();
+}
+
+
 void Base::initPriority(int num) {
   if (event_base_priority_init(base, num))
     THROW("Failed to init event base priority");
@@ -141,6 +158,12 @@ void Base::loopOnce() {
 }
 
 
+void Base::loopUntilExit() {
+  if (event_base_loop(base, EVLOOP_NO_EXIT_ON_EMPTY))
+    THROW("Loop until exit failed");
+}
+
+
 bool Base::loopNonBlock() {
   int ret = event_base_loop(base, EVLOOP_NONBLOCK);
   if (ret == -1) THROW("Loop nonblock failed");
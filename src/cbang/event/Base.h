@@ -35,11 +35,13 @@
 #include "EventFactory.h"
 
 #include <map>
+#include <string>
 
 struct event_base;
 
 
 namespace cb {
+  class Options;
   namespace DNS {class Base;}
 
   namespace Event {
@@ -56,6 +58,10 @@ namespace cb {
       SmartPointer<DNS::Base> dns;
       SmartPointer<FDPool> pool;
 
+      std::string poolType;
+      unsigned poolThreads = 1;
+      std::string poolBalance = "round-robin";
+
     public:
       Base(bool withThreads = false, bool useSystemNS = true,
            int priorities = -1);
@@ -67,6 +73,15 @@ namespace cb {
       DNS::Base &getDNS();
       FDPool &getPool();
 
+      const std::string &getPoolType() const {return poolType;}
+      void setPoolType(const std::string &type) {poolType = type;}
+      unsigned getPoolThreads() const {return poolThreads;}
+      void setPoolThreads(unsigned threads) {poolThreads = threads;}
+      const std::string &getPoolBalance() const {return poolBalance;}
+      void setPoolBalance(const std::string &balance) {poolBalance = balance;}
+
+      void addOptions(Options &options);
+
       void initPriority(int num);
       bool hasPriorities() const {return 1 < getNumPriorities();}
       int getNumPriorities() const;
@@ -77,6 +92,8 @@ namespace cb {
       void dispatch();
       void loop();
       void loopOnce();
+      /// Keep looping, even with no pending events, until loopExit()
+      void loopUntilExit();
       bool loopNonBlock();
       void loopBreak();
       void loopContinue();
@@ -45,6 +45,8 @@
 
 #ifdef _WIN32
 #include <io.h>
+#else
+#include <unistd.h>
 #endif
 
 using namespace std;
@@ -133,6 +135,9 @@ void Buffer::setFlags(uint64_t flags) {
 }
 
 
+bool Buffer::enableLocking() {return !evbuffer_enable_locking(evb, 0);}
+
+
 void Buffer::freeze(bool enable, bool front) {
   if ((enable ? evbuffer_freeze : evbuffer_unfreeze)(evb, front))
     THROW("Failed to " << (enable ? "freeze" : "unfreeze") << " buffer at "
@@ -269,9 +274,8 @@ bool Buffer::readLine(string &s, unsigned maxLength, const string &eol) {
   int index = indexOf(eol);
   if (index < 0 || (maxLength && maxLength < (unsigned)index)) return false;
 
-  ostringstream str;
-  remove(str, index);
-  s = str.str();
+  s.resize(index);
+  if (index) remove(&s[0], index);
 
   drain(eol.length());
 
@@ -299,14 +303,21 @@ void Buffer::add(const char *s) {add(s, strlen(s));}
 void Buffer::add(const string &s) {add(s.data(), s.length());}
 
 
-void Buffer::addFile(const string &path) {
+void Buffer::addFile(const string &path, uint64_t offset, int64_t length) {
   int fd = open(path.c_str(), O_RDONLY);
   if (fd == -1) THROW("Failed to open file " << path);
 
   struct stat buf;
-  if (fstat(fd, &buf)) THROW("Failed to get file size " << path);
+  if (fstat(fd, &buf)) {
+    close(fd);
+    THROW("Failed to get file size " << path);
+  }
 
-  if (evbuffer_add_file(evb, fd, 0, buf.st_size))
+  if ((uint64_t)buf.st_size < offset) offset = buf.st_size;
+  if (length < 0 || (uint64_t)buf.st_size < offset + length)
+    length = buf.st_size - offset;
+
+  if (evbuffer_add_file(evb, fd, offset, length))
     THROW("Failed to add file to buffer: " << path);
 }
 
@@ -331,7 +342,12 @@ void Buffer::callback(int added, int deleted, int orig) {
 }
 
 
-int Buffer::indexOf(const string &s) const {
-  auto ptr = evbuffer_search(evb, s.data(), s.length(), 0);
-  return ptr.pos;
+int Buffer::indexOf(const string &s, unsigned start) const {
+  if (!start) return evbuffer_search(evb, s.data(), s.length(), 0).pos;
+  if (getLength() < start + s.length()) return -1;
+
+  evbuffer_ptr ptr;
+  if (evbuffer_ptr_set(evb, &ptr, start, EVBUFFER_PTR_SET)) return -1;
+
+  return evbuffer_search(evb, s.data(), s.length(), &ptr).pos;
 }
@@ -39,6 +39,7 @@
 
 #include <functional>
 #include <vector>
+#include <cstdint>
 
 struct evbuffer;
 struct evbuffer_cb_entry;
@@ -87,6 +88,10 @@ namespace cb {
       void setCallback(const callback_t &cb, unsigned flags = 0);
 
       void setFlags(uint64_t flags);
+      /// Makes buffer operations, including reference counts taken by
+      /// addRef(), safe across threads.
+      /// @return false if threading is not enabled or already locking.
+      bool enableLocking();
       void freeze(bool enable, bool front);
       void clear();
       void expand(unsigned length);
@@ -119,7 +124,8 @@ namespace cb {
       void add(const char *data, unsigned length);
       void add(const char *s);
       void add(const std::string &s);
-      void addFile(const std::string &path);
+      void addFile(const std::string &path, uint64_t offset = 0,
+                   int64_t length = -1);
 
       void prepend(const Buffer &buf);
       void prepend(const char *data, unsigned length);
@@ -128,7 +134,7 @@ namespace cb {
 
       void callback(int added, int deleted, int orig);
 
-      int indexOf(const std::string &s) const;
+      int indexOf(const std::string &s, unsigned start = 0) const;
     };
   }
 }
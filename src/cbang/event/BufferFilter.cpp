@@ -0,0 +1,365 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "BufferFilter.h"
+#include "Buffer.h"
+
+#include <cbang/Exception.h>
+
+#include <event2/buffer.h>
+
+#include <zlib.h>
+#include <bzlib.h>
+#include <lz4/lz4frame.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace cb;
+using namespace cb::Event;
+
+
+namespace {
+  class Output {
+    evbuffer *evb;
+    evbuffer_iovec vec;
+
+  public:
+    Output(Buffer &out, size_t size) : evb(out.getBuffer()) {
+      if (evbuffer_reserve_space(evb, size, &vec, 1) != 1)
+        THROW("Failed to reserve space");
+    }
+
+    char *data() {return (char *)vec.iov_base;}
+    size_t size() const {return vec.iov_len;}
+
+    void commit(size_t bytes) {
+      vec.iov_len = bytes;
+      evbuffer_commit_space(evb, &vec, 1);
+    }
+  };
+
+
+  size_t outputSize(unsigned length) {
+    return max(16UL * 1024, min((size_t)length, 256UL * 1024));
+  }
+
+
+  class ZLibFilter : public BufferFilter {
+    z_stream z;
+    bool compress;
+    bool ended = false;
+
+  public:
+    ZLibFilter(bool compress, bool gzip, int level) : compress(compress) {
+      memset(&z, 0, sizeof(z));
+
+      int bits = gzip ? 15 + 16 : 15;
+      int ret = compress ?
+        deflateInit2(&z, level, Z_DEFLATED, bits, 8, Z_DEFAULT_STRATEGY) :
+        inflateInit2(&z, bits);
+
+      if (ret != Z_OK) THROW("Failed to initialize zlib: " << zError(ret));
+    }
+
+
+    ~ZLibFilter() {if (compress) deflateEnd(&z); else inflateEnd(&z);}
+
+
+  protected:
+    // From BufferFilter
+    void process(const char *data, unsigned length, Buffer &out,
+                 mode_t mode) override {
+      if (ended) {
+        if (length) THROW("Data after end of zlib stream");
+        return;
+      }
+
+      if (!compress) {
+        if (mode == FILTER_FINISH) THROW("Incomplete zlib stream");
+        if (!length) return;
+      }
+
+      int flush = mode == FILTER_RUN ? Z_NO_FLUSH :
+        (mode == FILTER_FLUSH ? Z_SYNC_FLUSH : Z_FINISH);
+
+      z.next_in = (Bytef *)data;
+      z.avail_in = length;
+
+      while (true) {
+        Output output(out, outputSize(length));
+        z.next_out = (Bytef *)output.data();
+        z.avail_out = output.size();
+
+        int ret = compress ? deflate(&z, flush) : inflate(&z, Z_NO_FLUSH);
+        output.commit(output.size() - z.avail_out);
+
+        if (ret == Z_STREAM_END) {ended = true; break;}
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+          THROW("zlib error: " << (z.msg ? z.msg : zError(ret)));
+
+        // Z_FINISH is only done at Z_STREAM_END
+        if (!z.avail_in && z.avail_out && flush != Z_FINISH) break;
+      }
+    }
+  };
+
+
+  class BZip2Filter : public BufferFilter {
+    bz_stream bz;
+    bool compress;
+    bool ended = false;
+
+  public:
+    BZip2Filter(bool compress, int level) : compress(compress) {
+      memset(&bz, 0, sizeof(bz));
+
+      if (level < 1 || 9 < level) level = 9;
+      int ret = compress ? BZ2_bzCompressInit(&bz, level, 0, 0) :
+        BZ2_bzDecompressInit(&bz, 0, 0);
+
+      if (ret != BZ_OK) THROW("Failed to initialize BZip2: " << ret);
+    }
+
+
+    ~BZip2Filter() {
+      if (compress) BZ2_bzCompressEnd(&bz);
+      else BZ2_bzDecompressEnd(&bz);
+    }
+
+
+  protected:
+    // From BufferFilter
+    void process(const char *data, unsigned length, Buffer &out,
+                 mode_t mode) override {
+      if (ended) {
+        if (length) THROW("Data after end of BZip2 stream");
+        return;
+      }
+
+      if (!compress && mode == FILTER_FINISH)
+        THROW("Incomplete BZip2 stream");
+
+      // BZip2 rejects calls which cannot make progress
+      if (!length && (mode == FILTER_RUN || !compress)) return;
+
+      int action = mode == FILTER_RUN ? BZ_RUN :
+        (mode == FILTER_FLUSH ? BZ_FLUSH : BZ_FINISH);
+
+      bz.next_in = (char *)data;
+      bz.avail_in = length;
+
+      while (true) {
+        Output output(out, outputSize(length));
+        bz.next_out = output.data();
+        bz.avail_out = output.size();
+
+        int ret = compress ? BZ2_bzCompress(&bz, action) :
+          BZ2_bzDecompress(&bz);
+        output.commit(output.size() - bz.avail_out);
+
+        if (ret == BZ_STREAM_END) {ended = true; break;}
+        if (ret < 0) THROW("BZip2 error: " << ret);
+
+        if (compress) {
+          if (action == BZ_RUN && !bz.avail_in) break;
+          if (action == BZ_FLUSH && ret == BZ_RUN_OK) break;
+
+        } else if (!bz.avail_in && bz.avail_out) break;
+      }
+    }
+  };
+
+
+  class LZ4Compressor : public BufferFilter {
+    LZ4F_cctx *ctx = 0;
+    LZ4F_preferences_t prefs;
+    bool started = false;
+    bool ended = false;
+
+  public:
+    LZ4Compressor(int level) {
+      memset(&prefs, 0, sizeof(prefs));
+      prefs.compressionLevel = max(0, level);
+
+      check(LZ4F_createCompressionContext(&ctx, LZ4F_VERSION));
+    }
+
+
+    ~LZ4Compressor() {LZ4F_freeCompressionContext(ctx);}
+
+
+    static size_t check(size_t ret) {
+      if (LZ4F_isError(ret)) THROW("LZ4 error: " << LZ4F_getErrorName(ret));
+      return ret;
+    }
+
+
+  protected:
+    // From BufferFilter
+    void process(const char *data, unsigned length, Buffer &out,
+                 mode_t mode) override {
+      if (ended) {
+        if (length) THROW("Data after end of LZ4 stream");
+        return;
+      }
+
+      if (!started) {
+        Output output(out, LZ4F_HEADER_SIZE_MAX);
+        output.commit(check(LZ4F_compressBegin(ctx, output.data(),
+                                               output.size(), &prefs)));
+        started = true;
+      }
+
+      while (length) {
+        unsigned bytes = min(length, 64U * 1024);
+        Output output(out, LZ4F_compressBound(bytes, &prefs));
+        output.commit(check(LZ4F_compressUpdate(
+          ctx, output.data(), output.size(), data, bytes, 0)));
+
+        data += bytes;
+        length -= bytes;
+      }
+
+      if (mode == FILTER_RUN) return;
+
+      Output output(out, LZ4F_compressBound(0, &prefs));
+      if (mode == FILTER_FLUSH)
+        output.commit(
+          check(LZ4F_flush(ctx, output.data(), output.size(), 0)));
+
+      else {
+        output.commit(
+          check(LZ4F_compressEnd(ctx, output.data(), output.size(), 0)));
+        ended = true;
+      }
+    }
+  };
+
+
+  class LZ4Decompressor : public BufferFilter {
+    LZ4F_dctx *ctx = 0;
+    bool ended = false;
+
+  public:
+    LZ4Decompressor() {
+      LZ4Compressor::check(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION));
+    }
+
+
+    ~LZ4Decompressor() {LZ4F_freeDecompressionContext(ctx);}
+
+
+  protected:
+    // From BufferFilter
+    void process(const char *data, unsigned length, Buffer &out,
+                 mode_t mode) override {
+      if (ended) {
+        if (length) THROW("Data after end of LZ4 stream");
+        return;
+      }
+
+      if (mode == FILTER_FINISH) THROW("Incomplete LZ4 stream");
+
+      while (length) {
+        Output output(out, outputSize(length));
+        size_t outBytes = output.size();
+        size_t inBytes = length;
+
+        size_t ret = LZ4Compressor::check(LZ4F_decompress(
+          ctx, output.data(), &outBytes, data, &inBytes, 0));
+        output.commit(outBytes);
+
+        data += inBytes;
+        length -= inBytes;
+
+        if (!ret) {
+          ended = true;
+          if (length) THROW("Data after end of LZ4 stream");
+        }
+
+        if (!length && outBytes < output.size()) break;
+      }
+    }
+  };
+}
+
+
+void BufferFilter::filter(Buffer &in, Buffer &out) {
+  evbuffer *evb = in.getBuffer();
+
+  while (evbuffer_get_length(evb)) {
+    evbuffer_iovec vec;
+    if (evbuffer_peek(evb, -1, 0, &vec, 1) < 1) THROW("Failed to peek");
+
+    process((const char *)vec.iov_base, vec.iov_len, out, FILTER_RUN);
+    evbuffer_drain(evb, vec.iov_len);
+  }
+}
+
+
+void BufferFilter::filter(const char *data, unsigned length, Buffer &out) {
+  process(data, length, out, FILTER_RUN);
+}
+
+
+SmartPointer<BufferFilter>
+BufferFilter::compressor(Compression compression, int level) {
+  switch (compression) {
+  case Compression::COMPRESSION_NONE: return 0;
+  case Compression::COMPRESSION_BZIP2: return new BZip2Filter(true, level);
+  case Compression::COMPRESSION_ZLIB:
+    return new ZLibFilter(true, false, min(level, 9));
+  case Compression::COMPRESSION_GZIP:
+    return new ZLibFilter(true, true, min(level, 9));
+  case Compression::COMPRESSION_LZ4: return new LZ4Compressor(level);
+  case Compression::COMPRESSION_AUTO: break;
+  }
+
+  THROW("Invalid compression type " << compression);
+}
+
+
+SmartPointer<BufferFilter>
+BufferFilter::decompressor(Compression compression) {
+  switch (compression) {
+  case Compression::COMPRESSION_NONE: return 0;
+  case Compression::COMPRESSION_BZIP2: return new BZip2Filter(false, 0);
+  case Compression::COMPRESSION_ZLIB: return new ZLibFilter(false, false, 0);
+  case Compression::COMPRESSION_GZIP: return new ZLibFilter(false, true, 0);
+  case Compression::COMPRESSION_LZ4: return new LZ4Decompressor;
+  case Compression::COMPRESSION_AUTO: break;
+  }
+
+  THROW("Invalid compression type " << compression);
+}
@@ -0,0 +1,71 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/SmartPointer.h>
+#include <cbang/comp/Compression.h>
+
+
+namespace cb {
+  namespace Event {
+    class Buffer;
+
+    /// Compresses or decompresses Buffer data in place of an iostream
+    /// filter chain.  Input is read from and output written to the
+    /// Buffers' own chains.
+    class BufferFilter {
+    public:
+      virtual ~BufferFilter() {}
+
+      /// Consumes all of @param in and adds any output to @param out
+      void filter(Buffer &in, Buffer &out);
+      void filter(const char *data, unsigned length, Buffer &out);
+      /// Makes all data filtered so far available to the reader.  BZip2
+      /// can only end a block so some output may remain buffered.
+      void flush(Buffer &out) {process(0, 0, out, FILTER_FLUSH);}
+      /// Ends the stream
+      void finish(Buffer &out) {process(0, 0, out, FILTER_FINISH);}
+
+      /// A negative @param level selects the default of the compression
+      static SmartPointer<BufferFilter>
+      compressor(Compression compression, int level = -1);
+      static SmartPointer<BufferFilter> decompressor(Compression compression);
+
+    protected:
+      typedef enum {FILTER_RUN, FILTER_FLUSH, FILTER_FINISH} mode_t;
+
+      virtual void process(const char *data, unsigned length, Buffer &out,
+                           mode_t mode) = 0;
+    };
+  }
+}
@@ -33,11 +33,14 @@
 #include "Connection.h"
 #include "Event.h"
 #include "Server.h"
+#include "HandshakePool.h"
 
 #include <cbang/Catch.h>
+#include <cbang/String.h>
 #include <cbang/net/Socket.h>
 #include <cbang/log/Logger.h>
 #include <cbang/dns/Base.h>
+#include <cbang/time/Timer.h>
 
 using namespace cb::Event;
 using namespace cb;
@@ -47,7 +50,7 @@ using namespace std;
 #define CBANG_LOG_PREFIX "CON" << getID() << ':'
 
 
-uint64_t Connection::nextID = 0;
+atomic<uint64_t> Connection::nextID(0);
 
 
 Connection::Connection(Base &base) : FD(base),
@@ -85,6 +88,14 @@ void Connection::setSocket(const SmartPointer<Socket> &socket) {
 }
 
 
+void Connection::setStats(const SmartPointer<RateSet> &stats) {
+  this->stats = stats;
+#ifdef HAVE_OPENSSL
+  if (getSSL().isSet()) getSSL()->setStats(stats);
+#endif // HAVE_OPENSSL
+}
+
+
 bool Connection::isConnected() const {
   return getFD() != -1 && socket.isSet() && socket->isOpen();
 }
@@ -92,20 +103,23 @@ bool Connection::isConnected() const {
 
 void Connection::accept(const SockAddr &peerAddr,
                         const SmartPointer<Socket> &socket,
-                        const SmartPointer<SSLContext> &sslCtx) {
+                        const SmartPointer<SSLContext> &sslCtx,
+                        bool handshake) {
   if (socket.isNull()) THROW("Socket cannot be null");
 
   LOG_DEBUG(5, "Accepting from " << peerAddr);
   if (stats.isSet()) stats->event("incoming");
 
-  socket->setBlocking(false);
+  if (socket->getBlocking()) socket->setBlocking(false);
 
   SmartPointer<SSL> ssl;
 #ifdef HAVE_OPENSSL
   if (sslCtx.isSet()) {
     ssl = sslCtx->createSSL();
     ssl->setFD(socket->get());
-    ssl->accept();
+    ssl->setStats(stats);
+    if (handshake) ssl->accept();
+    else ssl->setAcceptState();
   }
 #endif // HAVE_OPENSSL
 
@@ -117,6 +131,29 @@ void Connection::accept(const SockAddr &peerAddr,
 }
 
 
+void Connection::handshake(const SmartPointer<HandshakePool> &pool,
+                           function<void (bool)> cb) {
+#ifdef HAVE_OPENSSL
+  if (getSSL().isNull()) THROW("Not a secure connection");
+
+  auto self = SmartPtr(this);
+  auto doneCB = [self, cb] (bool success) {
+    if (!success) self->close();
+    if (cb) cb(success);
+  };
+
+  // Wait for the ClientHello before occupying a handshake thread
+  canRead([self, pool, doneCB] (bool success) {
+    if (success) self->handshakeStep(pool, Timer::now(), doneCB);
+    else doneCB(false);
+  });
+
+#else // HAVE_OPENSSL
+  THROW("Not a secure connection");
+#endif // HAVE_OPENSSL
+}
+
+
 void Connection::connect(
   const string &hostname, uint32_t port, const SockAddr &bind,
   const SmartPointer<SSLContext> &sslCtx, function<void (bool)> cb) {
@@ -131,6 +168,7 @@ void Connection::connect(
     socket->open();
     if (!bind.isNull()) socket->bind(bind);
     socket->setBlocking(false);
+    socket->setNoDelay(true); // Don't hold requests written after handshakes
 
     SmartPointer<SSL> ssl;
 #ifdef HAVE_OPENSSL
@@ -139,6 +177,8 @@ void Connection::connect(
       ssl->setFD(socket->get());
       ssl->setConnectState();
       ssl->setTLSExtHostname(hostname);
+      ssl->setStats(stats);
+      sslCtx->resumeSession(*ssl, hostname + ":" + String(port));
     }
 #endif // HAVE_OPENSSL
 
@@ -195,6 +235,64 @@ void Connection::connect(
 }
 
 
+void Connection::handshakeStep(const SmartPointer<HandshakePool> &pool,
+                               double start, function<void (bool)> cb) {
+#ifdef HAVE_OPENSSL
+  auto self = SmartPtr(this);
+  auto ssl = getSSL();
+  double submitted = Timer::now();
+
+  auto run = [self, ssl, submitted] () {
+    auto &stats = self->stats;
+    if (stats.isSet())
+      stats->event("tls-handshake-wait", Timer::now() - submitted);
+    ssl->accept();
+  };
+
+  auto done = [self, pool, start, cb] (bool success) {
+    self->handshaking = false;
+
+    if (self->stats.isSet())
+      self->stats->event("tls-handshake-queued", pool->getNumQueued());
+
+    // Closed while the step was running, cb() finishes the close
+    if (self->closeDeferred) return cb(false);
+
+    auto ssl = self->getSSL();
+
+    if (success && ssl.isSet()) {
+      auto next = [self, pool, start, cb] (bool success) {
+        if (success && self->isConnected())
+          self->handshakeStep(pool, start, cb);
+        else cb(false);
+      };
+
+      if (ssl->wantsRead())  return self->canRead(next);
+      if (ssl->wantsWrite()) return self->canWrite(next);
+
+      if (self->stats.isSet())
+        self->stats->event("tls-handshake-time", Timer::now() - start);
+    }
+
+    cb(success && ssl.isSet());
+  };
+
+  // The fd and SSL must stay valid until the step completes
+  handshaking = true;
+
+  if (!pool->submit(getBase(), run, done)) {
+    handshaking = false;
+    LOG_DEBUG(3, "TLS handshake queue full");
+    if (stats.isSet()) stats->event("tls-handshake-rejected");
+    cb(false);
+
+  } else if (stats.isSet())
+    stats->event("tls-handshake-queued", pool->getNumQueued());
+
+#endif // HAVE_OPENSSL
+}
+
+
 void Connection::timedout() {
   if (stats.isSet()) stats->event("timedout");
   LOG_DEBUG(3, "Connection timedout");
@@ -203,6 +301,14 @@ void Connection::timedout() {
 
 
 void Connection::close() {
+  if (handshaking) {
+    LOG_DEBUG(4, "Deferring close until handshake step completes");
+    closeDeferred = true;
+    return;
+  }
+
+  closeDeferred = false;
+
   auto self = SmartPtr(this);
   if (server) server->remove(this);
   FD::close();
@@ -40,6 +40,7 @@
 #include <cbang/util/RateSet.h>
 
 #include <functional>
+#include <atomic>
 
 
 namespace cb {
@@ -50,6 +51,7 @@ namespace cb {
 
   namespace Event {
     class Server;
+    class HandshakePool;
 
     class Connection : public FD, public Enum {
       Server *server = 0;
@@ -60,11 +62,15 @@ namespace cb {
       SmartPointer<Socket> socket;
       SockAddr peerAddr;
 
-      static uint64_t nextID;
+      static std::atomic<uint64_t> nextID;
       uint64_t id = ++nextID;
 
       SmartPointer<RateSet> stats;
 
+      // A handshake step is running on another thread, defer close()
+      bool handshaking = false;
+      bool closeDeferred = false;
+
     public:
       Connection(Base &base);
       ~Connection();
@@ -82,11 +88,22 @@ namespace cb {
       uint64_t getID() const {return id;}
 
       const SmartPointer<RateSet> &getStats() const {return stats;}
-      void setStats(const SmartPointer<RateSet> &stats) {this->stats = stats;}
+      void setStats(const SmartPointer<RateSet> &stats);
 
       bool isConnected() const;
+      /// If @param handshake is false call handshake() before any I/O
       void accept(const SockAddr &peer, const SmartPointer<Socket> &socket,
-                  const SmartPointer<SSLContext> &sslCtx);
+                  const SmartPointer<SSLContext> &sslCtx,
+                  bool handshake = true);
+      /**
+       * Run the server side TLS handshake on @param pool.  Records
+       * "tls-handshake-time" and "tls-handshake-wait" as seconds spent in
+       * the whole handshake and waiting in the queue.  "tls-handshake-queued"
+       * samples the pool's queue length when each step is submitted and
+       * completed.  The connection is closed if the handshake fails.
+       */
+      void handshake(const SmartPointer<HandshakePool> &pool,
+                     std::function<void (bool)> cb);
       void connect(const std::string &hostname, uint32_t port,
                    const SockAddr &bind, const SmartPointer<SSLContext> &sslCtx,
                    std::function<void (bool)> cb);
@@ -94,6 +111,8 @@ namespace cb {
       virtual void onConnect() {}
 
     protected:
+      void handshakeStep(const SmartPointer<HandshakePool> &pool,
+                         double start, std::function<void (bool)> cb);
       void timedout();
 
       // From FD
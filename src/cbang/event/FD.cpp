@@ -81,6 +81,7 @@ void FD::setWriteTimeout(unsigned timeout) {writeTimeout = timeout;}
 void FD::read(const SmartPointer<Transfer> transfer) {
   LOG_DEBUG(4, CBANG_FUNC << "() length=" << transfer->getLength());
   transfer->setTimeout(readTimeout);
+  transfer->setTrackProgress(trackProgress);
   base.getPool().read(transfer);
 }
 
@@ -97,6 +98,7 @@ void FD::canRead(Transfer::cb_t cb) {read(new Transfer(fd, ssl, cb));}
 void FD::write(const SmartPointer<Transfer> transfer) {
   LOG_DEBUG(4, CBANG_FUNC << "() length=" << transfer->getLength());
   transfer->setTimeout(writeTimeout);
+  transfer->setTrackProgress(trackProgress);
   base.getPool().write(transfer);
 }
 
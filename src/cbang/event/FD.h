@@ -53,6 +53,7 @@ namespace cb {
 
       unsigned readTimeout  = 0;
       unsigned writeTimeout = 0;
+      bool trackProgress = true;
 
       uint64_t start = Time::now();
       Progress readProgress;
@@ -87,6 +88,11 @@ namespace cb {
 
       uint64_t getStart() const {return start;}
 
+      /// Progress is tracked by default.  FDs whose progress is never read
+      /// can disable it to save work in the FD pool.  Changes only apply to
+      /// transfers queued afterwards.
+      void setTrackProgress(bool x) {trackProgress = x;}
+      bool getTrackProgress() const {return trackProgress;}
       Progress &getReadProgress() {return readProgress;}
       Progress &getWriteProgress() {return writeProgress;}
 
@@ -32,18 +32,27 @@
 
 #include "FDPool.h"
 #include "FDPoolEPoll.h"
+#include "FDPoolIOUring.h"
 #include "FDPoolEvent.h"
+#include "FDPoolSharded.h"
+#include "Base.h"
 
 #include <cbang/os/SystemUtilities.h>
+#include <cbang/log/Logger.h>
 
 using namespace cb::Event;
 using namespace cb;
+using namespace std;
 
 
 SmartPointer<FDPool> FDPool::create(Base &base) {
-  const char *type = SystemUtilities::getenv("CBANG_EVENT_POOL");
+  string type = base.getPoolType();
+  if (type.empty()) {
+    const char *env = SystemUtilities::getenv("CBANG_EVENT_POOL");
+    if (env) type = env;
+  }
 
-  if (!type) {
+  if (type.empty()) {
 #ifdef HAVE_EPOLL
     type = "epoll";
 #else
@@ -51,11 +60,32 @@ SmartPointer<FDPool> FDPool::create(Base &base) {
 #endif
   }
 
-  if (String::toLower(type) == "event") return new FDPoolEvent(base);
+  type = String::toLower(type);
+  if (type == "event") return new FDPoolEvent(base);
 
 #ifdef HAVE_EPOLL
-  if (String::toLower(type) == "epoll") return new FDPoolEPoll(base);
-#endif
+  unsigned threads = base.getPoolThreads();
+
+#ifdef HAVE_IO_URING
+  if (type == "io_uring")
+    try {
+      if (1 < threads)
+        return new FDPoolSharded(base, threads, base.getPoolBalance(), type);
+      return new FDPoolIOUring(base);
+
+    } catch (const Exception &e) {
+      LOG_WARNING("io_uring unavailable, falling back to epoll: "
+                  << e.getMessage());
+      type = "epoll";
+    }
+#endif // HAVE_IO_URING
+
+  if (type == "epoll") {
+    if (1 < threads)
+      return new FDPoolSharded(base, threads, base.getPoolBalance());
+    return new FDPoolEPoll(base);
+  }
+#endif // HAVE_EPOLL
 
   THROW("Unsupported event pool type: " << type);
 }
@@ -45,6 +45,7 @@
 #include <cerrno>
 
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 
 using namespace cb::Event;
@@ -113,8 +114,7 @@ void FDPoolEPoll::FDQueue::updateTimeout(bool wasActive, bool nowActive) {
   else if (!wasActive) {
     last = Time::now();
 
-    if (getTimeout())
-      fdr.getPool().queueTimeout(getNextTimeout(), read, fdr.getFD());
+    if (getTimeout()) fdr.getPool().queueTimeout(*this, getNextTimeout());
   }
 }
 
@@ -128,7 +128,7 @@ void FDPoolEPoll::FDQueue::timeout(uint64_t now) {
     close();
     timedout = true;
 
-  } else fdr.getPool().queueTimeout(getNextTimeout(), read, fdr.getFD());
+  } else fdr.getPool().queueTimeout(*this, getNextTimeout());
 }
 
 
@@ -136,26 +136,39 @@ void FDPoolEPoll::FDQueue::transfer() {
   if (closed || empty()) return;
 
   auto &pool = fdr.getPool();
+  bool track = front()->getTrackProgress();
 
   if (newTransfer) {
     newTransfer = false;
-    cmd_t cmd = read ? CMD_READ_SIZE : CMD_WRITE_SIZE;
-    pool.queueProgress(cmd, fdr.getFD(), Time::now(), front()->getLength());
+
+    if (track) {
+      progress.started = true;
+      progress.finished = false;
+      progress.start = Time::now();
+      progress.size = front()->getLength();
+      progress.bytes = 0;
+    }
   }
 
-  int ret = front()->transfer();
+  int ret = pool.doTransfer(fdr, *front(), read);
 
   if (ret < 0) close();
   else {
     last = Time::now();
+    pool.queueRate(read, ret);
 
-    cmd_t cmd = read ? CMD_READ_PROGRESS : CMD_WRITE_PROGRESS;
-    pool.queueProgress(cmd, fdr.getFD(), last, ret);
+    if (track) {
+      progress.time = last;
+      progress.bytes += ret;
+    }
 
     if (front()->isFinished()) {
-      cmd = read ? CMD_READ_FINISHED : CMD_WRITE_FINISHED;
-      pool.queueProgress(cmd, fdr.getFD(), last, front()->getLength());
-      pool.queueComplete(front());
+      if (track) {
+        progress.finished = true;
+        progress.size = front()->getLength();
+      }
+
+      complete(front());
       pop();
     }
   }
@@ -171,20 +184,40 @@ void FDPoolEPoll::FDQueue::flush() {
   while (!empty()) pop();
   closed = timedout = false;
   last = 0;
+  progress = ProgressUpdate();
+  cancel();
+}
+
+
+void FDPoolEPoll::FDQueue::flushProgress() {
+  if (!progress.isSet()) return;
+  fdr.getPool().queueProgress(read, fdr.getFD(), progress);
+  progress = ProgressUpdate();
 }
 
 
 void FDPoolEPoll::FDQueue::add(const SmartPointer<Transfer> &tran) {
-  if (closed) fdr.getPool().queueComplete(tran);
+  if (closed) complete(tran);
   else push(tran);
 }
 
 
+void FDPoolEPoll::FDQueue::expired(uint64_t now) {
+  fdr.getPool().timeout(fdr, read, now);
+}
+
+
+void FDPoolEPoll::FDQueue::complete(const SmartPointer<Transfer> &tran) {
+  flushProgress(); // Progress must arrive before completion
+  fdr.getPool().queueComplete(tran);
+}
+
+
 void FDPoolEPoll::FDQueue::close() {
   closed = true;
 
   while (!empty()) {
-    fdr.getPool().queueComplete(front());
+    complete(front());
     pop();
   }
 }
@@ -242,15 +275,34 @@ void FDPoolEPoll::FDRec::transfer(unsigned events) {
 void FDPoolEPoll::FDRec::flush() {
   readQ.flush();
   writeQ.flush();
+  secure = false;
+  lastStatus = 0;
+  pool.flushEvents(*this);
   pool.queueFlushed(fd);
 }
 
 
+void FDPoolEPoll::FDRec::flushProgress() {
+  readQ.flushProgress();
+  writeQ.flushProgress();
+}
+
+
+bool FDPoolEPoll::FDRec::statusChanged() {
+  int status = getStatus();
+  if (status == lastStatus) return false;
+  lastStatus = status;
+  return true;
+}
+
+
 void FDPoolEPoll::FDRec::process(cmd_t cmd,
                                  const SmartPointer<Transfer> &tran) {
   if ((cmd == CMD_READ || cmd == CMD_WRITE) && tran->isFinished())
     return pool.queueComplete(tran);
 
+  if (tran.isSet() && tran->getSSL().isSet()) secure = true;
+
   switch (cmd) {
   case CMD_READ:  readQ.add(tran);  break;
   case CMD_WRITE: writeQ.add(tran); break;
@@ -266,19 +318,9 @@ void FDPoolEPoll::FDRec::update() {
   readQ.transferPending();
 
   unsigned newEvents = getEvents();
+  pool.updateEvents(*this, events, newEvents);
   if (events == newEvents) return;
 
-  struct epoll_event ev;
-  memset(&ev, 0, sizeof(ev));
-  ev.events = fd_to_epoll_events(newEvents);
-  ev.data.fd = fd;
-  int op = events ? (newEvents ? EPOLL_CTL_MOD : EPOLL_CTL_DEL) : EPOLL_CTL_ADD;
-
-  if (epoll_ctl(pool.getFD(), op, fd, &ev))
-    if (op != EPOLL_CTL_DEL)
-      LOG_ERROR("epoll_ctl(" << epollOpString(op) << ") failed for fd " << fd
-                << ": " << SysError());
-
   // Update timeouts
   readQ .updateTimeout(events & FD::READ_EVENT,  newEvents & FD::READ_EVENT);
   writeQ.updateTimeout(events & FD::WRITE_EVENT, newEvents & FD::WRITE_EVENT);
@@ -290,17 +332,39 @@ void FDPoolEPoll::FDRec::update() {
 
 
 /******************************************************************************/
-FDPoolEPoll::FDPoolEPoll(Base &base) :
-  event(base.newEvent(this, &FDPoolEPoll::processResults)) {
+FDPoolEPoll::FDPoolEPoll(Base &base, const SmartPointer<Rate> &readRate,
+                         const SmartPointer<Rate> &writeRate, bool withEPoll) :
+  event(base.newEvent(this, &FDPoolEPoll::processResults)),
+  timers(Time::now()), readRate(readRate.isSet() ? readRate : new Rate(60)),
+  writeRate(writeRate.isSet() ? writeRate : new Rate(60)) {
+  wakePending = false;
+
+  // Wakes the epoll thread when commands are queued
+  wakeFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeFD == -1) THROW("Failed to create eventfd: " << SysError());
+
+  if (!withEPoll) return;
 
   fd = epoll_create1(EPOLL_CLOEXEC);
   if (!fd) THROW("Failed to create epoll");
-  start();
+
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = wakeFD;
+  if (epoll_ctl(fd, EPOLL_CTL_ADD, wakeFD, &ev))
+    THROW("Failed to add eventfd to epoll: " << SysError());
 }
 
 
+FDPoolEPoll::FDPoolEPoll(Base &base, const SmartPointer<Rate> &readRate,
+                         const SmartPointer<Rate> &writeRate) :
+  FDPoolEPoll(base, readRate, writeRate, true) {start();}
+
+
 FDPoolEPoll::~FDPoolEPoll() {
   join();
+  if (wakeFD != -1) close(wakeFD);
   if (fd != -1) close(fd);
 }
 
@@ -323,50 +387,73 @@ void FDPoolEPoll::write(const SmartPointer<Transfer> &t) {
 
 void FDPoolEPoll::open(FD &fd) {
   if (fd.getFD() < 0) THROW("Invalid fd " << fd.getFD());
-  if (!fds.insert(fds_t::value_type(fd.getFD(), &fd)).second)
-    THROW("FD " << fd.getFD() << " already in pool");
+
+  auto &e = getEntry(fd.getFD());
+  if (e.fd) THROW("FD " << fd.getFD() << " already in pool");
+  e.fd = &fd;
 }
 
 
 void FDPoolEPoll::flush(int fd) {
   if (fd < 0) THROW("Invalid fd " << fd);
-  if (flushing.find(fd) != flushing.end())
-    THROW("FD " << fd << " already flushing");
 
-  flushing.insert(fd);
+  auto &e = getEntry(fd);
+  if (e.flushing) THROW("FD " << fd << " already flushing");
+
+  e.flushing = true;
   queueCommand(CMD_FLUSH, fd, 0);
 }
 
 
-void FDPoolEPoll::queueTimeout(uint64_t time, bool read, int fd) {
-  if (inTimeoutQ.find({fd, read}) == inTimeoutQ.end()) {
-    inTimeoutQ.insert({fd, read});
-    timeoutQ.push({time, read, fd});
-  }
+void FDPoolEPoll::queueTimeout(FDQueue &q, uint64_t time) {
+  if (!q.isScheduled() || time < q.getTime()) timers.schedule(q, time);
 }
 
 
 void FDPoolEPoll::queueComplete(const SmartPointer<Transfer> &t) {
-  results.push({CMD_COMPLETE, t->getFD(), t, 0, 0});
-  event->activate();
+  queueResult({CMD_COMPLETE, t->getFD(), t, 0, 0});
 }
 
 
 void FDPoolEPoll::queueFlushed(int fd) {
-  results.push({CMD_FLUSHED, fd, 0, 0, 0});
-  event->activate();
+  queueResult({CMD_FLUSHED, fd, 0, 0, 0});
+}
+
+
+void FDPoolEPoll::queueProgress(bool read, int fd,
+                                const ProgressUpdate &progress) {
+  cmd_t cmd = read ? CMD_READ_PROGRESS : CMD_WRITE_PROGRESS;
+  queueResult({cmd, fd, 0, 0, 0, progress});
 }
 
 
-void FDPoolEPoll::queueProgress(cmd_t cmd, int fd, uint64_t time, int value) {
-  results.push({cmd, fd, 0, time, value});
-  event->activate();
+void FDPoolEPoll::queueRate(bool read, uint64_t bytes) {
+  // Accumulated and sent once per iteration
+  (read ? readBytes : writeBytes) += bytes;
 }
 
 
 void FDPoolEPoll::queueStatus(int fd, int status) {
-  results.push({CMD_STATUS, fd, 0, 0, status});
-  event->activate();
+  queueResult({CMD_STATUS, fd, 0, 0, status});
+}
+
+
+void FDPoolEPoll::queueResult(const Command &result) {
+  results.push(result);
+  resultsQueued = true;
+}
+
+
+void FDPoolEPoll::activateResults() {
+  uint64_t now = Time::now();
+
+  if (readBytes) queueResult({CMD_READ_RATE, -1, 0, now, (int)readBytes});
+  if (writeBytes) queueResult({CMD_WRITE_RATE, -1, 0, now, (int)writeBytes});
+  readBytes = writeBytes = 0;
+
+  // One activation per batch of results
+  if (resultsQueued) event->activate();
+  resultsQueued = false;
 }
 
 
@@ -374,14 +461,81 @@ void FDPoolEPoll::queueCommand(cmd_t cmd, int fd,
                                const SmartPointer<Transfer> &tran) {
   LOG_DEBUG(5, CBANG_FUNC << "() fd=" << fd << " cmd=" << cmd);
   cmds.push({cmd, fd, tran});
+  wake();
+}
+
+
+void FDPoolEPoll::wake() {
+  // Only the first command since the last wakeup writes to the eventfd
+  if (wakePending.exchange(true)) return;
+
+  uint64_t one = 1;
+  if (::write(wakeFD, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+    LOG_ERROR("Failed to wake epoll thread: " << SysError());
+}
+
+
+void FDPoolEPoll::clearWake() {
+  // Drain the eventfd before clearing the flag.  Clearing it first lets a
+  // producer's write be consumed here, leaving the flag set with nothing
+  // left to wake on.  Commands queued before the flag is cleared are
+  // picked up by processCommands(), which runs after this.
+  uint64_t count;
+  if (::read(wakeFD, &count, sizeof(count)) == -1 && errno != EAGAIN)
+    LOG_ERROR("Failed to read eventfd: " << SysError());
+
+  wakePending = false;
 }
 
 
 FDPoolEPoll::FDRec &FDPoolEPoll::getFD(int fd) {
-  auto it = pool.find(fd);
-  if (it != pool.end()) return *it->second;
-  auto result = pool.insert(pool_t::value_type(fd, new FDRec(*this, fd)));
-  return *result.first->second;
+  if (fd < 0) THROW("Invalid fd " << fd);
+  if (pool.size() <= (unsigned)fd) pool.resize(fd + 1);
+  if (pool[fd].isNull()) pool[fd] = new FDRec(*this, fd);
+  return *pool[fd];
+}
+
+
+FDPoolEPoll::FDEntry &FDPoolEPoll::getEntry(int fd) {
+  if (fds.size() <= (unsigned)fd) fds.resize(fd + 1);
+  return fds[fd];
+}
+
+
+void FDPoolEPoll::setDirty(FDRec &fdr) {
+  if (fdr.isDirty()) return;
+  fdr.setDirty(true);
+  dirty.push_back(fdr.getFD());
+}
+
+
+void FDPoolEPoll::flushDirty() {
+  for (int fd: dirty) {
+    auto &fdr = *pool[fd];
+    fdr.setDirty(false);
+    fdr.flushProgress();
+    if (fdr.statusChanged()) queueStatus(fd, fdr.getStatus());
+  }
+
+  dirty.clear();
+}
+
+
+void FDPoolEPoll::timeout(FDRec &fdr, bool read, uint64_t now) {
+  fdr.timeout(now, read);
+  setDirty(fdr);
+}
+
+
+void FDPoolEPoll::updateProgress(Progress &p, const ProgressUpdate &update) {
+  if (update.started) {
+    p.reset();
+    p.setStart(update.start);
+    p.setEnd(update.start);
+  }
+
+  if (update.started || update.finished) p.setSize(update.size);
+  if (update.bytes) p.event(update.bytes, update.time);
 }
 
 
@@ -390,56 +544,39 @@ void FDPoolEPoll::processResults() {
     auto &cmd = results.top();
     LOG_DEBUG(5, CBANG_FUNC << "() fd=" << cmd.fd << " cmd=" << cmd.cmd);
 
-    auto it = fds.find(cmd.fd);
-    if (it == fds.end()) {
+    if (cmd.cmd == CMD_READ_RATE || cmd.cmd == CMD_WRITE_RATE) {
+      auto &rate = cmd.cmd == CMD_READ_RATE ? readRate : writeRate;
+      rate->event(cmd.value, cmd.time);
       results.pop();
       continue;
     }
 
-    FD &fd = *it->second;
+    FDEntry *e = (unsigned)cmd.fd < fds.size() ? &fds[cmd.fd] : 0;
 
-    // Drop results from flushing FDs
-    if (flushing.find(cmd.fd) != flushing.end() && cmd.cmd != CMD_FLUSHED) {
+    // Drop results from closed or flushing FDs
+    if (!e || !e->fd || (e->flushing && cmd.cmd != CMD_FLUSHED)) {
       results.pop();
       continue;
     }
 
+    FD &fd = *e->fd;
+
     switch (cmd.cmd) {
     case CMD_FLUSHED:
       Socket::close(cmd.fd);
-      flushing.erase(cmd.fd);
-      fds.erase(cmd.fd);
+      *e = FDEntry();
       break;
 
     case CMD_COMPLETE: TRY_CATCH_ERROR(cmd.tran->complete()); break;
 
     case CMD_READ_PROGRESS:
-      readRate.event(cmd.value, cmd.time);
-      fd.getReadProgress().event(cmd.value, cmd.time);
+      updateProgress(fd.getReadProgress(), cmd.progress);
       break;
 
     case CMD_WRITE_PROGRESS:
-      writeRate.event(cmd.value, cmd.time);
-      fd.getWriteProgress().event(cmd.value, cmd.time);
-      break;
-
-    case CMD_READ_SIZE:
-      fd.getReadProgress().reset();
-      fd.getReadProgress().setSize(cmd.value);
-      fd.getReadProgress().setStart(cmd.time);
-      fd.getReadProgress().setEnd(cmd.time);
-      break;
-
-    case CMD_WRITE_SIZE:
-      fd.getWriteProgress().reset();
-      fd.getWriteProgress().setSize(cmd.value);
-      fd.getWriteProgress().setStart(cmd.time);
-      fd.getWriteProgress().setEnd(cmd.time);
+      updateProgress(fd.getWriteProgress(), cmd.progress);
       break;
 
-    case CMD_READ_FINISHED:  fd.getReadProgress().setSize(cmd.value);  break;
-    case CMD_WRITE_FINISHED: fd.getWriteProgress().setSize(cmd.value); break;
-
     case CMD_STATUS: fd.setStatus(cmd.value); break;
 
     default: LOG_ERROR("Invalid results command");
@@ -450,58 +587,87 @@ void FDPoolEPoll::processResults() {
 }
 
 
-void FDPoolEPoll::run() {
+void FDPoolEPoll::stop() {
+  Thread::stop();
+  wake();
+}
+
+
+void FDPoolEPoll::ready(int fd, unsigned events) {
+  try {
+    auto &fdr = getFD(fd);
+    fdr.transfer(events);
+    setDirty(fdr);
+  } CATCH_ERROR;
+}
+
+
+void FDPoolEPoll::processCommands() {
+  while (!cmds.empty()) {
+    auto &cmd = cmds.top();
+    auto &fdr = getFD(cmd.fd);
+    fdr.process(cmd.cmd, cmd.tran);
+    setDirty(fdr);
+    cmds.pop();
+  }
+}
+
+
+void FDPoolEPoll::processTimeouts() {timers.advance(Time::now());}
+
+
+void FDPoolEPoll::updateEvents(FDRec &fdr, unsigned events,
+                               unsigned newEvents) {
+  if (events == newEvents) return;
+
+  int fd = fdr.getFD();
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = fd_to_epoll_events(newEvents);
+  ev.data.fd = fd;
+  int op = events ? (newEvents ? EPOLL_CTL_MOD : EPOLL_CTL_DEL) : EPOLL_CTL_ADD;
+
+  if (epoll_ctl(this->fd, op, fd, &ev))
+    if (op != EPOLL_CTL_DEL)
+      LOG_ERROR("epoll_ctl(" << epollOpString(op) << ") failed for fd " << fd
+                << ": " << SysError());
+}
+
+
+int FDPoolEPoll::doTransfer(FDRec &fdr, Transfer &tran, bool read) {
+  return tran.transfer();
+}
+
+
+void FDPoolEPoll::waitEvents(unsigned ms) {
   epoll_event records[1024];
 
-  while (!shouldShutdown()) {
-    int count = epoll_wait(this->fd, records, 1024, 100);
-    if (count == -1) {
-      if (errno != EINTR) {
-        LOG_ERROR("epoll_wait() failed");
-        break;
-      }
-    }
+  int count = epoll_wait(fd, records, 1024, ms);
+  if (count == -1) {
+    if (errno != EINTR) THROW("epoll_wait() failed: " << SysError());
+    return;
+  }
 
-    map<int, int> changed;
-
-#define CHECK_STATUS(STMT)                                              \
-    int oldStatus = fd.getStatus();                                     \
-    STMT;                                                               \
-    int newStatus = fd.getStatus();                                     \
-    if (oldStatus != newStatus) changed[fd.getFD()] = newStatus;
-
-    for (int i = 0; i < count; i++)
-      try {
-        unsigned events = epoll_to_fd_events(records[i].events);
-        auto &fd        = getFD(records[i].data.fd);
-        CHECK_STATUS(fd.transfer(events));
-      } CATCH_ERROR;
-
-    // Process pending commands
-    while (!cmds.empty()) {
-      auto &cmd = cmds.top();
-      auto &fd  = getFD(cmd.fd);
-      CHECK_STATUS(fd.process(cmd.cmd, cmd.tran));
-      cmds.pop();
-    }
+  for (int i = 0; i < count; i++)
+    if (records[i].data.fd == wakeFD) clearWake();
+    else ready(records[i].data.fd, epoll_to_fd_events(records[i].events));
+}
 
-    // Process timeouts
-    uint64_t now = Time::now();
-    while (!timeoutQ.empty() && timeoutQ.top().time < now) {
-      auto t = timeoutQ.top();
-      timeoutQ.pop();
-      inTimeoutQ.erase({t.fd, t.read});
-
-      auto it = pool.find(t.fd);
-      if (it != pool.end()) {
-        auto &fd = *it->second;
-        CHECK_STATUS(fd.timeout(now, t.read));
-      }
+
+void FDPoolEPoll::run() {
+  while (!shouldShutdown()) {
+    try {
+      waitEvents(100);
+    } catch (const Exception &e) {
+      LOG_ERROR(e.getMessage());
+      break;
     }
 
-    // Queue status changes
-    for (auto it: changed)
-      queueStatus(it.first, it.second);
+    processCommands();
+    processTimeouts();
+
+    flushDirty();
+    activateResults();
   }
 }
 
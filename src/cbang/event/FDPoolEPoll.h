@@ -41,10 +41,11 @@
 
 #include <cbang/thread/Thread.h>
 #include <cbang/util/SPSCQueue.h>
+#include <cbang/util/TimerWheel.h>
 
-#include <map>
-#include <set>
+#include <vector>
 #include <queue>
+#include <atomic>
 
 
 namespace cb {
@@ -54,6 +55,8 @@ namespace cb {
     class FDPoolEPoll :
       public FDPool, public Thread, public FDPoolEPollCommand::Enum {
       int fd = -1;
+      int wakeFD = -1;
+      std::atomic<bool> wakePending;
 
       SmartPointer<Event> event;
 
@@ -66,41 +69,43 @@ namespace cb {
         STATUS_WRITE_TIMEDOUT = 1 << 7,
       };
 
+      struct ProgressUpdate {
+        bool started = false;
+        bool finished = false;
+        uint64_t start = 0;
+        uint64_t time = 0;
+        uint64_t size = 0;
+        uint64_t bytes = 0;
+
+        bool isSet() const {return started || finished || bytes;}
+      };
+
       struct Command {
         cmd_t cmd;
         int fd;
         SmartPointer<Transfer> tran;
         uint64_t time;
         int value;
+        ProgressUpdate progress;
       };
 
-      struct TimeoutMember {
-        int fd;
-        bool read;
-
-        bool operator<(const TimeoutMember &o) const {
-          if (fd == o.fd) return read < o.read;
-          return fd < o.fd;
-        }
-      };
-
-      struct Timeout {
-        uint64_t time;
-        bool read;
-        int fd;
-
-        bool operator<(const Timeout &o) const {return o.time < time;}
+      struct FDEntry {
+        FD *fd = 0;
+        bool flushing = false;
       };
 
+    protected:
       class FDRec;
 
-      class FDQueue : public std::queue<SmartPointer<Transfer> > {
+      class FDQueue :
+        public std::queue<SmartPointer<Transfer> >, public TimerWheel::Entry {
         FDRec &fdr;
         bool read;
         bool closed = false;
         bool timedout = false;
         uint64_t last = 0;
         bool newTransfer = true;
+        ProgressUpdate progress;
 
       public:
         FDQueue(FDRec &fdr, bool read) : fdr(fdr), read(read) {}
@@ -116,9 +121,14 @@ namespace cb {
         void transfer();
         void transferPending();
         void flush();
+        void flushProgress();
         void add(const SmartPointer<Transfer> &tran);
 
+        // From TimerWheel::Entry
+        void expired(uint64_t now) override;
+
       protected:
+        void complete(const SmartPointer<Transfer> &tran);
         void close();
         void pop();
       };
@@ -127,6 +137,9 @@ namespace cb {
         FDPoolEPoll &pool;
         int fd = -1;
         unsigned events = 0;
+        bool secure = false;
+        bool dirty = false;
+        int lastStatus = 0;
         FDQueue readQ;
         FDQueue writeQ;
 
@@ -135,6 +148,9 @@ namespace cb {
 
         FDPoolEPoll &getPool() {return pool;}
         int getFD() const {return fd;}
+        bool isSecure() const {return secure;}
+        bool isDirty() const {return dirty;}
+        void setDirty(bool dirty) {this->dirty = dirty;}
 
         void timeout(uint64_t now, bool read);
         unsigned getEvents() const;
@@ -142,25 +158,36 @@ namespace cb {
         void update();
         void transfer(unsigned events);
         void flush();
+        void flushProgress();
+        bool statusChanged();
         void process(cmd_t cmd, const SmartPointer<Transfer> &tran);
       };
 
+    private:
       SPSCQueue<Command> cmds;
       SPSCQueue<Command> results;
-      std::set<TimeoutMember> inTimeoutQ;
-      std::priority_queue<Timeout> timeoutQ;
-      std::set<int> flushing;
 
-      typedef std::map<int, SmartPointer<FDRec> > pool_t;
-      pool_t pool;
+      // Used by the epoll thread, indexed by fd
+      TimerWheel timers;
+      std::vector<SmartPointer<FDRec> > pool;
+      std::vector<int> dirty;
+      uint64_t readBytes = 0;
+      uint64_t writeBytes = 0;
+      bool resultsQueued = false;
+
+      // Used by the Base thread, indexed by fd
+      std::vector<FDEntry> fds;
+
+      SmartPointer<Rate> readRate;
+      SmartPointer<Rate> writeRate;
 
-      typedef std::map<int, FD *> fds_t;
-      fds_t fds;
-      Rate readRate = 60;
-      Rate writeRate = 60;
+    protected:
+      FDPoolEPoll(Base &base, const SmartPointer<Rate> &readRate,
+                  const SmartPointer<Rate> &writeRate, bool withEPoll);
 
     public:
-      FDPoolEPoll(Base &base);
+      FDPoolEPoll(Base &base, const SmartPointer<Rate> &readRate = 0,
+                  const SmartPointer<Rate> &writeRate = 0);
       ~FDPoolEPoll();
 
       int getFD() const {return fd;}
@@ -168,26 +195,47 @@ namespace cb {
       // From FDPool
       void setEventPriority(int priority) override;
       int getEventPriority() const override;
-      const Rate &getReadRate()  const override {return readRate;}
-      const Rate &getWriteRate() const override {return writeRate;}
+      const Rate &getReadRate()  const override {return *readRate;}
+      const Rate &getWriteRate() const override {return *writeRate;}
 
       void read(const SmartPointer<Transfer> &t) override;
       void write(const SmartPointer<Transfer> &t) override;
       void open(FD &fd) override;
       void flush(int fd) override;
 
-      void queueTimeout(uint64_t time, bool read, int fd);
+    protected:
+      void queueTimeout(FDQueue &q, uint64_t time);
       void queueComplete(const SmartPointer<Transfer> &t);
       void queueFlushed(int fd);
-      void queueProgress(cmd_t cmd, int fd, uint64_t time, int value);
-
-    protected:
+      void queueProgress(bool read, int fd, const ProgressUpdate &progress);
+      void queueRate(bool read, uint64_t bytes);
       void queueStatus(int fd, int status);
+      void queueResult(const Command &result);
+      void activateResults();
       void queueCommand(cmd_t cmd, int fd, const SmartPointer<Transfer> &tran);
+      void wake();
+      int getWakeFD() const {return wakeFD;}
+      void clearWake();
       FDRec &getFD(int fd);
+      FDEntry &getEntry(int fd);
+      void setDirty(FDRec &fdr);
+      void flushDirty();
+      void timeout(FDRec &fdr, bool read, uint64_t now);
+      void ready(int fd, unsigned events);
+      void processCommands();
+      void processTimeouts();
+      static void updateProgress(Progress &p, const ProgressUpdate &update);
       void processResults();
 
+      // Backend interface
+      virtual void updateEvents(FDRec &fdr, unsigned events,
+                                unsigned newEvents);
+      virtual void flushEvents(FDRec &fdr) {}
+      virtual int doTransfer(FDRec &fdr, Transfer &tran, bool read);
+      virtual void waitEvents(unsigned ms);
+
       // From Thread
+      void stop() override;
       void run() override;
     };
   }
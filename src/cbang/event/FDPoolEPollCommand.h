@@ -51,10 +51,8 @@ CBANG_ENUM(CMD_FLUSHED)
 CBANG_ENUM(CMD_COMPLETE)
 CBANG_ENUM(CMD_READ_PROGRESS)
 CBANG_ENUM(CMD_WRITE_PROGRESS)
-CBANG_ENUM(CMD_READ_SIZE)
-CBANG_ENUM(CMD_WRITE_SIZE)
-CBANG_ENUM(CMD_READ_FINISHED)
-CBANG_ENUM(CMD_WRITE_FINISHED)
+CBANG_ENUM(CMD_READ_RATE)
+CBANG_ENUM(CMD_WRITE_RATE)
 CBANG_ENUM(CMD_STATUS)
 
 #endif // CBANG_ENUM
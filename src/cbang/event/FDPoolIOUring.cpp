@@ -0,0 +1,530 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "FDPoolIOUring.h"
+
+#if defined(HAVE_EPOLL) && defined(HAVE_IO_URING)
+
+#include <cbang/Catch.h>
+#include <cbang/log/Logger.h>
+#include <cbang/os/SysError.h>
+
+#include <functional>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace cb::Event;
+using namespace cb;
+using namespace std;
+
+
+namespace {
+  enum {OP_WAKE = 1, OP_POLL, OP_RECV, OP_CANCEL};
+
+  const unsigned ringEntries = 1024;
+  const unsigned numBuffers  = 128; // Must be a power of two
+  const unsigned bufferSize  = 16 * 1024;
+  const uint32_t tagMask     = 0xffffff;
+
+
+  uint64_t make_data(unsigned op, uint32_t tag, int fd) {
+    return (uint64_t)op << 56 | (uint64_t)(tag & tagMask) << 32 | (uint32_t)fd;
+  }
+
+
+  unsigned data_op(uint64_t data)  {return data >> 56;}
+  uint32_t data_tag(uint64_t data) {return (data >> 32) & tagMask;}
+  int      data_fd(uint64_t data)  {return (int)(uint32_t)data;}
+
+
+  unsigned fd_to_poll_events(unsigned events) {
+    return
+      ((FD::READ_EVENT  & events) ? POLLIN  : 0) |
+      ((FD::WRITE_EVENT & events) ? POLLOUT : 0);
+  }
+
+
+  unsigned poll_to_fd_events(unsigned events) {
+    if (events & (POLLERR | POLLHUP)) return FD::READ_EVENT | FD::WRITE_EVENT;
+
+    return
+      ((events & POLLIN)  ? FD::READ_EVENT  : 0) |
+      ((events & POLLOUT) ? FD::WRITE_EVENT : 0);
+  }
+
+
+  void *map_memory(size_t size, int fd = -1, off_t offset = 0) {
+    int flags = fd == -1 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED;
+    void *ptr = mmap(0, size, PROT_READ | PROT_WRITE, flags | MAP_POPULATE,
+                     fd, offset);
+    if (ptr == MAP_FAILED) THROW("mmap() failed: " << SysError());
+    return ptr;
+  }
+}
+
+
+/******************************************************************************/
+class FDPoolIOUring::Ring {
+  int fd = -1;
+
+  struct Mapping {
+    void *ptr = 0;
+    size_t size = 0;
+  };
+
+  Mapping sqRing;
+  Mapping cqRing;
+  Mapping sqeMem;
+  Mapping bufRingMem;
+  Mapping bufMem;
+
+  unsigned *sqHead;
+  unsigned *sqTail;
+  unsigned *sqArray;
+  unsigned sqMask;
+  unsigned sqEntries;
+  unsigned sqeTail = 0;
+  io_uring_sqe *sqes;
+
+  unsigned *cqHead;
+  unsigned *cqTail;
+  unsigned cqMask;
+  io_uring_cqe *cqes;
+
+  io_uring_buf_ring *bufRing;
+  uint16_t bufTail = 0;
+
+public:
+  Ring() {
+    try {
+      init();
+    } catch (...) {
+      release();
+      throw;
+    }
+  }
+
+
+  ~Ring() {release();}
+
+
+  void init() {
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = ringEntries * 4;
+
+    fd = syscall(__NR_io_uring_setup, ringEntries, &p);
+    if (fd < 0) THROW("io_uring_setup() failed: " << SysError());
+
+    if (!(p.features & IORING_FEAT_EXT_ARG) ||
+        !(p.features & IORING_FEAT_NODROP))
+      THROW("io_uring lacks required features");
+
+    checkOps();
+
+    // Map rings
+    sqRing.size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRing.size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      sqRing.size = max(sqRing.size, cqRing.size);
+      sqRing.ptr = map_memory(sqRing.size, fd, IORING_OFF_SQ_RING);
+
+    } else {
+      sqRing.ptr = map_memory(sqRing.size, fd, IORING_OFF_SQ_RING);
+      cqRing.ptr = map_memory(cqRing.size, fd, IORING_OFF_CQ_RING);
+    }
+
+    sqeMem.size = p.sq_entries * sizeof(io_uring_sqe);
+    sqeMem.ptr = map_memory(sqeMem.size, fd, IORING_OFF_SQES);
+
+    char *sq = (char *)sqRing.ptr;
+    char *cq = (char *)(cqRing.ptr ? cqRing.ptr : sqRing.ptr);
+
+    sqHead    = (unsigned *)(sq + p.sq_off.head);
+    sqTail    = (unsigned *)(sq + p.sq_off.tail);
+    sqArray   = (unsigned *)(sq + p.sq_off.array);
+    sqMask    = *(unsigned *)(sq + p.sq_off.ring_mask);
+    sqEntries = p.sq_entries;
+    sqes      = (io_uring_sqe *)sqeMem.ptr;
+    sqeTail   = *sqTail;
+
+    cqHead = (unsigned *)(cq + p.cq_off.head);
+    cqTail = (unsigned *)(cq + p.cq_off.tail);
+    cqMask = *(unsigned *)(cq + p.cq_off.ring_mask);
+    cqes   = (io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    // Register receive buffers
+    bufRingMem.size = numBuffers * sizeof(io_uring_buf);
+    bufRingMem.ptr = map_memory(bufRingMem.size);
+    bufRing = (io_uring_buf_ring *)bufRingMem.ptr;
+
+    bufMem.size = numBuffers * bufferSize;
+    bufMem.ptr = map_memory(bufMem.size);
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)bufRing;
+    reg.ring_entries = numBuffers;
+    reg.bgid = 0;
+
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PBUF_RING, &reg,
+                1))
+      THROW("Failed to register io_uring buffer ring: " << SysError());
+
+    for (unsigned i = 0; i < numBuffers; i++) recycle(i);
+  }
+
+
+  void checkOps() {
+    const unsigned numOps = 256;
+    vector<char> mem(sizeof(io_uring_probe) + numOps *
+                     sizeof(io_uring_probe_op));
+    io_uring_probe *probe = (io_uring_probe *)mem.data();
+
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe,
+                numOps))
+      THROW("io_uring probe failed: " << SysError());
+
+    unsigned ops[] = {IORING_OP_POLL_ADD, IORING_OP_POLL_REMOVE,
+                      IORING_OP_ASYNC_CANCEL, IORING_OP_RECV};
+
+    for (auto op: ops)
+      if (probe->ops_len <= op ||
+          !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+        THROW("io_uring op " << op << " not supported");
+  }
+
+
+  void release() {
+    Mapping *maps[] = {&sqRing, &cqRing, &sqeMem, &bufRingMem, &bufMem};
+    for (auto map: maps)
+      if (map->ptr) munmap(map->ptr, map->size);
+
+    if (fd != -1) close(fd);
+    fd = -1;
+  }
+
+
+  io_uring_sqe &getSQE() {
+    if (sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == sqEntries) {
+      enter(0, false);
+
+      if (sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == sqEntries)
+        THROW("io_uring submission queue full");
+    }
+
+    unsigned index = sqeTail++ & sqMask;
+    sqArray[index] = index;
+
+    io_uring_sqe &sqe = sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+
+    return sqe;
+  }
+
+
+  void enter(unsigned ms, bool wait) {
+    // Publish queued SQEs
+    __atomic_store_n(sqTail, sqeTail, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+
+    __kernel_timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+
+    io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)&ts;
+
+    unsigned flags = IORING_ENTER_EXT_ARG;
+    if (wait) flags |= IORING_ENTER_GETEVENTS;
+
+    int ret = syscall(__NR_io_uring_enter, fd, toSubmit, wait ? 1 : 0, flags,
+                      &arg, sizeof(arg));
+
+    if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY &&
+        errno != EAGAIN)
+      THROW("io_uring_enter() failed: " << SysError());
+  }
+
+
+  void reap(function<void (uint64_t, int, unsigned)> cb) {
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+      io_uring_cqe &cqe = cqes[head & cqMask];
+      uint64_t data = cqe.user_data;
+      int res = cqe.res;
+      unsigned flags = cqe.flags;
+
+      // Free the CQE before the callback, it may submit more work
+      __atomic_store_n(cqHead, ++head, __ATOMIC_RELEASE);
+
+      cb(data, res, flags);
+    }
+  }
+
+
+  const char *getBuffer(unsigned bid) const {
+    return (const char *)bufMem.ptr + bid * bufferSize;
+  }
+
+
+  void recycle(unsigned bid) {
+    // Not bufRing->bufs, its offset is wrong in C++ due to an empty struct
+    io_uring_buf &buf = ((io_uring_buf *)bufRing)[bufTail & (numBuffers - 1)];
+    buf.addr = (uint64_t)getBuffer(bid);
+    buf.len  = bufferSize;
+    buf.bid  = bid;
+
+    __atomic_store_n(&bufRing->tail, ++bufTail, __ATOMIC_RELEASE);
+  }
+};
+
+
+/******************************************************************************/
+FDPoolIOUring::FDPoolIOUring(Base &base, const SmartPointer<Rate> &readRate,
+                             const SmartPointer<Rate> &writeRate) :
+  FDPoolEPoll(base, readRate, writeRate, false), ring(new Ring) {
+  armWake();
+  start();
+}
+
+
+FDPoolIOUring::~FDPoolIOUring() {
+  join(); // Must stop before the ring is freed
+}
+
+
+FDPoolIOUring::IORec &FDPoolIOUring::getRec(int fd) {
+  if (recs.size() <= (unsigned)fd) recs.resize(fd + 1);
+  if (recs[fd].isNull()) recs[fd] = new IORec;
+  return *recs[fd];
+}
+
+
+FDPoolIOUring::IORec *FDPoolIOUring::findRec(int fd) {
+  return (unsigned)fd < recs.size() ? recs[fd].get() : 0;
+}
+
+
+void FDPoolIOUring::armWake() {
+  io_uring_sqe &sqe = ring->getSQE();
+  sqe.opcode = IORING_OP_POLL_ADD;
+  sqe.fd = getWakeFD();
+  sqe.poll32_events = POLLIN;
+  sqe.user_data = make_data(OP_WAKE, 0, getWakeFD());
+}
+
+
+void FDPoolIOUring::addPoll(int fd, IORec &r, unsigned events) {
+  // One-shot polls are rearmed by update() which gives level triggering
+  io_uring_sqe &sqe = ring->getSQE();
+  sqe.opcode = IORING_OP_POLL_ADD;
+  sqe.fd = fd;
+  sqe.poll32_events = fd_to_poll_events(events);
+  sqe.user_data = make_data(OP_POLL, ++r.pollSeq, fd);
+  r.pollEvents = events;
+}
+
+
+void FDPoolIOUring::removePoll(int fd, IORec &r) {
+  io_uring_sqe &sqe = ring->getSQE();
+  sqe.opcode = IORING_OP_POLL_REMOVE;
+  sqe.fd = -1;
+  sqe.addr = make_data(OP_POLL, r.pollSeq, fd);
+  sqe.user_data = make_data(OP_CANCEL, 0, fd);
+
+  r.pollSeq++; // Ignore any further completions
+  r.pollEvents = 0;
+}
+
+
+void FDPoolIOUring::armRecv(int fd, IORec &r) {
+  io_uring_sqe &sqe = ring->getSQE();
+  sqe.opcode = IORING_OP_RECV;
+  sqe.fd = fd;
+  sqe.flags = IOSQE_BUFFER_SELECT;
+  sqe.buf_group = 0;
+  if (multishot) sqe.ioprio = IORING_RECV_MULTISHOT;
+  else sqe.len = bufferSize;
+  sqe.user_data = make_data(OP_RECV, r.gen, fd);
+  r.recv = RECV_ARMED;
+}
+
+
+void FDPoolIOUring::cancelRecv(int fd, IORec &r) {
+  io_uring_sqe &sqe = ring->getSQE();
+  sqe.opcode = IORING_OP_ASYNC_CANCEL;
+  sqe.fd = -1;
+  sqe.addr = make_data(OP_RECV, r.gen, fd);
+  sqe.user_data = make_data(OP_CANCEL, 0, fd);
+  r.recv = RECV_CANCELING;
+}
+
+
+void FDPoolIOUring::complete(uint64_t data, int res, unsigned flags) {
+  unsigned op = data_op(data);
+  int fd = data_fd(data);
+
+  if (op == OP_WAKE) {
+    clearWake();
+    return armWake();
+  }
+
+  if (op == OP_CANCEL) return;
+
+  IORec *rec = findRec(fd);
+
+  if (op == OP_POLL) {
+    if (!rec || data_tag(data) != (rec->pollSeq & tagMask)) return; // Stale
+
+    rec->pollEvents = 0;
+    if (res == -ECANCELED) return;
+
+    return ready(fd, res < 0 ? FD::READ_EVENT | FD::WRITE_EVENT :
+                 poll_to_fd_events(res));
+  }
+
+  if (op != OP_RECV) THROW("Invalid io_uring op " << op);
+
+  bool current = rec && data_tag(data) == (rec->gen & tagMask);
+
+  if (current) {
+    IORec &r = *rec;
+
+    if (0 < res && (flags & IORING_CQE_F_BUFFER))
+      r.input.add(ring->getBuffer(flags >> IORING_CQE_BUFFER_SHIFT), res);
+    else if (!res) r.eof = true;
+    else if (res == -EINVAL && multishot) {
+      LOG_WARNING("io_uring multishot receive not supported");
+      multishot = false;
+
+    } else if (res < 0 && res != -ENOBUFS && res != -ECANCELED) {
+      LOG_DEBUG(4, "io_uring recv failed on fd=" << fd << ": "
+                << SysError(-res));
+      r.eof = true;
+    }
+
+    if (!(flags & IORING_CQE_F_MORE)) r.recv = RECV_IDLE;
+  }
+
+  if (flags & IORING_CQE_F_BUFFER)
+    ring->recycle(flags >> IORING_CQE_BUFFER_SHIFT);
+
+  if (current) ready(fd, FD::READ_EVENT);
+}
+
+
+void FDPoolIOUring::updateEvents(FDRec &fdr, unsigned events,
+                                 unsigned newEvents) {
+  int fd = fdr.getFD();
+  IORec &r = getRec(fd);
+
+  // FDs without SSL are read through the buffer ring
+  bool useRecv = !fdr.isSecure();
+  unsigned pollEvents = newEvents & (FD::READ_EVENT | FD::WRITE_EVENT);
+  if (useRecv) pollEvents &= ~FD::READ_EVENT;
+
+  if (pollEvents != r.pollEvents) {
+    if (r.pollEvents) removePoll(fd, r);
+    if (pollEvents) addPoll(fd, r, pollEvents);
+  }
+
+  if (useRecv && (newEvents & FD::READ_EVENT)) {
+    // Data left over from a previous receive will not be announced again
+    if (!r.input.isEmpty() || r.eof) {
+      if (!r.pending) pending.push_back(fd);
+      r.pending = true;
+
+    } else if (r.recv == RECV_IDLE) armRecv(fd, r);
+
+  } else if (r.recv == RECV_ARMED) cancelRecv(fd, r);
+}
+
+
+void FDPoolIOUring::flushEvents(FDRec &fdr) {
+  int fd = fdr.getFD();
+  IORec &r = getRec(fd);
+
+  // Pending ops hold a reference to the socket so it must not outlive them
+  if (r.pollEvents) removePoll(fd, r);
+  if (r.recv == RECV_ARMED) cancelRecv(fd, r);
+
+  // Ignore any further completions for this FD
+  r.gen++;
+  r.pollSeq++;
+  r.recv = RECV_IDLE;
+  r.eof = false;
+  r.input.clear();
+  r.pending = false;
+}
+
+
+int FDPoolIOUring::doTransfer(FDRec &fdr, Transfer &tran, bool read) {
+  if (!read || fdr.isSecure()) return tran.transfer();
+
+  IORec &r = getRec(fdr.getFD());
+  return tran.transferFrom(r.input, r.eof);
+}
+
+
+void FDPoolIOUring::waitEvents(unsigned ms) {
+  ring->enter(pending.empty() ? ms : 0, pending.empty());
+  ring->reap([this] (uint64_t data, int res, unsigned flags) {
+    TRY_CATCH_ERROR(complete(data, res, flags));
+  });
+
+  readyFDs.swap(pending);
+
+  for (int fd: readyFDs) {
+    IORec &r = getRec(fd);
+    if (!r.pending) continue; // Flushed
+    r.pending = false;
+    ready(fd, FD::READ_EVENT);
+  }
+
+  readyFDs.clear();
+}
+
+#endif // HAVE_EPOLL && HAVE_IO_URING
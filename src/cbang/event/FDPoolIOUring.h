@@ -0,0 +1,99 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/config.h>
+
+#if defined(HAVE_EPOLL) && defined(HAVE_IO_URING)
+
+#include "FDPoolEPoll.h"
+#include "Buffer.h"
+
+#include <vector>
+
+
+namespace cb {
+  namespace Event {
+    /**
+     * Waits on io_uring instead of epoll.  Interest changes are submitted
+     * with the wait so no epoll_ctl() calls are made.  FDs without SSL are
+     * read with multishot receives into a registered buffer ring.
+     */
+    class FDPoolIOUring : public FDPoolEPoll {
+      class Ring;
+      SmartPointer<Ring> ring;
+
+      enum recv_state_t {RECV_IDLE, RECV_ARMED, RECV_CANCELING};
+
+      struct IORec {
+        uint32_t gen = 0;
+        uint32_t pollSeq = 0;
+        unsigned pollEvents = 0;
+        recv_state_t recv = RECV_IDLE;
+        bool eof = false;
+        bool pending = false;
+        Buffer input;
+      };
+
+      // Indexed by fd
+      std::vector<SmartPointer<IORec> > recs;
+      std::vector<int> pending;
+      std::vector<int> readyFDs;
+      bool multishot = true;
+
+    public:
+      FDPoolIOUring(Base &base, const SmartPointer<Rate> &readRate = 0,
+                    const SmartPointer<Rate> &writeRate = 0);
+      ~FDPoolIOUring();
+
+    protected:
+      IORec &getRec(int fd);
+      IORec *findRec(int fd);
+      void armWake();
+      void addPoll(int fd, IORec &r, unsigned events);
+      void removePoll(int fd, IORec &r);
+      void armRecv(int fd, IORec &r);
+      void cancelRecv(int fd, IORec &r);
+      void complete(uint64_t data, int res, unsigned flags);
+
+      // From FDPoolEPoll
+      void updateEvents(FDRec &fdr, unsigned events,
+                        unsigned newEvents) override;
+      void flushEvents(FDRec &fdr) override;
+      int doTransfer(FDRec &fdr, Transfer &tran, bool read) override;
+      void waitEvents(unsigned ms) override;
+    };
+  }
+}
+
+#endif // HAVE_EPOLL && HAVE_IO_URING
@@ -0,0 +1,158 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "FDPoolSharded.h"
+
+#ifdef HAVE_EPOLL
+
+#include "FDPoolEPoll.h"
+#include "FDPoolIOUring.h"
+
+#include <cbang/String.h>
+#include <cbang/log/Logger.h>
+
+using namespace cb::Event;
+using namespace cb;
+using namespace std;
+
+
+FDPoolSharded::FDPoolSharded(Base &base, unsigned threads,
+                             const string &balance, const string &type) :
+  readRate(new Rate(60)), writeRate(new Rate(60)) {
+  if (!threads) THROW("Must have at least one epoll thread");
+
+  string mode = String::toLower(balance);
+  if (mode == "least-loaded") leastLoaded = true;
+  else if (mode != "round-robin")
+    THROW("Invalid event pool balance mode: " << balance);
+
+  bool ioUring = String::toLower(type) == "io_uring";
+#ifndef HAVE_IO_URING
+  if (ioUring) THROW("io_uring event pool not supported");
+#endif
+
+  LOG_DEBUG(3, "Starting " << threads << " " << type << " threads, balance="
+            << mode);
+
+  // All shards deliver results on the Base thread so they can share rates
+  for (unsigned i = 0; i < threads; i++) {
+    SmartPointer<FDPoolEPoll> pool;
+
+#ifdef HAVE_IO_URING
+    if (ioUring) pool = new FDPoolIOUring(base, readRate, writeRate);
+    else
+#endif
+      pool = new FDPoolEPoll(base, readRate, writeRate);
+
+    shards.push_back({pool, 0});
+  }
+}
+
+
+FDPoolSharded::~FDPoolSharded() {}
+
+
+void FDPoolSharded::setEventPriority(int priority) {
+  for (auto &shard: shards) shard.pool->setEventPriority(priority);
+}
+
+
+int FDPoolSharded::getEventPriority() const {
+  return shards.front().pool->getEventPriority();
+}
+
+
+void FDPoolSharded::read(const SmartPointer<Transfer> &t) {
+  if (t.isNull()) THROW("Transfer cannot be null");
+  get(t->getFD()).read(t);
+}
+
+
+void FDPoolSharded::write(const SmartPointer<Transfer> &t) {
+  if (t.isNull()) THROW("Transfer cannot be null");
+  get(t->getFD()).write(t);
+}
+
+
+void FDPoolSharded::open(FD &fd) {
+  if (fd.getFD() < 0) THROW("Invalid fd " << fd.getFD());
+
+  unsigned i = select();
+  if (!fds.insert(fds_t::value_type(fd.getFD(), i)).second)
+    THROW("FD " << fd.getFD() << " already in pool");
+
+  try {
+    shards[i].pool->open(fd);
+  } catch (...) {
+    fds.erase(fd.getFD());
+    throw;
+  }
+
+  shards[i].count++;
+}
+
+
+void FDPoolSharded::flush(int fd) {
+  auto it = fds.find(fd);
+  if (it == fds.end()) THROW("FD " << fd << " not found in pool");
+
+  // The FD is not closed until the shard has flushed it, so its number
+  // cannot be reused before the shard is done with it.
+  Shard &shard = shards[it->second];
+  fds.erase(it);
+  shard.count--;
+  shard.pool->flush(fd);
+}
+
+
+unsigned FDPoolSharded::select() {
+  if (!leastLoaded) {
+    unsigned i = next++;
+    if (next == shards.size()) next = 0;
+    return i;
+  }
+
+  unsigned best = 0;
+  for (unsigned i = 1; i < shards.size(); i++)
+    if (shards[i].count < shards[best].count) best = i;
+
+  return best;
+}
+
+
+FDPool &FDPoolSharded::get(int fd) {
+  auto it = fds.find(fd);
+  if (it == fds.end()) THROW("FD " << fd << " not found in pool");
+  return *shards[it->second].pool;
+}
+
+#endif // HAVE_EPOLL
@@ -0,0 +1,93 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/config.h>
+
+#ifdef HAVE_EPOLL
+
+#include "FDPool.h"
+
+#include <vector>
+#include <map>
+
+
+namespace cb {
+  namespace Event {
+    class Base;
+    class FDPoolEPoll;
+
+    /// Divides FDs between several FDPoolEPoll or FDPoolIOUring threads
+    class FDPoolSharded : public FDPool {
+      struct Shard {
+        SmartPointer<FDPoolEPoll> pool;
+        unsigned count;
+      };
+
+      std::vector<Shard> shards;
+      bool leastLoaded = false;
+      unsigned next = 0;
+
+      typedef std::map<int, unsigned> fds_t;
+      fds_t fds;
+
+      SmartPointer<Rate> readRate;
+      SmartPointer<Rate> writeRate;
+
+    public:
+      FDPoolSharded(Base &base, unsigned threads,
+                    const std::string &balance = "round-robin",
+                    const std::string &type = "epoll");
+      ~FDPoolSharded();
+
+      unsigned getNumShards() const {return shards.size();}
+      unsigned getShardCount(unsigned i) const {return shards.at(i).count;}
+
+      // From FDPool
+      void setEventPriority(int priority) override;
+      int getEventPriority() const override;
+      const Rate &getReadRate()  const override {return *readRate;}
+      const Rate &getWriteRate() const override {return *writeRate;}
+      void read (const SmartPointer<Transfer> &t) override;
+      void write(const SmartPointer<Transfer> &t) override;
+      void open(FD &fd) override;
+      void flush(int fd) override;
+
+    protected:
+      unsigned select();
+      FDPool &get(int fd);
+    };
+  }
+}
+
+#endif // HAVE_EPOLL
@@ -0,0 +1,149 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "HandshakePool.h"
+#include "Base.h"
+#include "Event.h"
+
+#include <cbang/Catch.h>
+#include <cbang/thread/SmartLock.h>
+#include <cbang/thread/SmartUnlock.h>
+
+using namespace cb::Event;
+using namespace cb;
+using namespace std;
+
+
+void HandshakePool::Completed::complete() {
+  SmartLock lock(this);
+
+  while (!jobs.empty()) {
+    Job job = jobs.front();
+    jobs.pop();
+
+    SmartUnlock unlock(this);
+    TRY_CATCH_ERROR(job.done(job.success));
+  }
+}
+
+
+HandshakePool::HandshakePool(unsigned threads, unsigned maxQueued) :
+  ThreadPool(threads), maxQueued(maxQueued) {
+  if (!Base::threadsEnabled())
+    THROW("Cannot use Event::HandshakePool without threads enabled");
+}
+
+
+HandshakePool::~HandshakePool() {join();}
+
+
+unsigned HandshakePool::getNumQueued() const {
+  SmartLock lock(this);
+  return ready.size();
+}
+
+
+unsigned HandshakePool::getNumActive() const {
+  SmartLock lock(this);
+  return active;
+}
+
+
+uint64_t HandshakePool::getNumRejected() const {
+  SmartLock lock(this);
+  return rejected;
+}
+
+
+bool HandshakePool::submit(Base &base, run_cb_t run, done_cb_t done) {
+  SmartLock lock(this);
+
+  if (maxQueued <= ready.size()) {
+    rejected++;
+    return false;
+  }
+
+  // Completion events are created on the submitting thread
+  auto &c = completed[&base];
+  if (c.isNull()) {
+    c = new Completed;
+    c->event = base.newEvent(c.get(), &Completed::complete, 0);
+  }
+
+  ready.push(Job{&base, run, done, false});
+  Condition::signal();
+
+  return true;
+}
+
+
+void HandshakePool::stop() {
+  ThreadPool::stop();
+  Condition::broadcast();
+}
+
+
+void HandshakePool::join() {
+  stop();
+  ThreadPool::wait();
+}
+
+
+void HandshakePool::run() {
+  SmartLock lock(this);
+
+  while (!Thread::current().shouldShutdown()) {
+    if (ready.empty()) Condition::wait();
+    if (Thread::current().shouldShutdown()) break;
+    if (ready.empty()) continue;
+
+    Job job = ready.front();
+    ready.pop();
+    active++;
+
+    {
+      SmartUnlock unlock(this);
+
+      try {
+        job.run();
+        job.success = true;
+      } CATCH_DEBUG(4);
+    }
+
+    active--;
+
+    auto &c = *completed[job.base];
+    SmartLock cLock(&c);
+    c.jobs.push(job);
+    c.event->activate();
+  }
+}
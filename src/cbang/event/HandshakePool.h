@@ -0,0 +1,104 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/SmartPointer.h>
+#include <cbang/thread/ThreadPool.h>
+#include <cbang/thread/Condition.h>
+
+#include <queue>
+#include <map>
+#include <functional>
+#include <cstdint>
+
+
+namespace cb {
+  namespace Event {
+    class Base;
+    class Event;
+
+    /***
+     * A bounded pool of threads which runs CPU heavy connection setup work,
+     * such as TLS handshakes, off the event loop threads.  Completion
+     * callbacks run on the event loop of the Base the job was submitted
+     * from.
+     */
+    class HandshakePool : protected ThreadPool, protected Condition {
+    public:
+      typedef std::function<void ()> run_cb_t;
+      typedef std::function<void (bool)> done_cb_t;
+
+    protected:
+      struct Job {
+        Base *base;
+        run_cb_t run;
+        done_cb_t done;
+        bool success;
+      };
+
+      struct Completed : public Mutex {
+        SmartPointer<Event> event;
+        std::queue<Job> jobs;
+
+        void complete();
+      };
+
+      unsigned maxQueued;
+      unsigned active = 0;
+      uint64_t rejected = 0;
+      std::queue<Job> ready;
+      std::map<Base *, SmartPointer<Completed> > completed;
+
+    public:
+      HandshakePool(unsigned threads, unsigned maxQueued = 1024);
+      ~HandshakePool();
+
+      unsigned getMaxQueued() const {return maxQueued;}
+      unsigned getNumQueued() const;
+      unsigned getNumActive() const;
+      uint64_t getNumRejected() const;
+
+      /// @return false if the queue is full
+      bool submit(Base &base, run_cb_t run, done_cb_t done);
+
+      // From ThreadPool
+      using ThreadPool::start;
+      void stop() override;
+      void join() override;
+
+    protected:
+      // From ThreadPool
+      void run() override;
+    };
+  }
+}
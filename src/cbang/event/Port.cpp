@@ -33,6 +33,7 @@
 #include "Port.h"
 #include "Server.h"
 #include "Event.h"
+#include "Base.h"
 
 #include <cbang/net/Socket.h>
 #include <cbang/log/Logger.h>
@@ -43,9 +44,10 @@ using namespace cb;
 using namespace std;
 
 
-Port::Port(Server &server, const SockAddr addr,
+Port::Port(Server &server, Base &base, const SockAddr addr,
            const SmartPointer<SSLContext> &sslCtx, int priority) :
-  server(server), addr(addr), sslCtx(sslCtx), priority(priority) {}
+  server(server), base(base), addr(addr), sslCtx(sslCtx),
+  priority(priority) {}
 
 
 Port::~Port() {}
@@ -61,12 +63,15 @@ void Port::open() {
   socket = new Socket;
   socket->open();
   socket->setReuseAddr(true);
+  if (1 < server.getThreads()) socket->setReusePort(true);
   socket->bind(addr);
+  if (server.getFastOpen()) socket->setFastOpen(server.getFastOpen());
   socket->listen(server.getConnectionBacklog());
+  if (server.getDeferAccept()) socket->setDeferAccept(server.getDeferAccept());
   socket->setBlocking(false);
   socket_t fd = socket->get();
 
-  event = server.getBase().newEvent(
+  event = base.newEvent(
     fd, this, &Port::accept, EVENT_READ | EVENT_PERSIST);
   if (0 <= priority) event->setPriority(priority);
   event->add();
@@ -84,7 +89,10 @@ void Port::activate() {event->add();}
 
 
 void Port::accept() {
-  while (true) {
+  // Bound the work per wakeup, the listen socket stays readable if more remain
+  unsigned batch = server.getAcceptBatch();
+
+  for (unsigned i = 0; !batch || i < batch; i++) {
     if (server.getMaxConnections() <= server.getConnectionCount())
       return event->del();
 
@@ -93,7 +101,7 @@ void Port::accept() {
     if (newSocket.isNull()) return;
 
     try {
-      server.accept(peerAddr, newSocket, sslCtx);
+      server.accept(base, peerAddr, newSocket, sslCtx);
     } catch (const SSLException &e) {
       LOG_DEBUG(4, e.getMessage());
     }
@@ -44,10 +44,12 @@ namespace cb {
 
   namespace Event {
     class Server;
+    class Base;
     class Event;
 
     class Port : public Enum {
       Server &server;
+      Base &base;
       SockAddr addr;
       SmartPointer<SSLContext> sslCtx;
       int priority;
@@ -56,10 +58,11 @@ namespace cb {
       SmartPointer<Event> event;
 
     public:
-      Port(Server &server, const SockAddr addr,
+      Port(Server &server, Base &base, const SockAddr addr,
            const SmartPointer<SSLContext> &sslCtx, int priority);
       ~Port();
 
+      Base &getBase() {return base;}
       const SockAddr &getAddr() const {return addr;}
       bool isSecure() const {return sslCtx.isSet();}
 
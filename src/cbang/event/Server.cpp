@@ -31,6 +31,7 @@
 \******************************************************************************/
 
 #include "Server.h"
+#include "Event.h"
 
 #include <cbang/config.h>
 #include <cbang/Catch.h>
@@ -38,13 +39,22 @@
 #include <cbang/log/Logger.h>
 #include <cbang/net/Socket.h>
 #include <cbang/config/Options.h>
+#include <cbang/thread/SmartLock.h>
 
 using namespace cb::Event;
 using namespace cb;
 using namespace std;
 
 
-Server::Server(Base &base) : base(base), addrFilter(&base.getDNS()) {}
+Server::Server(Base &base) :
+  base(base), startEvent(base.newEvent(this, &Server::startWorkers, 0)),
+  addrFilter(&base.getDNS()) {}
+
+
+Server::~Server() {
+  if (handshakePool.isSet()) handshakePool->join();
+  for (auto &worker: workers) worker->join();
+}
 
 
 void Server::setTimeout(int timeout) {
@@ -53,11 +63,31 @@ void Server::setTimeout(int timeout) {
 }
 
 
+void Server::setThreads(unsigned threads) {
+  if (!ports.empty()) THROW("Server threads must be set before binding");
+  this->threads = threads;
+}
+
+
+void Server::setHandshakeThreads(unsigned threads) {
+  if (!ports.empty()) THROW("Handshake threads must be set before binding");
+  handshakeThreads = threads;
+}
+
+
+void Server::setMaxHandshakeQueue(unsigned x) {
+  if (!ports.empty()) THROW("Handshake queue must be set before binding");
+  maxHandshakeQueue = x;
+}
+
+
 void Server::allow(const string &spec) {addrFilter.allow(spec);}
 void Server::deny (const string &spec) {addrFilter.deny(spec);}
 
 
 void Server::addOptions(Options &options) {
+  base.addOptions(options);
+
   options.pushCategory("Server");
 
   options.add("allow", "Client addresses which are allowed to connect to this "
@@ -72,6 +102,27 @@ void Server::addOptions(Options &options) {
   options.addTarget("connection-backlog", connectionBacklog,
                     "Size of the connection backlog queue.  Once this is full "
                     "connections are rejected.");
+  options.addTarget("accept-batch", acceptBatch,
+                    "Maximum connections accepted per event loop wakeup.  "
+                    "Remaining connections are accepted on the next pass so "
+                    "that established connections are not starved.  Zero "
+                    "indicates no limit.");
+  options.addTarget("tcp-defer-accept", deferAccept,
+                    "Seconds to wait for client data before a connection is "
+                    "accepted.  Zero disables TCP_DEFER_ACCEPT.");
+  options.addTarget("tcp-fastopen", fastOpen,
+                    "Length of the TCP Fast Open queue.  Zero disables "
+                    "TCP_FASTOPEN.");
+  options.addTarget("server-threads", threads,
+                    "Number of event loop threads accepting and serving "
+                    "connections.  Each has its own SO_REUSEPORT listener on "
+                    "every port.");
+  options.addTarget("tls-handshake-threads", handshakeThreads,
+                    "Number of threads running TLS handshakes.  Zero runs "
+                    "handshakes inline on the I/O thread.");
+  options.addTarget("tls-handshake-queue", maxHandshakeQueue,
+                    "Maximum TLS handshakes waiting for a handshake thread.  "
+                    "Connections beyond this are dropped.");
   options.addTarget("max-connections", maxConnections,
                     "Maximum simultaneous client connections per port");
   options.addTarget("max-ttl", maxConnectionTTL,
@@ -94,16 +145,33 @@ void Server::bind(const SockAddr &addr, const SmartPointer<SSLContext> &sslCtx,
                   int priority) {
   LOG_DEBUG(4, "Binding " << (sslCtx.isSet() ? "ssl " : "") << addr);
 
-  SmartPointer<Port> port = new Port(*this, addr, sslCtx, priority);
-  port->open();
-  ports.push_back(port);
+  if (sslCtx.isSet() && handshakeThreads && handshakePool.isNull()) {
+    handshakePool = new HandshakePool(handshakeThreads, maxHandshakeQueue);
+    handshakePool->start();
+  }
+
+  if (threads <= 1) return open(base, addr, sslCtx, priority);
+
+  if (workers.empty()) {
+    for (unsigned i = 0; i < threads; i++)
+      workers.push_back(new ServerWorker(base));
+
+    // Start once the main loop runs so that handlers are in place
+    startEvent->activate();
+  }
+
+  for (auto &worker: workers) open(worker->getBase(), addr, sslCtx, priority);
 }
 
 
-void Server::shutdown() {for (auto &port: ports) port->close();}
+void Server::shutdown() {
+  for (auto &port: ports) port->close();
+  if (handshakePool.isSet()) handshakePool->join();
+  for (auto &worker: workers) worker->join();
+}
 
 
-void Server::accept(const SockAddr &peerAddr,
+void Server::accept(Base &base, const SockAddr &peerAddr,
                     const SmartPointer<Socket> &socket,
                     const SmartPointer<SSLContext> &sslCtx) {
   if (!isAllowed(peerAddr)) {
@@ -113,35 +181,68 @@ void Server::accept(const SockAddr &peerAddr,
 
   LOG_DEBUG(4, "New connection from " << peerAddr);
 
-  auto conn = createConnection();
+  auto conn = createConnection(base);
+
+  bool offload = sslCtx.isSet() && handshakePool.isSet();
 
-  conn->accept(peerAddr, socket, sslCtx);
+  conn->setStats(stats);
+  conn->accept(peerAddr, socket, sslCtx, !offload);
   conn->setReadTimeout(readTimeout);
   conn->setWriteTimeout(writeTimeout);
-  conn->setStats(stats);
   if (maxConnectionTTL) conn->setTTL(maxConnectionTTL);
 
   conn->setServer(this);
-  connections.insert(conn);
+  {
+    SmartLock lock(&connectionsLock);
+    connections.insert(conn);
+  }
+
+  if (offload)
+    conn->handshake(handshakePool, [conn] (bool success) {
+      if (success) TRY_CATCH_ERROR(conn->onConnect());
+    });
 
-  TRY_CATCH_ERROR(conn->onConnect());
+  else TRY_CATCH_ERROR(conn->onConnect());
 }
 
 
 void Server::remove(const SmartPointer<Connection> &conn) {
   LOG_DEBUG(4, "Connection ended");
 
-  connections.erase(conn);
+  {
+    SmartLock lock(&connectionsLock);
+    connections.erase(conn);
+  }
 
   for (auto &port: ports) port->activate();
 }
 
 
+unsigned Server::getConnectionCount() const {
+  SmartLock lock(&connectionsLock);
+  return connections.size();
+}
+
+
 bool Server::isAllowed(const SockAddr &peerAddr) const {
   return addrFilter.isAllowed(peerAddr);
 }
 
 
-SmartPointer<Connection> Server::createConnection() {
+SmartPointer<Connection> Server::createConnection(Base &base) {
   return new Connection(base);
 }
+
+
+void Server::startWorkers() {
+  for (auto &worker: workers)
+    if (!worker->isRunning()) worker->start();
+}
+
+
+void Server::open(Base &base, const SockAddr &addr,
+                  const SmartPointer<SSLContext> &sslCtx, int priority) {
+  SmartPointer<Port> port = new Port(*this, base, addr, sslCtx, priority);
+  port->open();
+  ports.push_back(port);
+}
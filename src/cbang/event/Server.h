@@ -34,13 +34,17 @@
 
 #include "Connection.h"
 #include "Port.h"
+#include "ServerWorker.h"
+#include "HandshakePool.h"
 
 #include <cbang/SmartPointer.h>
 #include <cbang/openssl/SSLContext.h>
 #include <cbang/net/AddressFilter.h>
+#include <cbang/thread/Mutex.h>
 
 #include <list>
 #include <set>
+#include <vector>
 #include <limits>
 
 
@@ -53,29 +57,48 @@ namespace cb {
     class Server : public Enum {
       Base &base;
 
+      // Declared first so the worker Bases outlive their ports and connections
+      typedef std::vector<SmartPointer<ServerWorker>> workers_t;
+      workers_t workers;
+      SmartPointer<Event> startEvent;
+      SmartPointer<HandshakePool> handshakePool;
+
       typedef std::list<SmartPointer<Port>> ports_t;
       ports_t ports;
 
       typedef std::set<SmartPointer<Connection>> connections_t;
       connections_t connections;
+      Mutex connectionsLock;
 
       int readTimeout = 50;
       int writeTimeout = 50;
       unsigned maxConnections = std::numeric_limits<unsigned>::max();
       unsigned maxConnectionTTL = 0;
       unsigned connectionBacklog = 128;
+      unsigned acceptBatch = 32;
+      unsigned deferAccept = 0;
+      unsigned fastOpen = 0;
+      unsigned threads = 1;
+      unsigned handshakeThreads = 0;
+      unsigned maxHandshakeQueue = 1024;
 
       AddressFilter addrFilter;
 
       SmartPointer<RateSet> stats;
 
+      void startWorkers();
+      void open(Base &base, const SockAddr &addr,
+                const SmartPointer<SSLContext> &sslCtx, int priority);
+
     public:
       Server(Base &base);
-      virtual ~Server() {}
+      virtual ~Server();
 
       Base &getBase() {return base;}
 
       const ports_t &getPorts() const {return ports;}
+      const workers_t &getWorkers() const {return workers;}
+      /// Not safe to iterate while worker threads are running
       const connections_t &getConnections() const {return connections;}
 
       int getReadTimeout() const {return readTimeout;}
@@ -95,13 +118,37 @@ namespace cb {
       unsigned getConnectionBacklog() const {return connectionBacklog;}
       void setConnectionBacklog(unsigned x) {connectionBacklog = x;}
 
+      /// Maximum connections accepted per wakeup, zero for unlimited
+      unsigned getAcceptBatch() const {return acceptBatch;}
+      void setAcceptBatch(unsigned x) {acceptBatch = x;}
+
+      unsigned getDeferAccept() const {return deferAccept;}
+      void setDeferAccept(unsigned secs) {deferAccept = secs;}
+
+      unsigned getFastOpen() const {return fastOpen;}
+      void setFastOpen(unsigned queue) {fastOpen = queue;}
+
+      /// If greater than one, each port is served by this many event loops
+      unsigned getThreads() const {return threads;}
+      void setThreads(unsigned threads);
+
+      /// If non-zero, TLS handshakes run on this many threads
+      unsigned getHandshakeThreads() const {return handshakeThreads;}
+      void setHandshakeThreads(unsigned threads);
+
+      unsigned getMaxHandshakeQueue() const {return maxHandshakeQueue;}
+      void setMaxHandshakeQueue(unsigned x);
+
+      const SmartPointer<HandshakePool> &getHandshakePool() const
+      {return handshakePool;}
+
       void allow(const std::string &spec);
       void deny(const std::string &spec);
 
       const SmartPointer<RateSet> &getStats() const {return stats;}
       void setStats(const SmartPointer<RateSet> &stats) {this->stats = stats;}
 
-      unsigned getConnectionCount() const {return connections.size();}
+      unsigned getConnectionCount() const;
 
       virtual void addOptions(Options &options);
       virtual void init(Options &options);
@@ -110,12 +157,13 @@ namespace cb {
                 const SmartPointer<SSLContext> &sslCtx = 0, int priority = -1);
       void shutdown();
 
-      void accept(const SockAddr &peerAddr, const SmartPointer<Socket> &socket,
+      void accept(Base &base, const SockAddr &peerAddr,
+                  const SmartPointer<Socket> &socket,
                   const SmartPointer<SSLContext> &sslCtx);
       void remove(const SmartPointer<Connection> &conn);
 
       virtual bool isAllowed(const SockAddr &peerAddr) const;
-      virtual SmartPointer<Connection> createConnection();
+      virtual SmartPointer<Connection> createConnection(Base &base);
     };
   }
 }
@@ -32,9 +32,12 @@
 
 #pragma once
 
+#include "Buffer.h"
+
 #include <cbang/openssl/SSL.h>
 
 #include <functional>
+#include <cstdint>
 
 
 namespace cb {
@@ -47,26 +50,30 @@ namespace cb {
       int fd;
       SmartPointer<SSL> ssl;
       cb_t cb;
-      unsigned length;
+      uint64_t length;
       bool finished = false;
       bool success = false;
       uint64_t timeout = 0;
+      bool trackProgress = true;
 
     public:
       Transfer(int fd, const SmartPointer<SSL> &ssl, cb_t cb,
-               unsigned length = 0) :
+               uint64_t length = 0) :
         fd(fd), ssl(ssl), cb(cb), length(length) {}
 
       virtual ~Transfer() {}
 
       int getFD() const {return fd;}
       const SmartPointer<SSL> &getSSL() const {return ssl;}
-      unsigned getLength() const {return length;}
+      uint64_t getLength() const {return length;}
       bool isFinished() {return finished;}
 
       void setTimeout(uint64_t timeout) {this->timeout = timeout;}
       uint64_t getTimeout() const {return timeout;}
 
+      void setTrackProgress(bool x) {trackProgress = x;}
+      bool getTrackProgress() const {return trackProgress;}
+
 #ifdef HAVE_OPENSSL
       bool wantsRead() const {return ssl.isSet() && ssl->wantsRead();}
       bool wantsWrite() const {return ssl.isSet() && ssl->wantsWrite();}
@@ -77,6 +84,11 @@ namespace cb {
 
       virtual bool isPending() const {return false;}
       virtual int transfer() {finished = success = true; return 0;}
+
+      /// Transfer from data the FDPool has already received on this FD
+      virtual int transferFrom(Buffer &input, bool eof)
+      {return (input.isEmpty() && !eof) ? 0 : transfer();}
+
       virtual void complete() {if (cb) cb(success);}
     };
   }
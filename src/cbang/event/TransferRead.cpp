@@ -87,14 +87,38 @@ int TransferRead::transfer() {
 
     LOG_DEBUG(4, CBANG_FUNC << "() " << this << " finished=" << finished);
 
+    if (0 < ret) bytes += ret;
+
     if (finished || ret <= 0)
       return bytes ? bytes : ((success || wantsWrite() || haveSSL) ? ret : -1);
-
-    bytes += ret;
   }
 }
 
 
+int TransferRead::transferFrom(Buffer &input, bool eof) {
+  unsigned used = buffer.getLength();
+  unsigned space = used < length ? length - used : 0;
+  unsigned bytes = min(space, input.getLength());
+
+  if (bytes < 4096) {
+    // Copy small reads so the buffer does not fragment into tiny chains
+    evbuffer_iovec vec;
+    if (evbuffer_reserve_space(buffer.getBuffer(), bytes, &vec, 1) != 1)
+      THROW("Failed to reserve space");
+    vec.iov_len = input.remove((char *)vec.iov_base, bytes);
+    evbuffer_commit_space(buffer.getBuffer(), &vec, 1);
+
+  } else bytes = input.remove(buffer, bytes);
+
+  LOG_DEBUG(4, CBANG_FUNC << "() " << this << " bytes=" << bytes
+            << " buf=" << buffer.getLength() << " eof=" << eof);
+
+  checkFinished();
+
+  return (!bytes && eof && !finished) ? -1 : bytes;
+}
+
+
 int TransferRead::read(Buffer &buffer, unsigned length) {
   if (!length) return 0;
 
@@ -137,8 +161,22 @@ void TransferRead::checkFinished() {
   if (finished) return;
 
   unsigned bytesRead = buffer.getLength();
-  if (length <= bytesRead || (!until.empty() && buffer.indexOf(until) != -1)) {
+  if (length <= bytesRead || foundUntil()) {
     finished = success = true;
     length = bytesRead;
   }
 }
+
+
+bool TransferRead::foundUntil() {
+  if (until.empty()) return false;
+
+  // Only search new data plus enough to catch a delimiter split across reads
+  unsigned bytesRead = buffer.getLength();
+  if (bytesRead < scanned) scanned = 0;
+  unsigned overlap = until.length() - 1;
+  unsigned start = scanned < overlap ? 0 : scanned - overlap;
+  scanned = bytesRead;
+
+  return buffer.indexOf(until, start) != -1;
+}
@@ -43,6 +43,7 @@ namespace cb {
     class TransferRead : public Transfer {
       Buffer buffer;
       std::string until;
+      unsigned scanned = 0;
 
     public:
       TransferRead(int fd, const SmartPointer<SSL> &ssl, cb_t cb,
@@ -52,10 +53,12 @@ namespace cb {
       // From Transfer
       bool isPending() const override;
       int transfer() override;
+      int transferFrom(Buffer &input, bool eof) override;
 
     protected:
       int read(Buffer &buffer, unsigned length);
       void checkFinished();
+      bool foundUntil();
     };
   }
 }
@@ -0,0 +1,111 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "TransferSendFile.h"
+
+#ifdef HAVE_SENDFILE
+
+#include <cbang/Catch.h>
+#include <cbang/os/SysError.h>
+#include <cbang/log/Logger.h>
+
+#include <algorithm>
+
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+using namespace cb::Event;
+using namespace cb;
+using namespace std;
+
+
+TransferSendFile::TransferSendFile(int fd, cb_t cb, const string &path,
+                                   uint64_t offset, uint64_t length) :
+  Transfer(fd, 0, cb, length), offset(offset), end(offset + length) {
+  file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (file == -1) THROW("Failed to open file " << path << ": " << SysError());
+  checkFinished();
+}
+
+
+TransferSendFile::~TransferSendFile() {if (file != -1) ::close(file);}
+
+
+int TransferSendFile::transfer() {
+  int bytes = 0;
+
+  // Limit bytes so the return value cannot overflow
+  while (!finished && bytes < (1 << 30)) {
+    int ret = write();
+    LOG_DEBUG(4, CBANG_FUNC << "() ret=" << ret << " offset=" << offset);
+
+    if (ret < 0) {
+      finished = true;
+      return bytes ? bytes : -1;
+    }
+
+    if (!ret) break; // Would block
+
+    bytes += ret;
+    checkFinished();
+  }
+
+  return bytes;
+}
+
+
+int TransferSendFile::write() {
+  off_t off = offset;
+  size_t count = min(end - offset, (uint64_t)1 << 30);
+
+  ssize_t ret = sendfile(fd, file, &off, count);
+
+  if (ret < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+    LOG_DEBUG(4, "sendfile() failed: " << SysError());
+    return -1;
+  }
+
+  if (!ret) return -1; // File was truncated
+
+  offset = off;
+  return ret;
+}
+
+
+void TransferSendFile::checkFinished() {
+  if (end <= offset) finished = success = true;
+}
+
+#endif // HAVE_SENDFILE
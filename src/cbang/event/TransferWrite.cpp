@@ -45,6 +45,7 @@
 
 using namespace cb::Event;
 using namespace cb;
+using namespace std;
 
 
 TransferWrite::TransferWrite(int fd, const SmartPointer<SSL> &ssl, cb_t cb,
@@ -62,11 +63,11 @@ int TransferWrite::transfer() {
     if (!bytes && ret < 0) finished = true;
     else checkFinished();
 
+    if (0 < ret) bytes += ret;
+
     if (finished || ret <= 0)
       return bytes ? bytes :
         ((success || wantsRead() || wantsWrite()) ? ret : -1);
-
-    bytes += ret;
   }
 }
 
@@ -75,13 +76,15 @@ int TransferWrite::write(Buffer &buffer, unsigned length) {
   if (!length) return 0;
 
 #ifdef HAVE_OPENSSL
-  if (ssl.isSet()) {
+  // With kTLS the kernel encrypts plain writes
+  if (ssl.isSet() && !ssl->isKTLSSend()) {
     try {
-      iovec space;
-      buffer.peek(length, space);
-      if (!space.iov_len) return -1; // No data
+      // Gather small segments so they are sent as one record
+      length = min(length, ssl->getWriteSize());
+      const char *data = buffer.pullup(length);
+      if (!data) return -1; // No data
 
-      int ret = ssl->write((char *)space.iov_base, space.iov_len);
+      int ret = ssl->write(data, length);
       if (0 < ret) buffer.drain(ret);
 
       return ret;
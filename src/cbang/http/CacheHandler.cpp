@@ -0,0 +1,471 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "CacheHandler.h"
+#include "ConnIn.h"
+#include "Server.h"
+#include "RequestErrorHandler.h"
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+#include <cbang/event/Base.h>
+#include <cbang/event/Event.h>
+#include <cbang/event/BufferFilter.h>
+#include <cbang/time/Time.h>
+#include <cbang/thread/SmartLock.h>
+#include <cbang/thread/SmartUnlock.h>
+#include <cbang/log/Logger.h>
+
+using namespace std;
+using namespace cb;
+using namespace cb::HTTP;
+
+
+// Held by the reply callback of the request filling an entry.  Waiters are
+// released even if the request is dropped before it replies.
+struct CacheHandler::Fill {
+  SmartPointer<CacheHandler *> handler;
+  string key;
+  bool done = false;
+
+  Fill(const SmartPointer<CacheHandler *> &handler, const string &key) :
+    handler(handler), key(key) {}
+  ~Fill() {if (!done && *handler) TRY_CATCH_ERROR((*handler)->release(key));}
+};
+
+
+uint64_t CacheHandler::Entry::getSize() const {
+  uint64_t size = body.length() + gzipBody.length();
+  for (auto &header: headers)
+    size += header.first.length() + header.second.length();
+  return size;
+}
+
+
+void CacheHandler::Wake::wake(CacheHandler &handler) {
+  SmartLock lock(this);
+
+  while (!ready.empty()) {
+    auto req = ready.front();
+    ready.pop();
+
+    SmartUnlock unlock(this);
+    TRY_CATCH_ERROR(handler.resume(*req));
+  }
+}
+
+
+CacheHandler::CacheHandler(const RequestHandlerPtr &child) :
+  child(child), self(new CacheHandler *(this)) {
+  if (child.isNull()) THROW("Child handler cannot be null");
+}
+
+
+CacheHandler::~CacheHandler() {
+  SmartLock lock(this);
+  *self = 0; // Requests may outlive the handler
+}
+
+
+void CacheHandler::setMaxBytes(uint64_t x) {
+  SmartLock lock(this);
+  maxBytes = x;
+  evict();
+}
+
+
+unsigned CacheHandler::getEntryCount() const {
+  SmartLock lock(this);
+  return entries.size();
+}
+
+
+uint64_t CacheHandler::getByteCount() const {
+  SmartLock lock(this);
+  return bytes;
+}
+
+
+void CacheHandler::clear() {
+  SmartLock lock(this);
+  entries.clear();
+  responseVary.clear();
+  lru.clear();
+  bytes = 0;
+}
+
+
+string CacheHandler::getKey(const Request &req) const {
+  vector<string> names;
+
+  {
+    SmartLock lock(this);
+    auto it = responseVary.find(getKey(req, vector<string>()));
+    if (it != responseVary.end()) names = it->second.names;
+  }
+
+  return getKey(req, names);
+}
+
+
+string CacheHandler::getKey(const Request &req,
+                            const vector<string> &names) const {
+  string key =
+    string(req.getMethod().toString()) + " " + req.getURI().toString();
+  for (auto &name: vary) key += "\n" + req.inFind(name);
+
+  for (auto &name: names)
+    // Only the selected encoding matters, not how it was asked for
+    if (String::toLower(name) == "accept-encoding")
+      key += "\nAccept-Encoding: " +
+        String(req.getRequestedCompression().toString());
+    else key += "\n" + name + ": " + req.inFind(name);
+
+  return key;
+}
+
+
+CacheHandler::EntryPtr CacheHandler::lookup(const string &key) {
+  SmartLock lock(this);
+
+  auto it = entries.find(key);
+  if (it == entries.end()) return 0;
+
+  if (it->second.entry->expires <= Time::now()) {
+    event("expired");
+    remove(it);
+    return 0;
+  }
+
+  lru.splice(lru.begin(), lru, it->second.lru);
+  return it->second.entry;
+}
+
+
+bool CacheHandler::operator()(Request &req) {
+  {
+    SmartLock lock(this);
+    if (bypass.count(&req)) return false;
+  }
+
+  if (!isCacheable(req)) {
+    event("bypass");
+    return (*child)(req);
+  }
+
+  string key = getKey(req);
+  auto entry = lookup(key);
+
+  if (entry.isSet()) {
+    event("hit");
+    send(req, *entry);
+    return true;
+  }
+
+  {
+    SmartLock lock(this);
+
+    auto it = inflight.find(key);
+    if (it != inflight.end()) {
+      // Wait for the request already filling this entry
+      auto &base = req.getConnection()->getBase();
+      auto &wake = wakes[&base];
+
+      if (wake.isNull()) {
+        wake = new Wake;
+        Wake *ptr = wake.get();
+        wake->event = base.newEvent([this, ptr] () {ptr->wake(*this);}, 0);
+      }
+
+      it->second.push_back(waiters_t::value_type(wake.get(), SmartPtr(&req)));
+      event("coalesced");
+      return true;
+    }
+
+    inflight[key];
+  }
+
+  event("miss");
+
+  SmartPointer<Fill> fill = new Fill(self, key);
+  req.setReplyCallback([fill] (Request &req) {
+    fill->done = true;
+    if (*fill->handler) (*fill->handler)->store(fill->key, req);
+  });
+
+  if ((*child)(req)) return true;
+
+  // Not handled here, another handler may reply
+  req.setReplyCallback(0);
+  return false;
+}
+
+
+bool CacheHandler::isCacheable(const Request &req) const {
+  Method method = req.getMethod();
+  if (method != HTTP_GET && method != HTTP_HEAD) return false;
+  if (!req.hasConnection()) return false;
+
+  // Credentials must be part of the key
+  if (req.inHas("Authorization")) {
+    bool varies = false;
+    for (auto &name: vary)
+      if (String::toLower(name) == "authorization") varies = true;
+    if (!varies) return false;
+  }
+
+  return true;
+}
+
+
+unsigned CacheHandler::getTTL(const Request &req) const {
+  switch (req.getResponseCode()) {
+  case HTTP_OK: case HTTP_NON_AUTHORITATIVE_INFORMATION: case HTTP_NO_CONTENT:
+  case HTTP_MOVED_PERMANENTLY: case HTTP_NOT_FOUND: case HTTP_GONE: break;
+  default: return 0;
+  }
+
+  if (req.isChunked() || req.outHas("Set-Cookie") ||
+      req.outFind("Vary") == "*") return 0;
+
+  if (!req.outHas("Cache-Control")) return defaultTTL;
+
+  vector<string> directives;
+  String::tokenize(String::toLower(req.outGet("Cache-Control")), directives,
+                   ", \t");
+
+  int maxAge = -1;
+  for (auto &d: directives) {
+    if (d == "no-store" || d == "no-cache" || d == "private") return 0;
+
+    try {
+      if (String::startsWith(d, "s-maxage="))
+        maxAge = String::parseU32(d.substr(9));
+      else if (String::startsWith(d, "max-age=") && maxAge < 0)
+        maxAge = String::parseU32(d.substr(8));
+    } catch (const Exception &) {return 0;}
+  }
+
+  return maxAge < 0 ? defaultTTL : maxAge;
+}
+
+
+vector<string> CacheHandler::getResponseVary(const Request &req) const {
+  vector<string> names;
+  String::tokenize(req.outFind("Vary"), names, ", \t");
+
+  // An encoded body always depends on what the client accepts
+  if (req.outHas("Content-Encoding") &&
+      !Headers::listContains(req.outFind("Vary"), "Accept-Encoding"))
+    names.push_back("Accept-Encoding");
+
+  return names;
+}
+
+
+CacheHandler::EntryPtr CacheHandler::createEntry(Request &req,
+                                                 unsigned ttl) const {
+  // Event::Buffers are not shared between threads, keep an immutable copy
+  SmartPointer<Entry> entry = new Entry;
+  entry->code    = req.getResponseCode();
+  entry->body    = req.getOutputBuffer().toString();
+  entry->created = Time::now();
+  entry->expires = entry->created + ttl;
+
+  bool compress = minCompress && minCompress <= entry->body.length() &&
+    !req.outHas("Content-Encoding") && req.getMethod() == HTTP_GET;
+
+  for (auto &header: req.getOutputHeaders()) {
+    string name = String::toLower(header.first);
+    if (name == "date" || name == "content-length" || name == "connection" ||
+        (compress && name == "vary")) continue;
+    entry->headers.push_back(header);
+  }
+
+  if (compress) {
+    Event::Buffer out;
+    auto filter =
+      Event::BufferFilter::compressor(Compression::COMPRESSION_GZIP);
+    filter->filter(entry->body.data(), entry->body.length(), out);
+    filter->finish(out);
+    entry->gzipBody = out.toString();
+
+    // Not worth it
+    if (entry->body.length() <= entry->gzipBody.length())
+      entry->gzipBody.clear();
+
+    string vary = req.outFind("Vary");
+    if (vary.empty()) vary = "Accept-Encoding";
+    else if (!Headers::listContains(vary, "Accept-Encoding"))
+      vary += ", Accept-Encoding";
+    entry->headers.push_back(Headers::value_type("Vary", vary));
+  }
+
+  return entry;
+}
+
+
+void CacheHandler::send(Request &req, const Entry &entry) {
+  for (auto &header: entry.headers)
+    req.outSet(header.first, header.second);
+
+  req.outSet("Age", String(Time::now() - entry.created));
+
+  if (!entry.gzipBody.empty() &&
+      req.getRequestedCompression() == Compression::COMPRESSION_GZIP) {
+    req.outSetContentEncoding(Compression::COMPRESSION_GZIP);
+    req.send(entry.gzipBody);
+
+  } else req.send(entry.body);
+
+  req.reply(entry.code);
+}
+
+
+void CacheHandler::store(const string &key, Request &req) {
+  unsigned ttl = getTTL(req);
+  uint64_t size = req.getOutputLength();
+
+  // Files are sent from disk, only buffered bodies are copied
+  if (ttl && !req.hasOutputFile() && size <= maxEntrySize) {
+    auto names = getResponseVary(req);
+    auto entry = createEntry(req, ttl);
+
+    // Downstream caches must also tell the encodings apart
+    if (!entry->gzipBody.empty())
+      for (auto &header: entry->headers)
+        if (header.first == "Vary") req.outSet("Vary", header.second);
+
+    string base = getKey(req, vector<string>());
+
+    SmartLock lock(this);
+    responseVary[base].names = names;
+    insert(getKey(req, names), base, entry);
+    event("stored");
+
+  } else event("uncacheable");
+
+  release(key);
+}
+
+
+void CacheHandler::release(const string &key) {
+  SmartLock lock(this);
+
+  auto it = inflight.find(key);
+  if (it == inflight.end()) return;
+
+  for (auto &waiter: it->second) {
+    Wake &wake = *waiter.first;
+    SmartLock wakeLock(&wake);
+    wake.ready.push(waiter.second);
+    wake.event->activate();
+  }
+
+  inflight.erase(it);
+}
+
+
+void CacheHandler::resume(Request &req) {
+  auto entry = lookup(getKey(req));
+
+  if (entry.isSet()) {
+    event("hit");
+    send(req, *entry);
+
+  } else {
+    // Run the handler after all, or let the following handlers try
+    RequestFunctionHandler handler([this] (Request &req) {
+      if (!(*child)(req)) fallThrough(req);
+      return true;
+    });
+
+    RequestErrorHandler errorHandler(handler);
+    errorHandler(req);
+  }
+}
+
+
+void CacheHandler::fallThrough(Request &req) {
+  {
+    SmartLock lock(this);
+    bypass.insert(&req);
+  }
+
+  // Dispatch again, skipping this handler
+  req.getConnection().cast<ConnIn>()->getServer().dispatch(req);
+
+  SmartLock lock(this);
+  bypass.erase(&req);
+}
+
+
+void CacheHandler::insert(const string &key, const string &base,
+                          const EntryPtr &entry) {
+  // Count the new variant first so replacing the last one keeps the names
+  responseVary[base].variants++;
+
+  auto it = entries.find(key);
+  if (it != entries.end()) remove(it);
+
+  lru.push_front(key);
+  entries[key] = Slot{entry, base, lru.begin()};
+  bytes += entry->getSize();
+
+  evict();
+}
+
+
+void CacheHandler::remove(entries_t::iterator it) {
+  bytes -= it->second.entry->getSize();
+  lru.erase(it->second.lru);
+
+  // Forget what the responses varied on with the last variant
+  auto rv = responseVary.find(it->second.base);
+  if (rv != responseVary.end() && !--rv->second.variants)
+    responseVary.erase(rv);
+
+  entries.erase(it);
+}
+
+
+void CacheHandler::evict() {
+  while (!lru.empty() && maxBytes < bytes) {
+    remove(entries.find(lru.back()));
+    event("evicted");
+  }
+}
+
+
+void CacheHandler::event(const string &key) {
+  if (stats.isSet()) stats->event("cache-" + key);
+}
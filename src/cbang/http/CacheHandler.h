@@ -0,0 +1,179 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include "RequestHandler.h"
+
+#include <cbang/SmartPointer.h>
+#include <cbang/thread/Mutex.h>
+#include <cbang/util/RateSet.h>
+
+#include <map>
+#include <set>
+#include <list>
+#include <queue>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+
+namespace cb {
+  namespace Event {
+    class Base;
+    class Event;
+  }
+
+  namespace HTTP {
+    /***
+     * Caches complete responses of the wrapped handler in memory, keyed by
+     * method, URI, the configured Vary request headers and the headers the
+     * last stored response for the URI varied on.  Responses are
+     * kept for their Cache-Control max-age, or the default TTL if they have
+     * none, and evicted least recently used first.  Concurrent misses on
+     * the same key wait for the first request instead of running the
+     * handler again.
+     */
+    class CacheHandler : public RequestHandler, public Mutex {
+    public:
+      struct Entry {
+        Status code;
+        std::vector<Headers::value_type> headers;
+        std::string body;
+        std::string gzipBody; ///< Empty if not compressed
+        uint64_t created;
+        uint64_t expires;
+
+        uint64_t getSize() const;
+      };
+
+      typedef SmartPointer<const Entry> EntryPtr;
+
+    protected:
+      RequestHandlerPtr child;
+      SmartPointer<RateSet> stats;
+
+      std::vector<std::string> vary;
+
+      // Headers the responses for a base key varied on
+      struct ResponseVary {
+        std::vector<std::string> names;
+        unsigned variants = 0; ///< Cached entries under the base key
+      };
+
+      std::map<std::string, ResponseVary> responseVary;
+      std::set<const Request *> bypass;
+      unsigned defaultTTL   = 0;
+      uint64_t maxBytes     = 64 * 1024 * 1024;
+      uint64_t maxEntrySize = 1024 * 1024;
+      unsigned minCompress  = 1024;
+
+      struct Slot {
+        EntryPtr entry;
+        std::string base; ///< Key without the response's Vary headers
+        std::list<std::string>::iterator lru;
+      };
+
+      typedef std::map<std::string, Slot> entries_t;
+      entries_t entries;
+      std::list<std::string> lru; // Most recently used at the front
+      uint64_t bytes = 0;
+
+      // Requests waiting on a miss in progress, woken on their own Base
+      struct Wake : public Mutex {
+        SmartPointer<Event::Event> event;
+        std::queue<RequestPtr> ready;
+
+        void wake(CacheHandler &handler);
+      };
+
+      typedef std::vector<std::pair<Wake *, RequestPtr> > waiters_t;
+      std::map<std::string, waiters_t> inflight;
+      std::map<Event::Base *, SmartPointer<Wake> > wakes;
+
+      struct Fill;
+      SmartPointer<CacheHandler *> self; // Cleared on destruction
+
+    public:
+      CacheHandler(const RequestHandlerPtr &child);
+      ~CacheHandler();
+
+      const SmartPointer<RateSet> &getStats() const {return stats;}
+      void setStats(const SmartPointer<RateSet> &stats) {this->stats = stats;}
+
+      /// Request headers which select between cached responses
+      void addVary(const std::string &header) {vary.push_back(header);}
+
+      /// Seconds to keep responses without a Cache-Control max-age
+      unsigned getDefaultTTL() const {return defaultTTL;}
+      void setDefaultTTL(unsigned x) {defaultTTL = x;}
+
+      uint64_t getMaxBytes() const {return maxBytes;}
+      void setMaxBytes(uint64_t x);
+
+      uint64_t getMaxEntrySize() const {return maxEntrySize;}
+      void setMaxEntrySize(uint64_t x) {maxEntrySize = x;}
+
+      /// Store a gzip variant of bodies at least this long, zero disables
+      unsigned getMinCompress() const {return minCompress;}
+      void setMinCompress(unsigned x) {minCompress = x;}
+
+      unsigned getEntryCount() const;
+      uint64_t getByteCount() const;
+      void clear();
+
+      std::string getKey(const Request &req) const;
+      std::string getKey(const Request &req,
+                         const std::vector<std::string> &names) const;
+      EntryPtr lookup(const std::string &key);
+
+      // From RequestHandler
+      bool operator()(Request &req) override;
+
+    protected:
+      bool isCacheable(const Request &req) const;
+      unsigned getTTL(const Request &req) const;
+      std::vector<std::string> getResponseVary(const Request &req) const;
+      EntryPtr createEntry(Request &req, unsigned ttl) const;
+      void send(Request &req, const Entry &entry);
+      void store(const std::string &key, Request &req);
+      void release(const std::string &key);
+      void resume(Request &req);
+      void fallThrough(Request &req);
+      void insert(const std::string &key, const std::string &base,
+                  const EntryPtr &entry);
+      void remove(entries_t::iterator it);
+      void evict();
+      void event(const std::string &key);
+    };
+  }
+}
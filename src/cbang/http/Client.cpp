@@ -42,16 +42,41 @@ using namespace cb::HTTP;
 
 Client::Client(
   Event::Base &base, const SmartPointer<SSLContext> &sslCtx) :
-  base(base), sslCtx(sslCtx) {}
+  base(base), sslCtx(sslCtx), pool(new ConnPool(base)) {}
 
 
-Client::~Client() {}
+Client::~Client() {pool->close();}
 
 
-void Client::send(const SmartPointer<Request> &req) const {
+void Client::setStats(const SmartPointer<RateSet> &stats) {
+  this->stats = stats;
+  pool->setStats(stats);
+}
+
+
+void Client::send(const SmartPointer<Request> &req) {
   auto &uri = req->getURI();
 
-  if (!req->hasConnection()) req->setConnection(new ConnOut(base));
+  // Reuse an idle connection or open a new one which returns to the pool
+  if (!req->hasConnection()) {
+    string key = ConnPool::getKey(uri, bindAddr);
+    SmartPointer<ConnOut> conn = pool->get(key);
+
+    if (conn.isNull()) {
+      conn = new ConnOut(base);
+      auto pool = this->pool;
+      conn->setIdleCallback(
+        [pool, key] (ConnOut &conn) {pool->put(key, SmartPtr(&conn));});
+    }
+
+    req->setConnection(conn);
+
+    // Ask the server to keep the connection open for reuse
+    if (pool->getMaxIdle() && pool->getMaxIdlePerHost() &&
+        !req->outHas("Connection"))
+      req->outSet("Connection", "keep-alive");
+  }
+
   auto &conn = req->getConnection();
 
   // Configure connection
@@ -82,8 +107,7 @@ void Client::send(const SmartPointer<Request> &req) const {
 Client::RequestPtr Client::call(
   const URI &uri, Method method, const char *data, unsigned length,
   callback_t cb) {
-  auto con = SmartPtr(new ConnOut(base));
-  auto req = SmartPtr(new OutgoingRequest(*this, con, uri, method, cb));
+  auto req = SmartPtr(new OutgoingRequest(*this, 0, uri, method, cb));
 
   if (data) req->getOutputBuffer().add(data, length);
 
@@ -33,6 +33,7 @@
 #pragma once
 
 #include "OutgoingRequest.h"
+#include "ConnPool.h"
 
 #include <cbang/SmartPointer.h>
 #include <cbang/util/RateSet.h>
@@ -54,6 +55,7 @@ namespace cb {
       unsigned readTimeout  = 0;
       unsigned writeTimeout = 0;
       SmartPointer<RateSet> stats;
+      SmartPointer<ConnPool> pool;
 
     public:
       typedef SmartPointer<OutgoingRequest> RequestPtr;
@@ -83,9 +85,20 @@ namespace cb {
       void setWriteTimeout(unsigned timeout) {writeTimeout = timeout;}
 
       const SmartPointer<RateSet> &getStats() const {return stats;}
-      void setStats(const SmartPointer<RateSet> &stats) {this->stats = stats;}
+      void setStats(const SmartPointer<RateSet> &stats);
 
-      void send(const SmartPointer<Request> &req) const;
+      const SmartPointer<ConnPool> &getPool() const {return pool;}
+
+      unsigned getMaxIdle() const {return pool->getMaxIdle();}
+      void setMaxIdle(unsigned x) {pool->setMaxIdle(x);}
+
+      unsigned getMaxIdlePerHost() const {return pool->getMaxIdlePerHost();}
+      void setMaxIdlePerHost(unsigned x) {pool->setMaxIdlePerHost(x);}
+
+      unsigned getIdleTimeout() const {return pool->getIdleTimeout();}
+      void setIdleTimeout(unsigned timeout) {pool->setIdleTimeout(timeout);}
+
+      void send(const SmartPointer<Request> &req);
 
       RequestPtr call(const URI &uri, Method method, const char *data,
                       unsigned length, callback_t cb);
@@ -35,6 +35,8 @@
 #include "Request.h"
 
 #include <cbang/Catch.h>
+#include <cbang/event/TransferSendFile.h>
+#include <cbang/openssl/SSL.h>
 #include <cbang/log/Logger.h>
 
 using namespace cb::HTTP;
@@ -49,6 +51,31 @@ Conn::Conn(Event::Base &base) : Event::Connection(base) {}
 Conn::~Conn() {}
 
 
+void Conn::writeFile(const SmartPointer<Request> &req, const string &path,
+                     uint64_t offset, uint64_t length, bool hasMore,
+                     function<void (bool)> cb) {
+  LOG_DEBUG(4, CBANG_FUNC << "() path=" << path << " offset=" << offset
+            << " length=" << length);
+
+  checkActive(req);
+
+#ifdef HAVE_SENDFILE
+  bool plain = !isSecure();
+#ifdef HAVE_OPENSSL
+  if (!plain) plain = getSSL()->isKTLSSend();
+#endif
+
+  if (plain)
+    return write(new Event::TransferSendFile(
+                   getFD(), writeCB(req, hasMore, cb), path, offset, length));
+#endif
+
+  Event::Buffer buffer;
+  buffer.addFile(path, offset, length);
+  write(writeCB(req, hasMore, cb), buffer);
+}
+
+
 void Conn::readChunks(
   const SmartPointer<Request> &req, function<void (bool)> cb) {
   LOG_DEBUG(4, CBANG_FUNC << "()");
@@ -74,6 +101,37 @@ void Conn::readChunks(
 }
 
 
+void Conn::resumeBody() {
+  auto next = bodyResume;
+  bodyResume = 0;
+  if (next) next();
+}
+
+
+void Conn::addBody(const SmartPointer<Request> &req, unsigned length,
+                   function<void ()> next) {
+  if (!req->isBodyStream()) {
+    input.remove(req->getInputBuffer(), length);
+    return next();
+  }
+
+  Event::Buffer data;
+  input.remove(data, length);
+  req->onBodyData(data);
+
+  // Wait for Request::resumeBody()
+  if (req->isBodyPaused()) bodyResume = next;
+  else next();
+}
+
+
+void Conn::bodyError(const SmartPointer<Request> &req, const Exception &e,
+                     function<void (bool)> cb) {
+  LOG_ERROR(e);
+  if (cb) cb(false);
+}
+
+
 void Conn::readChunk(
   const SmartPointer<Request> &req, uint32_t size, function<void (bool)> cb) {
   LOG_DEBUG(4, CBANG_FUNC << "() size=" << size);
@@ -81,24 +139,37 @@ void Conn::readChunk(
   if (!size) return readChunkTrailer(req, cb);
 
   // Update body size
-  if (maxBodySize && maxBodySize < size + req->getInputBuffer().getLength()) {
+  bool stream = req->isBodyStream();
+  if (!stream && maxBodySize &&
+      maxBodySize < size + req->getInputBuffer().getLength()) {
     LOG_WARNING("Chunked body too large");
     if (cb) cb(false);
     return;
   }
 
-  // Read chunk
+  // Streamed chunks are read in parts
+  uint32_t part = stream ? min(size, streamBufferSize) : size;
+  uint32_t length = part == size ? size + 2 : part;
+
   auto readCB =
-    [this, req, size, cb] (bool success) mutable {
-      if (success && size <= input.getLength()) {
-        input.remove(req->getInputBuffer(), size);
+    [this, req, size, part, length, cb] (bool success) {
+      if (!success || input.getLength() < length) {
+        if (cb) cb(false);
+        return;
+      }
+
+      auto next = [this, req, size, part, cb] () {
+        if (part < size) return readChunk(req, size - part, cb);
         input.drain(2); // Remove CRLF
         readChunks(req, cb); // Next chunk
+      };
 
-      } else if (cb) cb(false);
+      try {
+        addBody(req, part, next);
+      } catch (const Exception &e) {bodyError(req, e, cb);}
     };
 
-  read(readCB, input, size + 2);
+  read(readCB, input, length);
 }
 
 
@@ -110,6 +181,7 @@ void Conn::readChunkTrailer(
     [this, req, cb] (bool success) {
       // No header lines
       if (input.indexOf("\r\n") == 0) {
+        input.drain(2);
         if (cb) cb(true);
         return;
       }
@@ -161,6 +233,7 @@ void Conn::pop() {
 
 void Conn::close() {
   auto self = SmartPtr(this);
+  bodyResume = 0;
   while (!requests.empty()) pop();
   Event::Connection::close();
 }
@@ -34,10 +34,13 @@
 
 #include "Enum.h"
 
+#include <cbang/Exception.h>
 #include <cbang/event/Connection.h>
 #include <cbang/event/Buffer.h>
 
 #include <limits>
+#include <string>
+#include <cstdint>
 #include <list>
 #include <functional>
 
@@ -51,12 +54,15 @@ namespace cb {
     protected:
       unsigned maxBodySize   = std::numeric_limits<int>::max();
       unsigned maxHeaderSize = std::numeric_limits<int>::max();
+      unsigned streamBufferSize = 64 * 1024;
 
       Event::Buffer input;
 
       typedef std::list<SmartPointer<Request> > requests_t;
       requests_t requests;
 
+      std::function<void ()> bodyResume;
+
     public:
       Conn(Event::Base &base);
       virtual ~Conn();
@@ -67,6 +73,10 @@ namespace cb {
       unsigned getMaxHeaderSize() const {return maxHeaderSize;}
       void setMaxHeaderSize(unsigned size) {maxHeaderSize = size;}
 
+      /// Largest part of a streamed body read before calling onBodyData()
+      unsigned getStreamBufferSize() const {return streamBufferSize;}
+      void setStreamBufferSize(unsigned size) {streamBufferSize = size;}
+
       unsigned getNumRequests() const {return requests.size();}
       const requests_t &getRequests() const {return requests;}
 
@@ -76,10 +86,26 @@ namespace cb {
                                 std::function<void (bool)> cb = 0) = 0;
       virtual void makeRequest(const SmartPointer<Request> &req) {}
 
+      /// Uses sendfile() unless the connection is encrypted in userspace
+      void writeFile(const SmartPointer<Request> &req, const std::string &path,
+                     uint64_t offset, uint64_t length, bool hasMore = false,
+                     std::function<void (bool)> cb = 0);
+
       void readChunks(const SmartPointer<Request> &req,
                       std::function<void (bool)> cb);
+      void resumeBody();
 
     protected:
+      virtual std::function<void (bool)>
+      writeCB(const SmartPointer<Request> &req, bool hasMore,
+              std::function<void (bool)> cb) = 0;
+
+      void addBody(const SmartPointer<Request> &req, unsigned length,
+                   std::function<void ()> next);
+      /// Called when onBodyData() throws, the rest of the body is not read
+      virtual void bodyError(const SmartPointer<Request> &req,
+                             const Exception &e,
+                             std::function<void (bool)> cb);
       void readChunk(const SmartPointer<Request> &req, uint32_t size,
                      std::function<void (bool)> cb);
       void readChunkTrailer(const SmartPointer<Request> &req,
@@ -87,8 +113,8 @@ namespace cb {
 
       void checkActive(const SmartPointer<Request> &req);
       const SmartPointer<Request> &getRequest();
-      void push(const SmartPointer<Request> &req);
-      void pop();
+      virtual void push(const SmartPointer<Request> &req);
+      virtual void pop();
 
     public:
       // From FD
@@ -33,12 +33,15 @@
 #include "ConnIn.h"
 #include "Server.h"
 #include "Request.h"
+#include "HeaderBlock.h"
 
 #include <cbang/Catch.h>
 #include <cbang/event/Buffer.h>
 #include <cbang/log/Logger.h>
 #include <cbang/ws/Websocket.h>
 
+#include <cstring>
+
 using namespace cb::HTTP;
 using namespace cb;
 using namespace std;
@@ -47,8 +50,10 @@ using namespace std;
 #define CBANG_LOG_PREFIX "CON" << getID() << ':'
 
 
-ConnIn::ConnIn(Server &server) :
-  Conn(server.getBase()), server(server) {}
+ConnIn::ConnIn(Server &server, Event::Base &base) :
+  Conn(base), server(server) {
+  setTrackProgress(false); // Incoming connection progress is not used
+}
 
 
 void ConnIn::writeRequest(
@@ -60,8 +65,15 @@ void ConnIn::writeRequest(
   checkActive(req);
 
   if (getStats().isSet()) getStats()->event(req->getResponseCode().toString());
+  if (!req->isReplying()) server.requestDequeued();
+
+  write(writeCB(req, hasMore, cb), buffer);
+}
+
 
-  auto cb2 =
+function<void (bool)> ConnIn::writeCB(
+  const SmartPointer<Request> &req, bool hasMore, function<void (bool)> cb) {
+  return
     [this, req, hasMore, cb] (bool success) {
       LOG_DEBUG(6, "Response " << (success ? "successful" : "failed")
                 << " hasMore=" << hasMore << " persistent="
@@ -78,24 +90,41 @@ void ConnIn::writeRequest(
       // Free connection if not persistent
       if (!req->isPersistent()) return close();
 
-      // Handle another request
-      if (getNumRequests()) processRequest(getRequest());
-      else readHeader();
+      // Close once all requests read before an input error are answered
+      if (readDone && !getNumRequests()) return close();
+
+      readNext();
+
+      // Handle the next pipelined request, if it has been read completely
+      if (getNumRequests() && getRequest().get() != incomplete)
+        processRequest(getRequest());
     };
+}
+
+
+void ConnIn::push(const SmartPointer<Request> &req) {
+  Conn::push(req);
+  server.requestQueued();
+}
+
 
-  write(cb2, buffer);
+void ConnIn::pop() {
+  if (!getRequest()->isReplying()) server.requestDequeued();
+  Conn::pop();
 }
 
 
 void ConnIn::readHeader() {
   LOG_DEBUG(4, CBANG_FUNC << "()");
 
+  reading = true;
+
   auto cb =
     [this] (bool success) {
       if (maxHeaderSize && maxHeaderSize <= input.getLength())
         error(HTTP_BAD_REQUEST, "Header too large");
 
-      else if (!success) close();
+      else if (!success) endInput();
       else processHeader();
     };
 
@@ -104,25 +133,35 @@ void ConnIn::readHeader() {
 }
 
 
+void ConnIn::readNext() {
+  if (reading || readDone || !isConnected()) return;
+  if (!getNumRequests() || getNumRequests() < maxPipelined) readHeader();
+}
+
+
 void ConnIn::processHeader() {
   LOG_DEBUG(4, CBANG_FUNC << "()");
 
-  // Read first line
+  // Parse the request line and header block from one copy of the input
+  HeaderBlock block;
   Method method;
   URI uri;
   Version version;
   try {
-    string line;
-    input.readLine(line, maxHeaderSize);
-    vector<string> parts;
-    String::tokenize(line, parts, " ");
+    if (!block.read(input, maxHeaderSize, true))
+      THROW("Incomplete headers");
+
+    const HeaderBlock::Span *parts[] = {
+      &block.getStart(0), &block.getStart(1), &block.getStart(2)};
 
-    if (parts.size() != 3)
-      THROW("Invalid request line: " << String::escapeC(line));
+    if (!parts[0]->length || !parts[1]->length || !parts[2]->length ||
+        memchr(block.getData(*parts[2]), ' ', parts[2]->length))
+      THROW("Invalid request line: "
+            << String::escapeC(block.getStartLine()));
 
-    method = Method::parse(parts[0]);
-    uri = parts[1];
-    version = Request::parseHTTPVersion(parts[2]);
+    method = Method::parse(block.getString(*parts[0]));
+    uri = block.getString(*parts[1]);
+    version = Request::parseHTTPVersion(block.getString(*parts[2]));
 
   } catch (const Exception &e) {
     return error(HTTP_BAD_REQUEST, e.getMessage());
@@ -131,14 +170,13 @@ void ConnIn::processHeader() {
   // Create new request (Don't create circular dependency)
   auto req = server.createRequest(SmartPhony(this), method, uri, version);
   push(req);
+  incomplete = req.get();
+  req->setInputHeaders(block);
 
-  // Read header block
-  if (!req->getInputHeaders().parse(input))
-    return error(HTTP_BAD_REQUEST, "Incomplete headers");
-
-  // Headers callback
+  // Headers callback, then rate limits and load shedding before any body
   try {
     req->onHeaders();
+    server.admit(*req);
   } catch (const Exception &e) {
     return error((Status::enum_t)e.getCode(), e.getMessage());
   }
@@ -162,7 +200,8 @@ void ConnIn::processHeader() {
   if (Version(1, 1) <= version) {
     string expect = String::toLower(req->inFind("Expect"));
 
-    if (!expect.empty()) {
+    // Not sent while earlier responses are still being written
+    if (!expect.empty() && getRequest() == req) {
       if (expect == "100-continue" && req->onContinue()) {
         string line = "HTTP/" + version.toString() + " 100 Continue\r\n\r\n";
 
@@ -190,20 +229,22 @@ void ConnIn::checkChunked(const SmartPointer<Request> &req) {
   if (xferEnc == "chunked") {
     auto cb =
       [this, req] (bool success) {
-        if (success) processIfNext(req);
-        else {
+        if (!success) {
           LOG_DEBUG(3, "Incomplete chunked request body");
-          return close();
+          return endInput();
         }
+
+        if (req->isBodyStream()) TRY_CATCH_ERROR(req->onBodyEnd());
+        processIfNext(req);
       };
 
     return readChunks(req, cb);
   }
 
   // Parse Content-Length
-  unsigned contentLength = 0;
+  uint64_t contentLength = 0;
   try {
-    contentLength = String::parseU32(req->inFind("Content-Length"));
+    contentLength = String::parseU64(req->inFind("Content-Length"));
   } catch (const Exception &e) {
     return error(HTTP_BAD_REQUEST, "Invalid Content-Length");
   }
@@ -211,6 +252,8 @@ void ConnIn::checkChunked(const SmartPointer<Request> &req) {
   // Non-chunked request /wo Content-Length has no body
   if (!contentLength) return processIfNext(req);
 
+  if (req->isBodyStream()) return readBody(req, contentLength);
+
   if (maxBodySize && maxBodySize < contentLength)
     return error(HTTP_REQUEST_ENTITY_TOO_LARGE, "Body too large");
 
@@ -224,7 +267,7 @@ void ConnIn::checkChunked(const SmartPointer<Request> &req) {
       if (input.getLength() < contentLength) {
         LOG_DEBUG(3, "Incomplete request body input=" << input.getLength()
           << " ContentLength=" << contentLength);
-        return close();
+        return endInput();
       }
 
       if (contentLength) input.remove(req->getInputBuffer(), contentLength);
@@ -235,6 +278,44 @@ void ConnIn::checkChunked(const SmartPointer<Request> &req) {
 }
 
 
+void ConnIn::readBody(const SmartPointer<Request> &req, uint64_t remaining) {
+  LOG_DEBUG(4, CBANG_FUNC << "() remaining=" << remaining);
+
+  if (!remaining) {
+    TRY_CATCH_ERROR(req->onBodyEnd());
+    return processIfNext(req);
+  }
+
+  unsigned length = min<uint64_t>(remaining, streamBufferSize);
+
+  auto cb =
+    [this, req, remaining, length] (bool success) {
+      if (input.getLength() < length) {
+        LOG_DEBUG(3, "Incomplete streamed request body");
+        return endInput();
+      }
+
+      auto next = [this, req, remaining, length] () {
+        readBody(req, remaining - length);
+      };
+
+      try {
+        addBody(req, length, next);
+      } catch (const Exception &e) {bodyError(req, e, 0);}
+    };
+
+  read(cb, input, length);
+}
+
+
+void ConnIn::bodyError(const SmartPointer<Request> &req, const Exception &e,
+                       function<void (bool)> cb) {
+  // The rest of the body will not be read
+  req->setPersistent(false);
+  error((Status::enum_t)e.getCode(), e.getMessage());
+}
+
+
 void ConnIn::processRequest(const SmartPointer<Request> &req) {
   TRY_CATCH_ERROR(req->onRequest());
   server.dispatch(*req);
@@ -242,8 +323,33 @@ void ConnIn::processRequest(const SmartPointer<Request> &req) {
 
 
 void ConnIn::processIfNext(const SmartPointer<Request> &req) {
+  reading = false;
+  incomplete = 0;
+
+  // Start reading the next request before this one is dispatched, which may
+  // free the connection
+  if (req->isPersistent()) readNext();
+  else readDone = true;
+
   if (getNumRequests() && getRequest() == req) processRequest(req);
-  // TODO Should read the next request in parallel if persistent connection
+}
+
+
+void ConnIn::endInput() {
+  // Drop a partially read request, answered requests were already popped
+  if (incomplete) {
+    if (!requests.back()->isReplying()) server.requestDequeued();
+    requests.back()->onComplete();
+    requests.pop_back();
+    incomplete = 0;
+  }
+
+  reading = false;
+  readDone = true;
+
+  // Otherwise, close after the outstanding responses are written.  Event
+  // streams only end when the client goes away.
+  if (!getNumRequests() || getRequest()->isEventStream()) close();
 }
 
 
@@ -255,6 +361,10 @@ void ConnIn::error(Status code, const string &message) {
 
   LOG_DEBUG(3, "Error: " << code << ": " << message);
 
-  if (!getNumRequests()) close();
-  else getRequest()->sendError(code, message);
+  // Only the active request can be answered immediately
+  if (!incomplete || getRequest().get() != incomplete) return endInput();
+
+  reading = false;
+  incomplete = 0;
+  getRequest()->sendError(code, message);
 }
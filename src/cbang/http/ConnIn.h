@@ -41,26 +41,48 @@ namespace cb {
     class ConnIn : public Conn {
       Server &server;
 
+      unsigned maxPipelined = 1;
+      bool reading = false;
+      bool readDone = false;
+      Request *incomplete = 0;
+
     public:
-      ConnIn(Server &server);
+      ConnIn(Server &server, Event::Base &base);
 
       Server &getServer() {return server;}
 
+      /// Maximum requests read ahead of their responses, including the active
+      unsigned getMaxPipelined() const {return maxPipelined;}
+      void setMaxPipelined(unsigned x) {maxPipelined = x;}
+
       // From Conn
       bool isIncoming() const override {return true;}
       void writeRequest(const SmartPointer<Request> &req, Event::Buffer buffer,
                         bool hasMore, std::function<void (bool)> cb) override;
 
       void readHeader();
+      void readNext();
 
       // From Event::Connection
       void onConnect() override {readHeader();}
 
     protected:
+      std::function<void (bool)>
+      writeCB(const SmartPointer<Request> &req, bool hasMore,
+              std::function<void (bool)> cb) override;
+
+      // From Conn
+      void push(const SmartPointer<Request> &req) override;
+      void pop() override;
+      void bodyError(const SmartPointer<Request> &req, const Exception &e,
+                     std::function<void (bool)> cb) override;
+
       void processHeader();
       void checkChunked(const SmartPointer<Request> &req);
+      void readBody(const SmartPointer<Request> &req, uint64_t remaining);
       void processRequest(const SmartPointer<Request> &req);
       void processIfNext(const SmartPointer<Request> &req);
+      void endInput();
       void error(Status code, const std::string &message);
     };
   }
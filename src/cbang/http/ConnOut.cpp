@@ -57,17 +57,20 @@ void ConnOut::writeRequest(
   LOG_DEBUG(4, "Sending: " << buffer.toString());
 
   checkActive(req);
+  write(writeCB(req, hasMore, cb), buffer);
+}
+
 
-  auto cb2 =
+function<void (bool)> ConnOut::writeCB(
+  const SmartPointer<Request> &req, bool hasMore, function<void (bool)> cb) {
+  return
     [this, req, hasMore, cb] (bool success) {
       if (cb) TRY_CATCH_ERROR(cb(success));
       if (!success) return fail(CONN_ERR_EOF, "Failed to write request");
       if (hasMore) return; // Still writing
 
       readHeader(req);
-   };
-
-  write(cb2, buffer);
+    };
 }
 
 
@@ -205,10 +208,16 @@ void ConnOut::process(const SmartPointer<Request> &req) {
   try {
     req->getInputBuffer().add(input);
 
+    // Go idle before the callback so it can reuse this connection
+    bool idle = idleCB && !getNumRequests() && req->isPersistent() &&
+      req->getResponseCode() != HTTP_SWITCHING_PROTOCOLS;
+    if (idle) idleCB(*this);
+
     // Callback
     req->onResponse(CONN_ERR_OK);
 
     // If not closing send next request
+    if (idle) return;
     if (!req->needsClose()) return dispatch();
   } CATCH_ERROR;
 
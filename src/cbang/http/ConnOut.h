@@ -38,9 +38,18 @@
 namespace cb {
   namespace HTTP {
     class ConnOut : public Conn {
+    public:
+      typedef std::function<void (ConnOut &)> idle_cb_t;
+
+    protected:
+      idle_cb_t idleCB;
+
     public:
       ConnOut(Event::Base &base);
 
+      /// Called when a persistent connection has no more requests
+      void setIdleCallback(idle_cb_t cb) {idleCB = cb;}
+
       // From Conn
       bool isIncoming() const override {return false;}
       void writeRequest(const SmartPointer<Request> &req, Event::Buffer buffer,
@@ -48,6 +57,10 @@ namespace cb {
       void makeRequest(const SmartPointer<Request> &req) override;
 
     protected:
+      std::function<void (bool)>
+      writeCB(const SmartPointer<Request> &req, bool hasMore,
+              std::function<void (bool)> cb) override;
+
       void fail(Event::ConnectionError err, const std::string &msg);
       void readHeader(const SmartPointer<Request> &req);
       void readBody(const SmartPointer<Request> &req);
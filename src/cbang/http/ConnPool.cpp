@@ -0,0 +1,185 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "ConnPool.h"
+#include "ConnOut.h"
+
+#include <cbang/event/Base.h>
+#include <cbang/event/Event.h>
+#include <cbang/String.h>
+#include <cbang/net/URI.h>
+#include <cbang/net/SockAddr.h>
+#include <cbang/time/Time.h>
+#include <cbang/log/Logger.h>
+
+#include <sys/socket.h>
+#include <errno.h>
+
+using namespace std;
+using namespace cb;
+using namespace cb::HTTP;
+
+
+ConnPool::ConnPool(Event::Base &base) :
+  base(base), purgeEvent(base.newEvent(this, &ConnPool::purge, 0)) {}
+
+
+ConnPool::~ConnPool() {close();}
+
+
+string ConnPool::getKey(const URI &uri, const SockAddr &bind) {
+  return uri.getScheme() + "://" + uri.getHost() + ":" +
+    String(uri.getPort()) + (bind.isNull() ? "" : " " + bind.toString());
+}
+
+
+SmartPointer<ConnOut> ConnPool::get(const string &key) {
+  auto it = idle.find(key);
+  if (it == idle.end()) return 0;
+
+  uint64_t now = Time::now();
+
+  while (!it->second.empty()) {
+    // Most recently used first
+    Idle entry = it->second.back();
+    remove(it, --it->second.end());
+
+    if (idleTimeout && entry.since + idleTimeout <= now) event("expired");
+    else if (!isHealthy(*entry.conn)) event("stale");
+    else {
+      event("reused");
+      if (it->second.empty()) idle.erase(it);
+      return entry.conn;
+    }
+
+    entry.conn->close();
+  }
+
+  idle.erase(it);
+  return 0;
+}
+
+
+void ConnPool::put(const string &key, const SmartPointer<ConnOut> &conn) {
+  if (closed || !maxIdle || !maxIdlePerHost || !isHealthy(*conn))
+    return conn->close();
+
+  auto &conns = idle[key];
+
+  // Make room by closing the oldest connections
+  if (maxIdlePerHost <= conns.size()) {
+    conns.front().conn->close();
+    remove(idle.find(key), conns.begin());
+    event("evicted");
+  }
+
+  if (maxIdle <= idleCount) {
+    auto oldest = idle.end();
+
+    for (auto it = idle.begin(); it != idle.end(); it++)
+      if (!it->second.empty() && (oldest == idle.end() ||
+            it->second.front().since < oldest->second.front().since))
+        oldest = it;
+
+    oldest->second.front().conn->close();
+    remove(oldest, oldest->second.begin());
+    event("evicted");
+  }
+
+  conns.push_back(Idle{conn, Time::now()});
+  idleCount++;
+
+  LOG_DEBUG(4, "Pooled connection to " << key << " idle=" << idleCount);
+
+  if (idleTimeout && !purgeEvent->isPending()) purgeEvent->add(idleTimeout);
+}
+
+
+void ConnPool::close() {
+  closed = true;
+
+  for (auto &p: idle)
+    for (auto &entry: p.second)
+      entry.conn->close();
+
+  idle.clear();
+  idleCount = 0;
+
+  if (purgeEvent->isPending()) purgeEvent->del();
+}
+
+
+bool ConnPool::isHealthy(ConnOut &conn) const {
+  if (!conn.isConnected()) return false;
+
+  // An idle connection should have nothing to read, EOF means the peer closed
+  char c;
+  int ret = ::recv(conn.getFD(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+
+void ConnPool::remove(idle_t::iterator it, list<Idle>::iterator conn) {
+  it->second.erase(conn);
+  idleCount--;
+}
+
+
+void ConnPool::purge() {
+  uint64_t now = Time::now();
+  uint64_t next = 0;
+
+  for (auto it = idle.begin(); it != idle.end();) {
+    auto &conns = it->second;
+
+    while (!conns.empty() && conns.front().since + idleTimeout <= now) {
+      conns.front().conn->close();
+      remove(it, conns.begin());
+      event("expired");
+    }
+
+    if (!conns.empty()) {
+      uint64_t expires = conns.front().since + idleTimeout;
+      if (!next || expires < next) next = expires;
+    }
+
+    if (conns.empty()) it = idle.erase(it);
+    else it++;
+  }
+
+  if (next) purgeEvent->add(next - now);
+}
+
+
+void ConnPool::event(const string &key) {
+  if (stats.isSet()) stats->event("pool-" + key);
+}
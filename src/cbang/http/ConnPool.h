@@ -0,0 +1,113 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/SmartPointer.h>
+#include <cbang/util/RateSet.h>
+
+#include <map>
+#include <list>
+#include <string>
+#include <cstdint>
+
+
+namespace cb {
+  class URI;
+  class SockAddr;
+
+  namespace Event {
+    class Base;
+    class Event;
+  }
+
+  namespace HTTP {
+    class ConnOut;
+
+    /***
+     * Idle persistent client connections keyed by scheme, host, port and
+     * bind address.  Connections are checked before reuse and closed after
+     * the idle timeout or when the idle limits are exceeded.
+     */
+    class ConnPool {
+      Event::Base &base;
+      SmartPointer<RateSet> stats;
+
+      unsigned maxIdle        = 64;
+      unsigned maxIdlePerHost = 8;
+      unsigned idleTimeout    = 60;
+      bool closed = false;
+
+      struct Idle {
+        SmartPointer<ConnOut> conn;
+        uint64_t since;
+      };
+
+      typedef std::map<std::string, std::list<Idle> > idle_t;
+      idle_t idle;
+      unsigned idleCount = 0;
+
+      SmartPointer<Event::Event> purgeEvent;
+
+    public:
+      ConnPool(Event::Base &base);
+      ~ConnPool();
+
+      const SmartPointer<RateSet> &getStats() const {return stats;}
+      void setStats(const SmartPointer<RateSet> &stats) {this->stats = stats;}
+
+      unsigned getMaxIdle() const {return maxIdle;}
+      void setMaxIdle(unsigned x) {maxIdle = x;}
+
+      unsigned getMaxIdlePerHost() const {return maxIdlePerHost;}
+      void setMaxIdlePerHost(unsigned x) {maxIdlePerHost = x;}
+
+      unsigned getIdleTimeout() const {return idleTimeout;}
+      void setIdleTimeout(unsigned timeout) {idleTimeout = timeout;}
+
+      unsigned getIdleCount() const {return idleCount;}
+
+      static std::string getKey(const URI &uri, const SockAddr &bind);
+
+      /// @return a healthy idle connection or null
+      SmartPointer<ConnOut> get(const std::string &key);
+      void put(const std::string &key, const SmartPointer<ConnOut> &conn);
+      void close();
+
+    protected:
+      bool isHealthy(ConnOut &conn) const;
+      void remove(idle_t::iterator it, std::list<Idle>::iterator conn);
+      void purge();
+      void event(const std::string &key);
+    };
+  }
+}
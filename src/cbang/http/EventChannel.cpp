@@ -0,0 +1,168 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "EventChannel.h"
+#include "Conn.h"
+
+#include <cbang/event/Base.h>
+#include <cbang/event/Event.h>
+#include <cbang/json/Value.h>
+#include <cbang/thread/SmartLock.h>
+
+#include <algorithm>
+
+using namespace std;
+using namespace cb;
+using namespace cb::HTTP;
+
+
+EventChannel::~EventChannel() {
+  // Cancel pending deliveries before the groups are freed
+  for (auto &p: groups) p.second->event->del();
+}
+
+
+uint64_t EventChannel::getLastID() const {
+  SmartLock lock(this);
+  return lastID;
+}
+
+
+unsigned EventChannel::getNumSubscribers() const {
+  SmartLock lock(this);
+  return subscribers;
+}
+
+
+void EventChannel::subscribe(const EventStreamPtr &stream) {
+  if (!stream->isChunked()) stream->open();
+  if (stream->isClosed()) return;
+
+  uint64_t lastEventID = stream->getLastEventID();
+  vector<MessagePtr> missed;
+
+  {
+    SmartLock lock(this);
+
+    stream->setChannel(this);
+
+    auto &base = stream->getConnection()->getBase();
+    auto &group = groups[&base];
+
+    if (group.isNull()) {
+      group = new Group;
+      Group *ptr = group.get();
+      group->event = base.newEvent([this, ptr] () {deliver(*ptr);}, 0);
+    }
+
+    group->subscribers.push_back(stream);
+    subscribers++;
+
+    if (lastEventID)
+      for (auto &msg: replay)
+        if (lastEventID < msg->id) missed.push_back(msg);
+  }
+
+  for (auto &msg: missed) stream->sendEvent(msg->id, Event::Buffer(msg->text));
+}
+
+
+void EventChannel::unsubscribe(EventStream &stream) {
+  {
+    SmartLock lock(this);
+
+    for (auto &p: groups) {
+      auto &subs = p.second->subscribers;
+
+      for (auto it = subs.begin(); it != subs.end(); it++)
+        if (it->get() == &stream) {
+          subs.erase(it);
+          subscribers--;
+          break;
+        }
+    }
+  }
+
+  stream.setChannel(0);
+}
+
+
+uint64_t EventChannel::broadcast(const string &data, const string &event) {
+  SmartPointer<Message> msg = new Message;
+
+  SmartLock lock(this);
+
+  // Formatted once for all subscribers
+  msg->id = ++lastID;
+  msg->text = EventStream::format(data, event, msg->id);
+
+  if (replaySize) {
+    replay.push_back(msg);
+    while (replaySize < replay.size()) replay.pop_front();
+  }
+
+  for (auto &p: groups) {
+    Group &group = *p.second;
+    if (group.subscribers.empty()) continue;
+
+    group.pending.push_back(msg);
+    group.event->activate();
+  }
+
+  return msg->id;
+}
+
+
+uint64_t EventChannel::broadcast(const JSON::Value &data,
+                                 const string &event) {
+  return broadcast(data.toString(0, true), event);
+}
+
+
+void EventChannel::deliver(Group &group) {
+  vector<MessagePtr> pending;
+  vector<EventStreamPtr> subs;
+
+  {
+    SmartLock lock(this);
+    pending.swap(group.pending);
+    subs = group.subscribers;
+  }
+
+  for (auto &msg: pending) {
+    // One buffer shared by reference with every subscriber.  References are
+    // released on the subscribers' connection threads.
+    Event::Buffer buf(msg->text);
+    buf.enableLocking();
+    for (auto &stream: subs) stream->sendEvent(msg->id, buf);
+  }
+}
@@ -0,0 +1,104 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include "EventStream.h"
+
+#include <cbang/RefCounter.h>
+#include <cbang/thread/Mutex.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+
+namespace cb {
+  namespace Event {
+    class Base;
+    class Event;
+  }
+
+  namespace HTTP {
+    /// Broadcasts Server-Sent Events to many EventStreams.  Each event is
+    /// formatted once and written to the subscribers on each thread from a
+    /// single shared Event::Buffer.  Recent events are kept for clients
+    /// which reconnect with a Last-Event-ID.
+    class EventChannel : public Mutex, virtual public RefCounted {
+      struct Message {
+        uint64_t id;
+        std::string text;
+      };
+
+      typedef SmartPointer<Message> MessagePtr;
+
+      // Subscribers are only written to from their own Base
+      struct Group {
+        SmartPointer<Event::Event> event;
+        std::vector<MessagePtr> pending;
+        std::vector<EventStreamPtr> subscribers;
+      };
+
+      unsigned replaySize;
+      std::deque<MessagePtr> replay;
+      std::map<Event::Base *, SmartPointer<Group> > groups;
+      uint64_t lastID = 0;
+      unsigned subscribers = 0;
+
+    public:
+      EventChannel(unsigned replaySize = 1024) : replaySize(replaySize) {}
+      ~EventChannel();
+
+      unsigned getReplaySize() const {return replaySize;}
+      void setReplaySize(unsigned x) {replaySize = x;}
+
+      uint64_t getLastID() const;
+      unsigned getNumSubscribers() const;
+
+      /// Must be called from the stream's event loop, usually by its handler.
+      /// Opens the stream if needed and replays missed events.
+      void subscribe(const EventStreamPtr &stream);
+      void unsubscribe(EventStream &stream);
+
+      /// May be called from any thread.  @return the event's id
+      uint64_t broadcast(const std::string &data,
+                         const std::string &event = "");
+      uint64_t broadcast(const JSON::Value &data,
+                         const std::string &event = "");
+
+    protected:
+      void deliver(Group &group);
+    };
+
+    typedef SmartPointer<EventChannel> EventChannelPtr;
+  }
+}
@@ -0,0 +1,169 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "EventStream.h"
+#include "EventChannel.h"
+#include "Conn.h"
+
+#include <cbang/String.h>
+#include <cbang/log/Logger.h>
+
+using namespace std;
+using namespace cb;
+using namespace cb::HTTP;
+
+
+EventStream::EventStream(const SmartPointer<Conn> &connection, Method method,
+                         const URI &uri, const Version &version) :
+  Request(connection, method, uri, version) {}
+
+
+uint64_t EventStream::getLastEventID() const {
+  string id = inFind("Last-Event-ID");
+  uint64_t value = 0;
+
+  if (!String::parse(id, value, true)) return 0;
+  return value;
+}
+
+
+void EventStream::open(unsigned retry) {
+  setContentType("text/event-stream");
+  outSet("Cache-Control", "no-cache");
+
+  writes.push_back(0); // Headers
+  startChunked(HTTP_OK);
+
+  if (retry) write(Event::Buffer(SSTR("retry: " << retry << "\n\n")));
+}
+
+
+void EventStream::close() {
+  if (closed) return;
+
+  if (isChunked()) {
+    writes.push_back(0);
+    endChunked();
+  }
+
+  closed = true;
+}
+
+
+void EventStream::sendEvent(const string &data, const string &event) {
+  write(Event::Buffer(format(data, event)));
+}
+
+
+void EventStream::sendComment(const string &comment) {
+  string text;
+  vector<string> lines;
+  String::tokenize(comment, lines, "\n", true);
+  for (auto &line: lines) text += ": " + line + "\n";
+  write(Event::Buffer(text + "\n"));
+}
+
+
+bool EventStream::sendEvent(uint64_t id, const Event::Buffer &buf) {
+  if (id <= lastID) return true; // Already sent
+  lastID = id;
+
+  Event::Buffer ref;
+  ref.addRef(buf);
+
+  return write(ref);
+}
+
+
+string EventStream::format(const string &data, const string &event,
+                           uint64_t id) {
+  string text;
+
+  if (id) text += SSTR("id: " << id << '\n');
+  if (!event.empty()) text += "event: " + event + '\n';
+
+  vector<string> lines;
+  String::tokenize(data, lines, "\n", true);
+  if (lines.empty()) lines.push_back("");
+
+  for (auto &line: lines)
+    text += "data: " + String::trimRight(line, "\r") + '\n';
+
+  return text + '\n';
+}
+
+
+void EventStream::setChannel(const SmartPointer<EventChannel> &channel) {
+  if (this->channel.isSet() && channel.isSet() && this->channel != channel)
+    THROW("EventStream already subscribed to a channel");
+  this->channel = channel;
+}
+
+
+void EventStream::onWriteComplete(bool success) {
+  if (writes.empty()) return;
+  queued -= writes.front();
+  writes.pop_front();
+}
+
+
+void EventStream::onComplete() {
+  closed = true;
+
+  // Breaks the reference cycle with the channel
+  auto channel = this->channel;
+  if (channel.isSet()) channel->unsubscribe(*this);
+}
+
+
+bool EventStream::write(const Event::Buffer &buf) {
+  if (closed || !isChunked()) return false;
+
+  unsigned length = buf.getLength();
+
+  if (maxQueued < queued + length) {
+    if (disconnectSlow) {
+      LOG_DEBUG(3, "Closing slow event stream with " << queued
+                << " bytes queued");
+      getConnection()->close();
+
+    } else dropped++;
+
+    return false;
+  }
+
+  writes.push_back(length);
+  queued += length;
+  sendChunk(buf);
+
+  return true;
+}
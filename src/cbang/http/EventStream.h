@@ -0,0 +1,107 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include "Request.h"
+
+#include <deque>
+
+
+namespace cb {
+  namespace HTTP {
+    class EventChannel;
+
+    /// A Server-Sent Events (text/event-stream) response.  Create it from
+    /// Server::createRequest() and call open() from the handler.
+    class EventStream : public Request {
+      unsigned maxQueued = 256 * 1024;
+      bool disconnectSlow = false;
+
+      std::deque<unsigned> writes; // Sizes of writes not yet completed
+      uint64_t queued = 0;
+      uint64_t lastID = 0;
+      uint64_t dropped = 0;
+      bool closed = false;
+
+      SmartPointer<EventChannel> channel;
+
+    public:
+      EventStream(const SmartPointer<Conn> &connection, Method method,
+                  const URI &uri, const Version &version);
+
+      /// Bytes written to the connection but not yet sent
+      uint64_t getQueued() const {return queued;}
+      uint64_t getDropped() const {return dropped;}
+      bool isClosed() const {return closed;}
+
+      /// Events are dropped, or the connection closed, rather than queue
+      /// more than this many bytes for a slow reader
+      unsigned getMaxQueued() const {return maxQueued;}
+      void setMaxQueued(unsigned x) {maxQueued = x;}
+      bool getDisconnectSlow() const {return disconnectSlow;}
+      void setDisconnectSlow(bool x) {disconnectSlow = x;}
+
+      /// Zero if Last-Event-ID is missing or not an id from an EventChannel
+      uint64_t getLastEventID() const;
+
+      /// Starts the stream.  @param retry is the client reconnect delay in ms
+      void open(unsigned retry = 0);
+      void close();
+
+      void sendEvent(const std::string &data, const std::string &event = "");
+      void sendComment(const std::string &comment);
+      /// Adds a reference to @param buf, which must not be modified after.
+      /// The reference is released on the connection's thread so @param buf
+      /// must have locking enabled if it is shared between connections.
+      /// @return false if the event was dropped
+      bool sendEvent(uint64_t id, const Event::Buffer &buf);
+
+      static std::string format(const std::string &data,
+                                const std::string &event = "",
+                                uint64_t id = 0);
+
+      // Used by EventChannel
+      void setChannel(const SmartPointer<EventChannel> &channel);
+
+      // From Request
+      bool isEventStream() const override {return true;}
+      void onWriteComplete(bool success) override;
+      void onComplete() override;
+
+    protected:
+      bool write(const Event::Buffer &buf);
+    };
+
+    typedef SmartPointer<EventStream> EventStreamPtr;
+  }
+}
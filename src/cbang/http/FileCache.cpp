@@ -0,0 +1,271 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "FileCache.h"
+#include "ContentTypes.h"
+
+#include <cbang/String.h>
+#include <cbang/os/SystemUtilities.h>
+#include <cbang/time/Time.h>
+#include <cbang/thread/SmartLock.h>
+#include <cbang/log/Logger.h>
+
+#include <sys/stat.h>
+
+using namespace std;
+using namespace cb;
+using namespace cb::HTTP;
+
+
+namespace {
+  const char *httpTime = "%a, %d %b %Y %H:%M:%S GMT";
+
+  const Compression encodings[] = {
+    Compression::COMPRESSION_GZIP, Compression::COMPRESSION_LZ4};
+
+
+  bool statFile(const string &path, struct stat &info) {
+    return !stat(path.c_str(), &info) && S_ISREG(info.st_mode);
+  }
+
+
+#ifndef _WIN32
+  uint64_t toNS(const struct timespec &ts) {
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  }
+#endif
+
+
+  // Whole seconds where stat() has no nanoseconds
+  uint64_t modifiedNS(const struct stat &info) {
+#if defined(_WIN32)
+    return (uint64_t)info.st_mtime * 1000000000;
+#elif defined(__APPLE__)
+    return toNS(info.st_mtimespec);
+#else
+    return toNS(info.st_mtim);
+#endif
+  }
+
+
+  uint64_t changedNS(const struct stat &info) {
+#if defined(_WIN32)
+    return (uint64_t)info.st_ctime * 1000000000;
+#elif defined(__APPLE__)
+    return toNS(info.st_ctimespec);
+#else
+    return toNS(info.st_ctim);
+#endif
+  }
+
+
+  bool matches(const FileCache::Entry &entry, const struct stat &info) {
+    // A rewrite in place keeps the inode and often the size, but always
+    // moves the change time
+    return entry.size == (uint64_t)info.st_size &&
+      entry.mtimeNS == modifiedNS(info) &&
+      entry.ctimeNS == changedNS(info) &&
+      entry.inode == (uint64_t)info.st_ino;
+  }
+}
+
+
+FileCache::EntryPtr FileCache::Entry::getEncoded(Compression comp) const {
+  auto it = encoded.find(comp);
+  return it == encoded.end() ? 0 : it->second;
+}
+
+
+void FileCache::setMaxEntries(unsigned x) {
+  SmartLock lock(this);
+  maxEntries = x;
+  evict();
+}
+
+
+void FileCache::setMaxBytes(uint64_t x) {
+  SmartLock lock(this);
+  maxBytes = x;
+  evict();
+}
+
+
+unsigned FileCache::getEntryCount() const {
+  SmartLock lock(this);
+  return entries.size();
+}
+
+
+uint64_t FileCache::getByteCount() const {
+  SmartLock lock(this);
+  return bytes;
+}
+
+
+FileCache::EntryPtr FileCache::get(const string &path) {
+  struct stat info;
+  bool isFile = statFile(path, info);
+
+  {
+    SmartLock lock(this);
+
+    auto it = entries.find(path);
+    if (it != entries.end()) {
+      bool valid = isFile && matches(*it->second.entry, info);
+
+      // A sibling which changed or vanished also invalidates the entry
+      if (valid)
+        for (auto &p: it->second.entry->encoded) {
+          struct stat sibling;
+          if (!statFile(p.second->path, sibling) ||
+              !matches(*p.second, sibling)) valid = false;
+        }
+
+      if (valid) {
+        lru.splice(lru.begin(), lru, it->second.lru);
+        event("hit");
+        return it->second.entry;
+      }
+
+      event("invalidated");
+      remove(it);
+    }
+  }
+
+  if (!isFile) return 0;
+
+  // Read outside the lock
+  event("miss");
+  string type = ContentTypes::guess(path, "application/octet-stream");
+  EntryPtr entry = load(path, info, type, precompressed);
+
+  SmartLock lock(this);
+  insert(path, entry);
+
+  return entry;
+}
+
+
+void FileCache::invalidate(const string &path) {
+  SmartLock lock(this);
+  auto it = entries.find(path);
+  if (it != entries.end()) remove(it);
+}
+
+
+void FileCache::clear() {
+  SmartLock lock(this);
+  entries.clear();
+  lru.clear();
+  bytes = 0;
+}
+
+
+FileCache::EntryPtr FileCache::load(const string &path,
+                                    const struct stat &info,
+                                    const string &contentType, bool siblings) {
+  SmartPointer<Entry> entry = new Entry;
+
+  entry->path  = path;
+  entry->size  = info.st_size;
+  entry->mtime = info.st_mtime;
+  entry->mtimeNS = modifiedNS(info);
+  entry->ctimeNS = changedNS(info);
+  entry->inode = info.st_ino;
+  entry->etag  = String::printf("\"%llx-%llx-%llx-%llx\"",
+                                (unsigned long long)entry->inode,
+                                (unsigned long long)entry->mtimeNS,
+                                (unsigned long long)entry->ctimeNS,
+                                (unsigned long long)entry->size);
+  entry->lastModified = Time(entry->mtime).toString(httpTime);
+  entry->contentType  = contentType;
+
+  if (entry->size <= maxFileSize) {
+    entry->content = new string(SystemUtilities::read(path, entry->size));
+
+    // The file changed while it was read, don't cache stale content
+    if (entry->content->length() != entry->size) entry->content.release();
+  }
+
+  if (siblings)
+    for (auto comp: encodings) {
+      string sibling = path + compressionExtension(comp);
+      struct stat sinfo;
+
+      // Only use siblings at least as new as the original
+      if (statFile(sibling, sinfo) && modifiedNS(info) <= modifiedNS(sinfo)) {
+        entry->encoded[comp] = load(sibling, sinfo, contentType, false);
+      }
+    }
+
+  return entry;
+}
+
+
+void FileCache::insert(const string &path, const EntryPtr &entry) {
+  auto it = entries.find(path);
+  if (it != entries.end()) remove(it); // Loaded concurrently
+
+  lru.push_front(path);
+  entries[path] = Slot{entry, lru.begin()};
+
+  bytes += entry->isCached() ? entry->size : 0;
+  for (auto &p: entry->encoded)
+    bytes += p.second->isCached() ? p.second->size : 0;
+
+  evict();
+}
+
+
+void FileCache::remove(entries_t::iterator it) {
+  auto &entry = *it->second.entry;
+
+  bytes -= entry.isCached() ? entry.size : 0;
+  for (auto &p: entry.encoded)
+    bytes -= p.second->isCached() ? p.second->size : 0;
+
+  lru.erase(it->second.lru);
+  entries.erase(it);
+}
+
+
+void FileCache::evict() {
+  while (!lru.empty() && (maxEntries < entries.size() || maxBytes < bytes)) {
+    remove(entries.find(lru.back()));
+    event("evicted");
+  }
+}
+
+
+void FileCache::event(const string &key) {
+  if (stats.isSet()) stats->event("file-cache-" + key);
+}
@@ -0,0 +1,137 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/SmartPointer.h>
+#include <cbang/thread/Mutex.h>
+#include <cbang/util/RateSet.h>
+#include <cbang/comp/Compression.h>
+
+#include <map>
+#include <list>
+#include <string>
+#include <cstdint>
+
+struct stat;
+
+
+namespace cb {
+  namespace HTTP {
+    /***
+     * Metadata and, for small files, contents of recently served files.
+     * Every lookup stats the file and each of its precompressed siblings
+     * and drops the entry if the size, inode or the nanosecond
+     * modification or change time differ.  Entries are evicted least
+     * recently used first once either the entry count or total cached
+     * bytes exceeds its limit.
+     */
+    class FileCache : public Mutex {
+    public:
+      struct Entry {
+        std::string path;
+        uint64_t size  = 0;
+        uint64_t mtime = 0; ///< Seconds, for Last-Modified
+        uint64_t mtimeNS = 0;
+        uint64_t ctimeNS = 0;
+        uint64_t inode = 0;
+
+        std::string etag;
+        std::string lastModified;
+        std::string contentType;
+
+        /// File contents if the file is no larger than the max file size
+        SmartPointer<std::string> content;
+
+        /// Precompressed siblings, such as "index.html.gz"
+        std::map<Compression, SmartPointer<const Entry> > encoded;
+
+        bool isCached() const {return content.isSet();}
+        SmartPointer<const Entry> getEncoded(Compression compression) const;
+      };
+
+      typedef SmartPointer<const Entry> EntryPtr;
+
+    protected:
+      SmartPointer<RateSet> stats;
+
+      unsigned maxEntries  = 1024;
+      uint64_t maxBytes    = 64 * 1024 * 1024;
+      uint64_t maxFileSize = 256 * 1024;
+      bool precompressed   = true;
+
+      struct Slot {
+        EntryPtr entry;
+        std::list<std::string>::iterator lru;
+      };
+
+      typedef std::map<std::string, Slot> entries_t;
+      entries_t entries;
+      std::list<std::string> lru; // Most recently used at the front
+      uint64_t bytes = 0;
+
+    public:
+      const SmartPointer<RateSet> &getStats() const {return stats;}
+      void setStats(const SmartPointer<RateSet> &stats) {this->stats = stats;}
+
+      unsigned getMaxEntries() const {return maxEntries;}
+      void setMaxEntries(unsigned x);
+
+      uint64_t getMaxBytes() const {return maxBytes;}
+      void setMaxBytes(uint64_t x);
+
+      /// Files larger than this are sent from disk, only metadata is cached
+      uint64_t getMaxFileSize() const {return maxFileSize;}
+      void setMaxFileSize(uint64_t x) {maxFileSize = x;}
+
+      /// Look for ".gz" and ".lz4" siblings of each cached file
+      bool getPrecompressed() const {return precompressed;}
+      void setPrecompressed(bool x) {precompressed = x;}
+
+      unsigned getEntryCount() const;
+      uint64_t getByteCount() const;
+
+      /// @return the current entry for @param path or null if not a file
+      EntryPtr get(const std::string &path);
+      void invalidate(const std::string &path);
+      void clear();
+
+    protected:
+      EntryPtr load(const std::string &path, const struct stat &info,
+                    const std::string &contentType, bool siblings);
+      void insert(const std::string &path, const EntryPtr &entry);
+      void remove(entries_t::iterator it);
+      void evict();
+      void event(const std::string &key);
+    };
+  }
+}
@@ -33,8 +33,10 @@
 #include "FileHandler.h"
 #include "Request.h"
 
-#include <cbang/event/Buffer.h>
+#include <cbang/String.h>
 #include <cbang/os/SystemUtilities.h>
+#include <cbang/time/Time.h>
+#include <cbang/util/Random.h>
 #include <cbang/log/Logger.h>
 
 using namespace std;
@@ -42,51 +44,257 @@ using namespace cb;
 using namespace cb::HTTP;
 
 
+namespace {
+  const char *httpTime = "%a, %d %b %Y %H:%M:%S GMT";
+
+
+  bool etagMatches(const string &header, const string &etag, bool weak) {
+    vector<string> tags;
+    String::tokenize(header, tags, ", \t");
+
+    for (auto tag: tags) {
+      if (tag == "*") return true;
+      if (weak && String::startsWith(tag, "W/")) tag = tag.substr(2);
+      if (tag == etag) return true;
+    }
+
+    return false;
+  }
+
+
+  bool notModifiedSince(const string &header, const string &lastModified,
+                        uint64_t mtime) {
+    if (header == lastModified) return true;
+
+    try {
+      return mtime <= Time::parse(header, httpTime);
+    } catch (const Exception &e) {
+      LOG_DEBUG(4, "Invalid HTTP date: " << e.getMessage());
+    }
+
+    return false;
+  }
+}
+
+
 FileHandler::FileHandler(const JSON::ValuePtr &config) :
-  FileHandler(config->getString("path"), config->getU32("prefix", 0)) {}
+  FileHandler(config->getString("path"), config->getU32("prefix", 0)) {
+  cache->setMaxEntries(config->getU32("cache-entries",
+                                      cache->getMaxEntries()));
+  cache->setMaxBytes(config->getU64("cache-bytes", cache->getMaxBytes()));
+  cache->setMaxFileSize(config->getU64("cache-file-size",
+                                       cache->getMaxFileSize()));
+  cache->setPrecompressed(config->getBoolean("precompressed",
+                                             cache->getPrecompressed()));
+}
 
 
-FileHandler::FileHandler(const string &root, unsigned pathPrefix) :
+FileHandler::FileHandler(const string &root, unsigned pathPrefix,
+                         const SmartPointer<FileCache> &cache) :
   root(root), pathPrefix(pathPrefix),
-  directory(SystemUtilities::isDirectory(root)) {}
+  directory(SystemUtilities::isDirectory(root)), cache(cache) {
+  if (cache.isNull()) THROW("FileCache cannot be null");
+}
 
 
-bool FileHandler::operator()(Request &req) {
-  string path;
+bool FileHandler::parseRanges(const string &header, uint64_t size,
+                              ranges_t &ranges, unsigned maxRanges) {
+  ranges.clear();
 
-  if (directory) {
-    string orig = req.getURI().getPath();
-    if (orig.length() <= pathPrefix) return false;
-    orig = orig.substr(pathPrefix);
+  if (!String::startsWith(header, "bytes=")) return false;
 
-    // Remove unsafe parts
-    vector<string> parts;
-    String::tokenize(orig, parts, "/");
-    vector<string> result;
+  vector<string> specs;
+  String::tokenize(header.substr(6), specs, ", \t");
+  if (specs.empty() || maxRanges < specs.size()) return false;
 
-    for (unsigned i = 0; i < parts.size(); i++) {
-      if (parts[i] == ".") continue;
-      if (parts[i] == "..") {
-        if (result.empty()) THROWX("Invalid path", HTTP_UNAUTHORIZED);
-        result.pop_back();
+  for (auto &spec: specs) {
+    size_t dash = spec.find('-');
+    if (dash == string::npos) return false;
 
-      } else result.push_back(parts[i]);
-    }
+    string first = spec.substr(0, dash);
+    string last = spec.substr(dash + 1);
+    if (first.empty() && last.empty()) return false;
 
-    // Relative to root
-    path = SystemUtilities::joinPath(root, String::join(result, "/"));
-    if (path.back() != '/' && orig.back() == '/') path += "/";
+    if (first.find_first_not_of("0123456789") != string::npos ||
+        last.find_first_not_of("0123456789") != string::npos) return false;
 
-  } else path = root; // Single file
+    uint64_t start;
+    uint64_t end;
+
+    try {
+      if (first.empty()) { // Suffix range
+        uint64_t suffix = String::parseU64(last);
+        start = suffix < size ? size - suffix : 0;
+        end = size;
+
+      } else {
+        start = String::parseU64(first);
+        end = last.empty() ? size : String::parseU64(last) + 1;
+        if (end <= start && !last.empty()) return false;
+        if (size < end) end = size;
+      }
+    } catch (const Exception &) {return false;} // Overflow
+
+    if (size <= start || end <= start) continue; // Unsatisfiable
+
+    ranges.push_back(ranges_t::value_type(start, end - start));
+  }
+
+  return true;
+}
+
+
+bool FileHandler::operator()(Request &req) {
+  string path = getPath(req);
+  if (path.empty()) return false;
 
   LOG_INFO(5, "FileHandler() " << path);
 
-  if (!SystemUtilities::isFile(path)) return false;
+  auto entry = cache->get(path);
+  if (entry.isNull()) return false;
+
+  // Use a precompressed sibling if the client accepts its encoding
+  auto body = entry;
+  Compression compression = req.getRequestedCompression();
+  if (compression != COMPRESSION_NONE) {
+    auto encoded = entry->getEncoded(compression);
+    if (encoded.isSet()) body = encoded;
+  }
+
+  if (!entry->encoded.empty()) req.outSet("Vary", "Accept-Encoding");
+  req.outSet("ETag", body->etag);
+  req.outSet("Last-Modified", entry->lastModified);
+
+  if (isNotModified(req, *body)) {
+    req.reply(HTTP_NOT_MODIFIED);
+    return true;
+  }
+
+  req.outSet("Accept-Ranges", "bytes");
+  if (!req.hasContentType()) req.setContentType(entry->contentType);
+  if (body != entry) req.outSetContentEncoding(compression);
+
+  if (rangeApplies(req, *body)) {
+    ranges_t ranges;
+
+    if (parseRanges(req.inGet("Range"), body->size, ranges)) {
+      if (ranges.empty()) {
+        req.outSet("Content-Range", "bytes */" + String(body->size));
+        req.reply(HTTP_REQUESTED_RANGE_NOT_SATISFIABLE);
+
+      } else sendRanges(req, *body, ranges);
 
-  // Send file
-  Event::Buffer buf;
-  buf.addFile(path);
-  req.reply(buf);
+      return true;
+    }
+  }
+
+  send(req, *body, 0, body->size);
+  req.reply();
 
   return true;
 }
+
+
+string FileHandler::getPath(const Request &req) const {
+  if (!directory) return root; // Single file
+
+  string orig = req.getURI().getPath();
+  if (orig.length() <= pathPrefix) return "";
+  orig = orig.substr(pathPrefix);
+
+  // Remove unsafe parts
+  vector<string> parts;
+  String::tokenize(orig, parts, "/");
+  vector<string> result;
+
+  for (unsigned i = 0; i < parts.size(); i++) {
+    if (parts[i] == ".") continue;
+    if (parts[i] == "..") {
+      if (result.empty()) THROWX("Invalid path", HTTP_UNAUTHORIZED);
+      result.pop_back();
+
+    } else result.push_back(parts[i]);
+  }
+
+  // Relative to root
+  string path = SystemUtilities::joinPath(root, String::join(result, "/"));
+  if (path.back() != '/' && orig.back() == '/') path += "/";
+
+  return path;
+}
+
+
+bool FileHandler::isNotModified(const Request &req,
+                                const FileCache::Entry &entry) const {
+  Method method = req.getMethod();
+  if (method != HTTP_GET && method != HTTP_HEAD) return false;
+
+  // If-None-Match takes precedence over If-Modified-Since
+  if (req.inHas("If-None-Match"))
+    return etagMatches(req.inGet("If-None-Match"), entry.etag, true);
+
+  if (req.inHas("If-Modified-Since"))
+    return notModifiedSince(req.inGet("If-Modified-Since"),
+                            entry.lastModified, entry.mtime);
+
+  return false;
+}
+
+
+bool FileHandler::rangeApplies(const Request &req,
+                               const FileCache::Entry &entry) const {
+  if (req.getMethod() != HTTP_GET || !req.inHas("Range")) return false;
+  if (!req.inHas("If-Range")) return true;
+
+  // Only send a range of the representation the client already has
+  string ifRange = req.inGet("If-Range");
+  if (String::startsWith(ifRange, "\"") || String::startsWith(ifRange, "W/"))
+    return etagMatches(ifRange, entry.etag, false);
+
+  return ifRange == entry.lastModified;
+}
+
+
+void FileHandler::send(Request &req, const FileCache::Entry &entry,
+                       uint64_t offset, uint64_t length) {
+  if (req.getMethod() == HTTP_HEAD)
+    return req.outSet("Content-Length", String(length));
+
+  if (entry.isCached()) req.send(entry.content->data() + offset, length);
+  else req.sendFile(entry.path, offset, length);
+}
+
+
+void FileHandler::sendRanges(Request &req, const FileCache::Entry &entry,
+                             const ranges_t &ranges) {
+  auto contentRange = [&entry] (uint64_t offset, uint64_t length) {
+    return String::printf("bytes %llu-%llu/%llu", (unsigned long long)offset,
+                          (unsigned long long)(offset + length - 1),
+                          (unsigned long long)entry.size);
+  };
+
+  if (ranges.size() == 1) {
+    uint64_t offset = ranges[0].first;
+    uint64_t length = ranges[0].second;
+
+    req.outSet("Content-Range", contentRange(offset, length));
+    send(req, entry, offset, length);
+    return req.reply(HTTP_PARTIAL_CONTENT);
+  }
+
+  string boundary =
+    String::printf("%016llx", (unsigned long long)Random::instance()
+                   .rand<uint64_t>());
+  string type = req.getContentType();
+  req.setContentType("multipart/byteranges; boundary=" + boundary);
+
+  for (auto &range: ranges) {
+    req.send("\r\n--" + boundary + "\r\nContent-Type: " + type +
+             "\r\nContent-Range: " + contentRange(range.first, range.second) +
+             "\r\n\r\n");
+    send(req, entry, range.first, range.second);
+  }
+
+  req.send("\r\n--" + boundary + "--\r\n");
+  req.reply(HTTP_PARTIAL_CONTENT);
+}
@@ -33,28 +33,62 @@
 #pragma once
 
 #include "RequestHandler.h"
+#include "FileCache.h"
 
 #include <cbang/json/Value.h>
 #include <cbang/time/Time.h>
 
 #include <string>
+#include <vector>
+#include <cstdint>
 
 
 namespace cb {
   namespace HTTP {
     class Request;
 
+    /***
+     * Serves files with ETag and Last-Modified headers, answers conditional
+     * requests with 304 and byte ranges with 206.  Precompressed ".gz" or
+     * ".lz4" siblings are sent if the client accepts that encoding.
+     */
     class FileHandler : public RequestHandler {
       std::string root;
       unsigned    pathPrefix;
       bool        directory;
+      SmartPointer<FileCache> cache;
 
     public:
       FileHandler(const JSON::ValuePtr &config);
-      FileHandler(const std::string &root, unsigned pathPrefix = 0);
+      FileHandler(const std::string &root, unsigned pathPrefix = 0,
+                  const SmartPointer<FileCache> &cache = new FileCache);
+
+      /// May be shared between handlers
+      const SmartPointer<FileCache> &getCache() const {return cache;}
+
+      typedef std::vector<std::pair<uint64_t, uint64_t> > ranges_t;
+
+      /***
+       * Parse a "bytes=" Range header into offset and length pairs.
+       * @return false if the header is invalid and should be ignored.
+       * Unsatisfiable ranges are dropped.
+       */
+      static bool parseRanges(const std::string &header, uint64_t size,
+                              ranges_t &ranges, unsigned maxRanges = 16);
 
       // From RequestHandler
       bool operator()(Request &req) override;
+
+    protected:
+      std::string getPath(const Request &req) const;
+      bool isNotModified(const Request &req,
+                         const FileCache::Entry &entry) const;
+      bool rangeApplies(const Request &req,
+                        const FileCache::Entry &entry) const;
+      void send(Request &req, const FileCache::Entry &entry,
+                uint64_t offset, uint64_t length);
+      void sendRanges(Request &req, const FileCache::Entry &entry,
+                      const ranges_t &ranges);
     };
   }
 }
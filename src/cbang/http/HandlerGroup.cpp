@@ -42,8 +42,13 @@ using namespace cb;
 using namespace std;
 
 
+void HandlerGroup::setRateLimiter(const SmartPointer<RateLimiter> &limiter) {
+  rateLimiter = limiter;
+}
+
+
 void HandlerGroup::addHandler(
-  const SmartPointer<RequestHandler> &handler) {handlers.push_back(handler);}
+  const SmartPointer<RequestHandler> &handler) {router.add(handler);}
 
 
 void HandlerGroup::addHandler(unsigned methods, const string &pattern,
@@ -78,11 +83,12 @@ SmartPointer<HandlerGroup> HandlerGroup::addGroup(
 }
 
 
-bool HandlerGroup::operator()(Request &req) {
-  for (unsigned i = 0; i < handlers.size(); i++)
-    if ((*handlers[i])(req)) return true;
+bool HandlerGroup::operator()(Request &req) {return router(req);}
+
 
-  return false;
+void HandlerGroup::admit(Request &req) {
+  if (rateLimiter.isSet()) rateLimiter->admit(req);
+  router.admit(req);
 }
 
 
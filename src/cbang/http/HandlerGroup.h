@@ -33,8 +33,8 @@
 #pragma once
 
 #include "RequestHandlerFactory.h"
-
-#include <vector>
+#include "Router.h"
+#include "RateLimiter.h"
 
 
 namespace cb {
@@ -42,8 +42,8 @@ namespace cb {
 
   namespace HTTP {
     class HandlerGroup : public RequestHandler {
-      typedef std::vector<SmartPointer<RequestHandler> > handlers_t;
-      handlers_t handlers;
+      Router router;
+      SmartPointer<RateLimiter> rateLimiter;
 
       std::string prefix;
       bool autoIndex = true;
@@ -53,7 +53,7 @@ namespace cb {
       HandlerGroup(const std::string &prefix) : prefix(prefix) {}
       virtual ~HandlerGroup() {}
 
-      bool isEmpty() const {return handlers.empty();}
+      bool isEmpty() const {return router.isEmpty();}
 
       const std::string &getPrefix() const {return prefix;}
       void setPrefix(const std::string &prefix) {this->prefix = prefix;}
@@ -61,6 +61,12 @@ namespace cb {
       bool getAutoIndex() const {return autoIndex;}
       void setAutoIndex(bool autoIndex) {this->autoIndex = autoIndex;}
 
+      /// Applied to requests which may be handled by this group before
+      /// their body is read
+      const SmartPointer<RateLimiter> &getRateLimiter() const
+      {return rateLimiter;}
+      void setRateLimiter(const SmartPointer<RateLimiter> &limiter);
+
       void addHandler(const SmartPointer<RequestHandler> &handler);
       void addHandler(unsigned methods, const std::string &pattern,
                       const SmartPointer<RequestHandler> &handler);
@@ -103,6 +109,7 @@ namespace cb {
 
       // From RequestHandler
       bool operator()(Request &req) override;
+      void admit(Request &req) override;
 
       // Factory callbacks
       virtual SmartPointer<RequestHandler>
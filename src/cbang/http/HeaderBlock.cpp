@@ -0,0 +1,249 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "HeaderBlock.h"
+#include "Headers.h"
+
+#include <cbang/Exception.h>
+#include <cbang/String.h>
+#include <cbang/event/Buffer.h>
+
+#include <cstring>
+#include <strings.h>
+
+#include <event2/buffer.h>
+
+using namespace cb::HTTP;
+using namespace cb;
+using namespace std;
+
+
+namespace {
+  bool isSpace(char c) {return c == ' ' || c == '\t';}
+}
+
+
+string HeaderBlock::getStartLine() const {
+  return block.substr(0, block.find('\r'));
+}
+
+
+void HeaderBlock::clear() {
+  block.clear();
+  fields.clear();
+  for (auto &s: start) s = Span();
+}
+
+
+void HeaderBlock::swap(HeaderBlock &o) {
+  block.swap(o.block);
+  fields.swap(o.fields);
+  for (unsigned i = 0; i < 3; i++) std::swap(start[i], o.start[i]);
+}
+
+
+bool HeaderBlock::read(Event::Buffer &buf, unsigned maxSize, bool withStart) {
+  clear();
+
+  // Scan the buffer's chains in place for the empty line ending the block
+  auto evb = buf.getBuffer();
+  evbuffer_iovec small[16];
+  vector<evbuffer_iovec> large;
+  evbuffer_iovec *space = small;
+
+  int n = evbuffer_peek(evb, -1, 0, 0, 0);
+  if (16 < n) {
+    large.resize(n);
+    space = large.data();
+  }
+  evbuffer_peek(evb, -1, 0, space, n);
+
+  unsigned length = 0;
+  unsigned offset = 0;
+  unsigned lineStart = 0;
+  char first = 0;
+
+  for (int i = 0; i < n && !length; i++) {
+    const char *data = (const char *)space[i].iov_base;
+    const char *end = data + space[i].iov_len;
+    const char *ptr = data;
+
+    if (lineStart == offset && ptr < end) first = *ptr;
+
+    while (ptr < end) {
+      const char *eol = (const char *)memchr(ptr, '\n', end - ptr);
+      if (!eol) break;
+
+      // An empty line, other than a start line, ends the block
+      unsigned pos = offset + (eol - data);
+      bool empty =
+        pos == lineStart || (pos == lineStart + 1 && first == '\r');
+
+      if (empty && (!withStart || lineStart)) {
+        length = pos + 1;
+        break;
+      }
+
+      lineStart = pos + 1;
+      ptr = eol + 1;
+      if (ptr < end) first = *ptr;
+    }
+
+    offset += space[i].iov_len;
+  }
+
+  if (maxSize && maxSize < (length ? length : buf.getLength()))
+    THROW("Header too large");
+  if (!length) return false;
+
+  // One copy into the block, which the fields point into
+  block.resize(length);
+  buf.remove(&block[0], length);
+  parse(withStart);
+
+  return true;
+}
+
+
+bool HeaderBlock::has(const string &name) const {
+  for (auto &f: fields)
+    if (matches(f.name, name)) return true;
+
+  return false;
+}
+
+
+string HeaderBlock::find(const string &name) const {
+  string value;
+  bool found = false;
+
+  for (auto &f: fields)
+    if (matches(f.name, name)) {
+      // See RFC 2616 Section 4.2 "Message Headers"
+      if (found && !value.empty()) value += ", ";
+      value.append(getData(f.value), f.value.length);
+      found = true;
+    }
+
+  return value;
+}
+
+
+void HeaderBlock::copy(Headers &headers) const {
+  for (auto &f: fields)
+    headers.add(getString(f.name), getString(f.value));
+}
+
+
+bool HeaderBlock::matches(const Span &s, const string &name) const {
+  return s.length == name.length() &&
+    !strncasecmp(getData(s), name.data(), s.length);
+}
+
+
+void HeaderBlock::parse(bool withStart) {
+  char *data = &block[0];
+  unsigned length = block.length();
+  unsigned pos = 0;
+
+  fields.reserve(16);
+
+  while (pos < length) {
+    unsigned next = (char *)memchr(data + pos, '\n', length - pos) - data + 1;
+    unsigned end = next - 1;
+    if (pos < end && data[end - 1] == '\r') end--;
+
+    if (withStart && !pos) {
+      parseStart(end);
+      pos = next;
+      continue;
+    }
+
+    if (pos == end) break; // Empty line
+
+    // Trim trailing white space
+    while (pos < end && isSpace(data[end - 1])) end--;
+
+    // Continuation line, fold it into the previous value
+    if (isSpace(data[pos])) {
+      if (fields.empty())
+        THROW("Invalid header line: "
+              << String::escapeC(block.substr(pos, end - pos)));
+
+      Span &value = fields.back().value;
+      if (!value.length) {
+        while (pos < end && isSpace(data[pos])) pos++;
+        value.offset = pos;
+      }
+
+      for (unsigned i = value.offset + value.length; i < pos; i++)
+        data[i] = ' ';
+      if (value.offset < end) value.length = end - value.offset;
+
+    } else {
+      char *colon = (char *)memchr(data + pos, ':', end - pos);
+      if (!colon)
+        THROW("Invalid header line: "
+              << String::escapeC(block.substr(pos, end - pos)));
+
+      Field f;
+      f.name.offset = pos;
+      f.name.length = colon - data - pos;
+
+      unsigned start = colon - data + 1;
+      while (start < end && isSpace(data[start])) start++;
+      f.value.offset = start;
+      f.value.length = end - start;
+
+      fields.push_back(f);
+    }
+
+    pos = next;
+  }
+}
+
+
+void HeaderBlock::parseStart(unsigned end) {
+  unsigned pos = 0;
+
+  for (unsigned i = 0; i < 2; i++) {
+    const char *sp = (const char *)memchr(block.data() + pos, ' ', end - pos);
+    unsigned partEnd = sp ? sp - block.data() : end;
+
+    start[i].offset = pos;
+    start[i].length = partEnd - pos;
+    pos = sp ? partEnd + 1 : end;
+  }
+
+  start[2].offset = pos;
+  start[2].length = end - pos;
+}
@@ -0,0 +1,98 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+namespace cb {
+  namespace Event {class Buffer;}
+
+  namespace HTTP {
+    class Headers;
+
+    /***
+     * An HTTP start line and header fields removed from a Buffer in one copy.
+     * Fields are kept as offsets into the block and are only turned into
+     * strings when looked up or copied to Headers.
+     */
+    class HeaderBlock {
+    public:
+      struct Span {
+        unsigned offset = 0;
+        unsigned length = 0;
+      };
+
+      struct Field {
+        Span name;
+        Span value;
+      };
+
+    protected:
+      std::string block;
+      Span start[3];
+      std::vector<Field> fields;
+
+    public:
+      bool empty() const {return block.empty();}
+      unsigned size() const {return fields.size();}
+      const Field &getField(unsigned i) const {return fields.at(i);}
+
+      const char *getData(const Span &s) const {return block.data() + s.offset;}
+      std::string getString(const Span &s) const
+      {return std::string(getData(s), s.length);}
+
+      /// Parts of the start line split on the first two spaces
+      const Span &getStart(unsigned i) const {return start[i];}
+      std::string getStartLine() const;
+
+      void clear();
+      void swap(HeaderBlock &o);
+
+      /// @return false if the empty line ending the block has not arrived
+      bool read(Event::Buffer &buf, unsigned maxSize = 0,
+                bool withStart = false);
+
+      bool has(const std::string &name) const;
+      /// Repeated fields are joined with ", "
+      std::string find(const std::string &name) const;
+      void copy(Headers &headers) const;
+
+    protected:
+      bool matches(const Span &s, const std::string &name) const;
+      void parse(bool withStart);
+      void parseStart(unsigned end);
+    };
+  }
+}
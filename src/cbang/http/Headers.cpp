@@ -32,100 +32,259 @@
 
 #include "Headers.h"
 #include "ContentTypes.h"
+#include "HeaderBlock.h"
 
-#include <cbang/Exception.h>
+#include <cbang/Errors.h>
 #include <cbang/String.h>
 #include <cbang/event/Buffer.h>
 
+#include <cstring>
+#include <strings.h>
+
 using namespace cb::HTTP;
+using namespace cb;
 using namespace std;
 
 
-string Headers::find(const string &key) const {return has(key) ? get(key) : "";}
-void Headers::remove(const string &key) {if (has(key)) erase(key);}
+namespace {
+  const char *names[] = {
+    "", "Accept", "Accept-Encoding", "Accept-Language", "Accept-Ranges",
+    "Authorization", "Cache-Control", "Connection", "Content-Encoding",
+    "Content-Length", "Content-Range", "Content-Type", "Cookie", "Date",
+    "ETag", "Expect", "Host", "If-Modified-Since", "If-None-Match",
+    "Last-Modified", "Location", "Origin", "Range", "Referer", "Server",
+    "Set-Cookie", "Transfer-Encoding", "Upgrade", "User-Agent", "Vary",
+    "X-Forwarded-For",
+  };
 
+  static_assert(sizeof(names) / sizeof(names[0]) == HEADER_COUNT,
+                "Header name table does not match HeaderID");
 
-bool Headers::keyContains(const string &key, const string &value) const{
-  string hdr = String::toLower(find(key));
-  vector<string> parts;
 
-  String::tokenize(hdr, parts, " ,");
+  struct Interned {
+    string name;
+    uint32_t hash;
+  };
 
-  for (unsigned i = 0; i < parts.size(); i++)
-    if (parts[i] == String::toLower(value)) return true;
 
-  return false;
+  vector<Interned> intern() {
+    vector<Interned> table;
+
+    for (unsigned i = 0; i < HEADER_COUNT; i++)
+      table.push_back(
+        Interned{names[i], Headers::hash(names[i], strlen(names[i]))});
+
+    return table;
+  }
+
+
+  const vector<Interned> &interned() {
+    static const vector<Interned> table = intern();
+    return table;
+  }
+
+
+  bool equals(const string &a, const char *b, unsigned length) {
+    return a.length() == length && !strncasecmp(a.data(), b, length);
+  }
 }
 
 
-string Headers::getContentType() const {return find("Content-Type");}
+uint32_t Headers::hash(const char *key, unsigned length) {
+  // FNV-1a of the lower case key
+  uint32_t h = 2166136261U;
 
+  for (unsigned i = 0; i < length; i++) {
+    unsigned char c = key[i];
+    if ('A' <= c && c <= 'Z') c += 'a' - 'A';
+    h = (h ^ c) * 16777619U;
+  }
 
-bool Headers::isJSONContentType() const {
-  return String::startsWith(getContentType(), "application/json");
+  return h;
 }
 
 
-void Headers::setContentType(const string &contentType) {
-  insert("Content-Type", contentType);
+const string &Headers::getName(HeaderID id) {
+  if (HEADER_COUNT <= id) THROW("Invalid header ID " << id);
+  return interned()[id].name;
 }
 
 
-void Headers::guessContentType(const string &ext) {
-  setContentType(ContentTypes::guess(ext, "text/html; charset=UTF-8"));
+HeaderID Headers::getID(const string &key) {
+  uint32_t h = hash(key);
+  auto &table = interned();
+
+  for (unsigned i = 1; i < HEADER_COUNT; i++)
+    if (table[i].hash == h && equals(table[i].name, key.data(), key.length()))
+      return (HeaderID)i;
+
+  return HEADER_UNKNOWN;
 }
 
 
-/// @return true if we should send a "Connection: close" when request done.
-bool Headers::needsClose() const {return keyContains("Connection", "close");}
-bool Headers::connectionKeepAlive() const {
-  return keyContains("Connection", "keep-alive");
+const string &Headers::keyAt(size_type i) const {
+  if (size() <= i) KEY_ERROR("Index " << i << " out of range");
+  return entries[i].first;
 }
 
 
-bool Headers::parse(Event::Buffer &buf, unsigned maxSize) {
-  unsigned bytes = 0;
-  string last;
+int Headers::lookup(const char *key, unsigned length) const {
+  uint32_t h = hash(key, length);
 
-  while (buf.getLength()) {
-    string line;
-    if (!buf.readLine(line, maxSize ? maxSize - bytes : 0)) return false;
+  for (unsigned i = 0; i < hashes.size(); i++)
+    if (hashes[i] == h && equals(entries[i].first, key, length)) return i;
 
-    // Last header
-    if (line.empty()) return true;
+  return -1;
+}
 
-    bytes += line.length() + 2;
-    if (maxSize && maxSize < bytes) THROW("Header too long");
 
-    // Continuation line
-    if (line[0] == ' ' || line[0] == '\t') {
-      if (empty()) THROW("Invalid header line: " << line);
-      get(last) += String::trim(line);
-      continue;
-    }
+int Headers::lookup(HeaderID id) const {
+  auto &name = getName(id);
+  uint32_t h = interned()[id].hash;
+
+  for (unsigned i = 0; i < hashes.size(); i++)
+    if (hashes[i] == h && equals(entries[i].first, name.data(), name.length()))
+      return i;
+
+  return -1;
+}
+
+
+const string &Headers::get(const string &key) const {
+  int i = lookup(key);
+  if (i < 0) KEY_ERROR("Key '" << key << "' not found");
+  return entries[i].second;
+}
+
+
+string &Headers::get(const string &key) {
+  int i = lookup(key);
+  if (i < 0) KEY_ERROR("Key '" << key << "' not found");
+  return entries[i].second;
+}
+
+
+string Headers::find(const string &key) const {
+  int i = lookup(key);
+  return i < 0 ? string() : entries[i].second;
+}
+
+
+string Headers::find(HeaderID id) const {
+  int i = lookup(id);
+  return i < 0 ? string() : entries[i].second;
+}
+
+
+Headers::size_type Headers::insert(const string &key, const string &value) {
+  int i = lookup(key);
+  if (0 <= i) {
+    entries[i] = value_type(key, value);
+    return i;
+  }
+
+  if (entries.empty()) {
+    entries.reserve(16);
+    hashes.reserve(16);
+  }
+
+  entries.push_back(value_type(key, value));
+  hashes.push_back(hash(key));
+
+  return size() - 1;
+}
 
-    // Parse
-    size_t semi = line.find_first_of(':');
-    if (semi == string::npos) THROW("Invalid header line: " << line);
 
-    string key = line.substr(0, semi);
-    string value = String::trim(line.substr(semi + 1));
+void Headers::add(const string &key, const string &value) {
+  int i = lookup(key);
+  if (i < 0) insert(key, value);
 
+  else {
     // See RFC 2616 Section 4.2 "Message Headers"
-    if (has(key)) {
-      auto &h = get(key);
-      if (!String::trim(h).empty()) h += ", ";
-      h += value;
+    string &h = entries[i].second;
+    if (!String::trim(h).empty()) h += ", ";
+    h += value;
+  }
+}
+
+
+void Headers::remove(const string &key) {
+  int i = lookup(key);
+  if (0 <= i) erase(i);
+}
+
+
+void Headers::remove(HeaderID id) {
+  int i = lookup(id);
+  if (0 <= i) erase(i);
+}
+
+
+bool Headers::keyContains(const string &key, const string &value) const{
+  return listContains(find(key), value);
+}
 
-    } else insert(key, value);
 
-    last = key;
+bool Headers::listContains(const string &list, const string &value) {
+  const char *ptr = list.data();
+  const char *end = ptr + list.length();
+
+  while (ptr < end) {
+    while (ptr < end && (*ptr == ' ' || *ptr == ',')) ptr++;
+
+    const char *token = ptr;
+    while (ptr < end && *ptr != ' ' && *ptr != ',') ptr++;
+
+    if (equals(value, token, ptr - token) && token < ptr) return true;
   }
 
   return false;
 }
 
 
+string Headers::getContentType() const {return find(HEADER_CONTENT_TYPE);}
+
+
+bool Headers::isJSONContentType() const {
+  return String::startsWith(getContentType(), "application/json");
+}
+
+
+void Headers::setContentType(const string &contentType) {
+  insert(HEADER_CONTENT_TYPE, contentType);
+}
+
+
+void Headers::guessContentType(const string &ext) {
+  setContentType(ContentTypes::guess(ext, "text/html; charset=UTF-8"));
+}
+
+
+/// @return true if we should send a "Connection: close" when request done.
+bool Headers::needsClose() const {
+  return listContains(find(HEADER_CONNECTION), "close");
+}
+
+
+bool Headers::connectionKeepAlive() const {
+  return listContains(find(HEADER_CONNECTION), "keep-alive");
+}
+
+
+bool Headers::parse(Event::Buffer &buf, unsigned maxSize) {
+  HeaderBlock block;
+  if (!block.read(buf, maxSize)) return false;
+  block.copy(*this);
+  return true;
+}
+
+
 void Headers::write(ostream &stream) const {
   for (auto &p: *this) stream << p.first << ": " << p.second << '\n';
 }
+
+
+void Headers::erase(size_type i) {
+  entries.erase(entries.begin() + i);
+  hashes.erase(hashes.begin() + i);
+}
@@ -32,30 +32,112 @@
 
 #pragma once
 
-#include <cbang/String.h>
-#include <cbang/util/OrderedDict.h>
-
+#include <string>
+#include <vector>
 #include <ostream>
+#include <cstdint>
 
 
 namespace cb {
   namespace Event {class Buffer;}
 
   namespace HTTP {
-    struct HeaderKeyCompare {
-      bool operator()(const std::string &a, const std::string &b) const {
-        return String::toLower(a) < String::toLower(b);
-      }
+    /// Well-known header names, in the same order as the table in Headers.cpp
+    enum HeaderID {
+      HEADER_UNKNOWN,
+      HEADER_ACCEPT,
+      HEADER_ACCEPT_ENCODING,
+      HEADER_ACCEPT_LANGUAGE,
+      HEADER_ACCEPT_RANGES,
+      HEADER_AUTHORIZATION,
+      HEADER_CACHE_CONTROL,
+      HEADER_CONNECTION,
+      HEADER_CONTENT_ENCODING,
+      HEADER_CONTENT_LENGTH,
+      HEADER_CONTENT_RANGE,
+      HEADER_CONTENT_TYPE,
+      HEADER_COOKIE,
+      HEADER_DATE,
+      HEADER_ETAG,
+      HEADER_EXPECT,
+      HEADER_HOST,
+      HEADER_IF_MODIFIED_SINCE,
+      HEADER_IF_NONE_MATCH,
+      HEADER_LAST_MODIFIED,
+      HEADER_LOCATION,
+      HEADER_ORIGIN,
+      HEADER_RANGE,
+      HEADER_REFERER,
+      HEADER_SERVER,
+      HEADER_SET_COOKIE,
+      HEADER_TRANSFER_ENCODING,
+      HEADER_UPGRADE,
+      HEADER_USER_AGENT,
+      HEADER_VARY,
+      HEADER_X_FORWARDED_FOR,
+      HEADER_COUNT,
     };
 
-    class Headers :
-      public OrderedDict<std::string, std::string, HeaderKeyCompare> {
+
+    /***
+     * Case-insensitive, insertion ordered HTTP headers.  Each key is stored
+     * once next to a hash of its lower case form so lookups compare integers
+     * and only fall back to a case-insensitive compare on a hash match.
+     */
+    class Headers {
+    public:
+      typedef std::pair<std::string, std::string> value_type;
+      typedef std::vector<value_type>::const_iterator iterator;
+      typedef iterator const_iterator;
+      typedef std::vector<value_type>::size_type size_type;
+
+    protected:
+      std::vector<value_type> entries;
+      std::vector<uint32_t> hashes;
+
     public:
+      static uint32_t hash(const char *key, unsigned length);
+      static uint32_t hash(const std::string &key)
+        {return hash(key.data(), key.length());}
+      static const std::string &getName(HeaderID id);
+      /// @return HEADER_UNKNOWN if @param key is not a well-known name
+      static HeaderID getID(const std::string &key);
+
+      bool empty() const {return entries.empty();}
+      size_type size() const {return entries.size();}
+      void clear() {entries.clear(); hashes.clear();}
+      iterator begin() const {return entries.begin();}
+      iterator end() const {return entries.end();}
+
+      const std::string &keyAt(size_type i) const;
+
+      /// @return the index of @param key or -1
+      int lookup(const char *key, unsigned length) const;
+      int lookup(const std::string &key) const
+        {return lookup(key.data(), key.length());}
+      int lookup(HeaderID id) const;
+
+      bool has(const std::string &key) const {return lookup(key) != -1;}
+      bool has(HeaderID id) const {return lookup(id) != -1;}
+      const std::string &get(const std::string &key) const;
+      std::string &get(const std::string &key);
       std::string find(const std::string &key) const;
+      std::string find(HeaderID id) const;
+
+      size_type insert(const std::string &key, const std::string &value);
+      size_type insert(HeaderID id, const std::string &value)
+        {return insert(getName(id), value);}
       void set(const std::string &key, const std::string &value)
         {insert(key, value);}
+      void set(HeaderID id, const std::string &value) {insert(id, value);}
+      /// Joins a repeated field to an existing value with ", "
+      void add(const std::string &key, const std::string &value);
       void remove(const std::string &key);
+      void remove(HeaderID id);
+
       bool keyContains(const std::string &key, const std::string &value) const;
+      static bool listContains(const std::string &list,
+                               const std::string &value);
 
       bool hasContentType() const {return !getContentType().empty();}
       std::string getContentType() const;
@@ -67,6 +149,9 @@ namespace cb {
 
       bool parse(Event::Buffer &buf, unsigned maxSize = 0);
       void write(std::ostream &stream) const;
+
+    protected:
+      void erase(size_type i);
     };
 
 
@@ -0,0 +1,106 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "LoadShedder.h"
+#include "Request.h"
+#include "Conn.h"
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+#include <cbang/event/Base.h>
+#include <cbang/event/Event.h>
+#include <cbang/time/Timer.h>
+#include <cbang/thread/SmartLock.h>
+#include <cbang/log/Logger.h>
+
+using namespace std;
+using namespace cb;
+using namespace cb::HTTP;
+
+
+LoadShedder::LoadShedder(double maxLag, unsigned maxQueued) :
+  maxLag(maxLag), maxQueued(maxQueued) {}
+
+
+LoadShedder::~LoadShedder() {
+  for (auto &p: monitors) p.second->event->del();
+}
+
+
+double LoadShedder::getLag(Event::Base &base) {
+  Monitor *monitor;
+
+  {
+    SmartLock lock(this);
+
+    auto &ptr = monitors[&base];
+    if (ptr.isNull()) {
+      ptr = new Monitor;
+      Monitor *m = ptr.get();
+      m->event = base.newEvent([this, m] () {measure(*m);});
+      m->last = Timer::now();
+      m->event->add(interval);
+    }
+
+    monitor = ptr.get();
+  }
+
+  return monitor->lag;
+}
+
+
+void LoadShedder::admit(Request &req, unsigned queued) {
+  string reason;
+
+  if (maxQueued && maxQueued < queued)
+    reason = String::printf("%u requests queued", queued);
+
+  else if (maxLag) {
+    double lag = getLag(req.getConnection()->getBase());
+    if (maxLag < lag)
+      reason = String::printf("event loop lag %.3fs", lag);
+  }
+
+  if (reason.empty()) return;
+
+  LOG_DEBUG(3, "Shedding load, " << reason);
+
+  req.outSet("Retry-After", String(retryAfter));
+  THROWX("Server overloaded", Status::HTTP_SERVICE_UNAVAILABLE);
+}
+
+
+void LoadShedder::measure(Monitor &monitor) {
+  double now = Timer::now();
+  monitor.lag = max(0.0, now - monitor.last - interval);
+  monitor.last = now;
+}
@@ -0,0 +1,95 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/SmartPointer.h>
+#include <cbang/thread/Mutex.h>
+
+#include <map>
+
+
+namespace cb {
+  namespace Event {
+    class Base;
+    class Event;
+  }
+
+  namespace HTTP {
+    class Request;
+
+    /***
+     * Rejects new requests with 503 Service Unavailable while the server is
+     * overloaded, that is while the event loop which read the request lags
+     * behind by more than the maximum or while more than the maximum number
+     * of requests are waiting for a response.  Each event loop's lag is
+     * measured with a timer from the first request it reads.
+     */
+    class LoadShedder : public Mutex {
+      double maxLag;
+      unsigned maxQueued;
+      unsigned retryAfter = 1;
+      double interval = 0.05;
+
+      // Only accessed from its own Base
+      struct Monitor {
+        SmartPointer<Event::Event> event;
+        double last = 0;
+        double lag = 0;
+      };
+
+      std::map<Event::Base *, SmartPointer<Monitor> > monitors;
+
+    public:
+      /// A zero @param maxLag in seconds or @param maxQueued disables it
+      LoadShedder(double maxLag, unsigned maxQueued);
+      ~LoadShedder();
+
+      double getMaxLag() const {return maxLag;}
+      unsigned getMaxQueued() const {return maxQueued;}
+
+      /// Seconds clients are asked to wait before retrying
+      unsigned getRetryAfter() const {return retryAfter;}
+      void setRetryAfter(unsigned x) {retryAfter = x;}
+
+      /// Must be called from @param base's thread
+      double getLag(Event::Base &base);
+
+      /// Throws HTTP_SERVICE_UNAVAILABLE with Retry-After set when
+      /// overloaded.  @param queued is the number of unanswered requests.
+      void admit(Request &req, unsigned queued);
+
+    protected:
+      void measure(Monitor &monitor);
+    };
+  }
+}
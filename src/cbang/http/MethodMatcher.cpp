@@ -51,3 +51,8 @@ bool MethodMatcher::match(Method method) const {
 bool MethodMatcher::operator()(Request &req) {
   return match(req.getMethod()) && (*child)(req);
 }
+
+
+void MethodMatcher::admit(Request &req) {
+  if (match(req.getMethod())) child->admit(req);
+}
@@ -47,12 +47,14 @@ namespace cb {
       MethodMatcher(unsigned methods,
                         const SmartPointer<RequestHandler> &child);
 
+      unsigned getMethods() const {return methods;}
       const SmartPointer<RequestHandler> &getChild() const {return child;}
 
       bool match(Method method) const;
 
       // From RequestHandler
       bool operator()(Request &req) override;
+      void admit(Request &req) override;
     };
   }
 }
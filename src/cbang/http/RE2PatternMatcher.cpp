@@ -65,6 +65,11 @@ RE2PatternMatcher::RE2PatternMatcher(
 }
 
 
+const string &RE2PatternMatcher::getPattern() const {
+  return pri->regex.pattern();
+}
+
+
 bool RE2PatternMatcher::match(const URI &uri, JSON::ValuePtr resultArgs) const {
   int n = pri->regex.NumberOfCapturingGroups();
   vector<RE2::Arg>   args(n);
@@ -107,3 +112,8 @@ bool RE2PatternMatcher::operator()(Request &req) {
   if (!match(req.getURI(), req.getArgs())) return false;
   return (*child)(req);
 }
+
+
+void RE2PatternMatcher::admit(Request &req) {
+  if (match(req.getURI(), 0)) child->admit(req);
+}
@@ -54,11 +54,13 @@ namespace cb {
 
       const SmartPointer<RequestHandler> &getChild() const {return child;}
       const std::set<std::string> &getArgs() const {return args;}
+      const std::string &getPattern() const;
 
       bool match(const URI &uri, JSON::ValuePtr args) const;
 
       // From RequestHandler
       bool operator()(Request &req) override;
+      void admit(Request &req) override;
     };
   }
 }
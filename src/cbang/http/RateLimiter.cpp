@@ -0,0 +1,129 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "RateLimiter.h"
+#include "Request.h"
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+#include <cbang/time/Timer.h>
+#include <cbang/thread/SmartLock.h>
+#include <cbang/log/Logger.h>
+
+#include <cmath>
+
+using namespace std;
+using namespace cb;
+using namespace cb::HTTP;
+
+
+RateLimiter::RateLimiter(double rate, unsigned burst, unsigned maxClients) :
+  rate(rate), burst(burst ? burst : max(1.0, ceil(rate))),
+  maxClients(maxClients) {
+  if (rate <= 0) THROW("Rate must be positive");
+  if (!maxClients) THROW("Max clients cannot be zero");
+}
+
+
+unsigned RateLimiter::getClientCount() const {
+  SmartLock lock(this);
+  return buckets.size();
+}
+
+
+void RateLimiter::setKey(const string &spec) {
+  size_t pos = spec.find(':');
+  string type = String::toLower(spec.substr(0, pos));
+  string name = pos == string::npos ? "" : spec.substr(pos + 1);
+
+  if (type == "address" ? !name.empty() :
+      (type != "header" && type != "cookie") || name.empty())
+    THROW("Invalid rate limit key '" << spec << "'");
+
+  keyType = type;
+  keyName = name;
+}
+
+
+string RateLimiter::getKey(const Request &req) const {
+  string key;
+
+  if (keyType == "header") key = req.inFind(keyName);
+  else if (keyType == "cookie") key = req.findCookie(keyName);
+  if (!key.empty()) return keyType + ':' + key;
+
+  return "address:" + req.getClientAddr().toString(false);
+}
+
+
+double RateLimiter::take(const string &key, double now) {
+  SmartLock lock(this);
+
+  auto it = buckets.find(key);
+
+  if (it == buckets.end()) {
+    lru.push_front(key);
+    it = buckets.insert(buckets_t::value_type(
+                          key, Bucket{burst, now, lru.begin()})).first;
+
+    while (maxClients < buckets.size()) {
+      buckets.erase(lru.back());
+      lru.pop_back();
+    }
+
+  } else lru.splice(lru.begin(), lru, it->second.lru);
+
+  Bucket &bucket = it->second;
+  if (bucket.last < now) {
+    bucket.tokens = min(burst, bucket.tokens + (now - bucket.last) * rate);
+    bucket.last = now;
+  }
+
+  if (1 <= bucket.tokens) {
+    bucket.tokens -= 1;
+    return 0;
+  }
+
+  return (1 - bucket.tokens) / rate;
+}
+
+
+void RateLimiter::admit(Request &req) {
+  string key = getKey(req);
+  double wait = take(key, Timer::now());
+  if (!wait) return;
+
+  LOG_DEBUG(3, "Rate limited " << key);
+
+  req.outSet("Retry-After", String((unsigned)ceil(wait)));
+  THROWX("Too many requests", Status::HTTP_TOO_MANY_REQUESTS);
+}
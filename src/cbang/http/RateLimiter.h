@@ -0,0 +1,94 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/thread/Mutex.h>
+
+#include <map>
+#include <list>
+#include <string>
+
+
+namespace cb {
+  namespace HTTP {
+    class Request;
+
+    /***
+     * Per-client token buckets.  Each client may make up to burst requests
+     * at once and then rate requests per second.  Clients are identified by
+     * their address, or by a request header or cookie such as an API key or
+     * session ID, falling back to the address when it is missing.  Only the
+     * most recently seen clients are tracked, a client whose bucket is
+     * evicted starts again with a full bucket.
+     */
+    class RateLimiter : public Mutex {
+      double rate;
+      double burst;
+      unsigned maxClients;
+
+      std::string keyType = "address";
+      std::string keyName;
+
+      struct Bucket {
+        double tokens;
+        double last;
+        std::list<std::string>::iterator lru;
+      };
+
+      typedef std::map<std::string, Bucket> buckets_t;
+      buckets_t buckets;
+      std::list<std::string> lru; // Most recently used at the front
+
+    public:
+      RateLimiter(double rate, unsigned burst = 0,
+                  unsigned maxClients = 10000);
+
+      double getRate() const {return rate;}
+      double getBurst() const {return burst;}
+      unsigned getMaxClients() const {return maxClients;}
+      unsigned getClientCount() const;
+
+      /// @param spec is "address", "header:<name>" or "cookie:<name>"
+      void setKey(const std::string &spec);
+      std::string getKey(const Request &req) const;
+
+      /// @return zero if a token was taken, otherwise seconds until one is
+      /// available
+      double take(const std::string &key, double now);
+
+      /// Throws HTTP_TOO_MANY_REQUESTS with Retry-After set when the
+      /// request's client is over its rate
+      void admit(Request &req);
+    };
+  }
+}
@@ -32,6 +32,8 @@
 
 #include "Request.h"
 #include "Conn.h"
+#include "ConnIn.h"
+#include "Server.h"
 #include "Cookie.h"
 
 #include <cbang/Exception.h>
@@ -40,12 +42,11 @@
 #include <cbang/event/BufferStream.h>
 #include <cbang/event/JSONBufferWriter.h>
 #include <cbang/openssl/SSL.h>
+#include <cbang/os/SystemUtilities.h>
 #include <cbang/log/Logger.h>
 #include <cbang/json/JSON.h>
 #include <cbang/time/Time.h>
 #include <cbang/util/Regex.h>
-#include <cbang/comp/CompressionFilter.h>
-#include <cbang/boost/IOStreams.h>
 
 using namespace cb::HTTP;
 using namespace cb;
@@ -98,6 +99,22 @@ uint64_t Request::getID() const {
 }
 
 
+const Headers &Request::getInputHeaders() const {
+  if (!inputBlock.empty()) {
+    inputBlock.copy(inputHeaders);
+    inputBlock.clear();
+  }
+
+  return inputHeaders;
+}
+
+
+Headers &Request::getInputHeaders() {
+  const Request *self = this;
+  return const_cast<Headers &>(self->getInputHeaders());
+}
+
+
 bool Request::isOk() const {
   return 200 <= responseCode && responseCode < 300 && !connError;
 }
@@ -150,6 +167,13 @@ bool Request::isIncoming() const {
 }
 
 
+void Request::resumeBody() {
+  if (!bodyPaused) return;
+  bodyPaused = false;
+  if (hasConnection()) connection->resumeBody();
+}
+
+
 bool Request::isSecure() const {
   return connection.isSet() && connection->getSSL().isSet();
 }
@@ -189,23 +213,40 @@ SockAddr Request::getClientAddr() const {
 }
 
 
-bool Request::inHas(const string &name) const {return inputHeaders.has(name);}
+bool Request::inHas(const string &name) const {
+  return inputBlock.empty() ? inputHeaders.has(name) : inputBlock.has(name);
+}
 
 
 string Request::inFind(const string &name) const {
-  return inputHeaders.find(name);
+  return inputBlock.empty() ? inputHeaders.find(name) : inputBlock.find(name);
 }
 
 
-string Request::inGet(const string &name) const {return inputHeaders.get(name);}
+string Request::inGet(const string &name) const {
+  return getInputHeaders().get(name);
+}
 
 
 void Request::inSet(const string &name, const string &value) {
-  inputHeaders.insert(name, value);
+  getInputHeaders().insert(name, value);
+}
+
+
+void Request::inRemove(const string &name) {getInputHeaders().remove(name);}
+
+
+bool Request::inContains(const string &name, const string &value) const {
+  return Headers::listContains(inFind(name), value);
+}
+
+
+void Request::setInputHeaders(HeaderBlock &block) {
+  inputHeaders.clear();
+  inputBlock.swap(block);
 }
 
 
-void Request::inRemove(const string &name) {inputHeaders.remove(name);}
 bool Request::outHas(const string &name) const {return outputHeaders.has(name);}
 
 
@@ -228,7 +269,7 @@ void Request::outRemove(const string &name) {outputHeaders.remove(name);}
 
 
 bool Request::isPersistent() const {
-  bool keepAlive = inputHeaders.connectionKeepAlive();
+  bool keepAlive = inContains("Connection", "keep-alive");
   return (Version(1, 1) <= version || keepAlive) && !needsClose();
 }
 
@@ -343,6 +384,32 @@ Compression Request::getRequestedCompression() const {
 }
 
 
+double Request::getAcceptedQuality(const string &coding) const {
+  vector<string> accept;
+  String::tokenize(inFind("Accept-Encoding"), accept, ",");
+
+  double otherQ = 0;
+
+  for (auto &item: accept) {
+    double q = 1;
+    string name = String::toLower(String::trim(item));
+
+    size_t pos = name.find(';');
+    if (pos != string::npos) {
+      string arg = String::trim(name.substr(pos + 1));
+      name = String::trim(name.substr(0, pos));
+
+      if (String::startsWith(arg, "q=")) q = String::parseDouble(arg.substr(2));
+    }
+
+    if (name == coding) return q;
+    if (name == "*") otherQ = q;
+  }
+
+  return otherQ;
+}
+
+
 bool Request::hasCookie(const string &name) const {
   if (!inHas("Cookie")) return false;
 
@@ -404,8 +471,8 @@ SmartPointer<JSON::Value> Request::getInputJSON() const {
 
 const SmartPointer<JSON::Value> &Request::getJSONMessage() {
   if (msg.isNull()) {
-    const Headers &hdrs = inputHeaders;
-    if (hdrs.hasContentType() && hdrs.isJSONContentType()) msg = getInputJSON();
+    if (String::startsWith(inFind("Content-Type"), "application/json"))
+      msg = getInputJSON();
   }
 
   return msg;
@@ -414,6 +481,7 @@ const SmartPointer<JSON::Value> &Request::getJSONMessage() {
 
 SmartPointer<JSON::Writer> Request::getJSONWriter() {
   outputBuffer.clear();
+  outputFile.clear();
 
   auto cb = [this] (Event::Buffer &buffer) {
     if (!buffer.getLength()) return;
@@ -432,25 +500,21 @@ SmartPointer<istream> Request::getInputStream() const {
 
 
 SmartPointer<ostream> Request::getOutputStream(Compression compression) {
-  // Auto select compression type based on Accept-Encoding
-  if (compression == COMPRESSION_AUTO) compression = getRequestedCompression();
-  outSetContentEncoding(compression);
-
-  SmartPointer<ostream> target = new Event::BufferStream<>(outputBuffer);
+  if (compression != COMPRESSION_NONE) compressOutput(compression);
+  flushOutputFile();
 
-  if (compression == Compression::COMPRESSION_NONE) return target;
+  return new Event::BufferStream<>(outputBuffer);
+}
 
-  struct FilteringOStreamWithRef : public io::filtering_ostream {
-    SmartPointer<ostream> ref;
-    virtual ~FilteringOStreamWithRef() {reset();}
-  };
 
-  SmartPointer<FilteringOStreamWithRef> out = new FilteringOStreamWithRef;
-  pushCompression(compression, *out);
-  out->ref = target;
-  out->push(*target);
+void Request::compressOutput(Compression compression) {
+  // Auto select compression type based on Accept-Encoding
+  if (compression == COMPRESSION_AUTO) {
+    compression = getRequestedCompression();
+    if (isIncoming()) outSet("Vary", "Accept-Encoding");
+  }
 
-  return out;
+  outputCompression = compression;
 }
 
 
@@ -473,6 +537,7 @@ void Request::sendError(Status code, const string &msg) {
   outSet("Connection", "close");
 
   outputBuffer.clear();
+  outputFile.clear();
   send(msg);
   reply(code);
 }
@@ -512,17 +577,38 @@ void Request::sendError(const exception &e) {
 }
 
 
-void Request::send(const Event::Buffer &buf) {outputBuffer.add(buf);}
+void Request::send(const Event::Buffer &buf) {
+  flushOutputFile();
+  outputBuffer.add(buf);
+}
 
 
 void Request::send(const char *data, unsigned length) {
+  flushOutputFile();
   outputBuffer.add(data, length);
 }
 
 
-void Request::send(const char *s) {outputBuffer.add(s);}
-void Request::send(const string &s) {outputBuffer.add(s);}
-void Request::sendFile(const string &path) {outputBuffer.addFile(path);}
+void Request::send(const char *s) {flushOutputFile(); outputBuffer.add(s);}
+void Request::send(const string &s) {flushOutputFile(); outputBuffer.add(s);}
+
+
+void Request::sendFile(const string &path, uint64_t offset, int64_t length) {
+  flushOutputFile();
+
+  uint64_t size = SystemUtilities::getFileSize(path);
+  if (size < offset) offset = size;
+  if (length < 0 || size < offset + length) length = size - offset;
+
+  outputFile       = path;
+  outputFileOffset = offset;
+  outputFileLength = length;
+}
+
+
+uint64_t Request::getOutputLength() const {
+  return outputBuffer.getLength() + (outputFile.empty() ? 0 : outputFileLength);
+}
 
 
 void Request::reply(Status::enum_t code) {
@@ -553,11 +639,24 @@ void Request::startChunked(Status code) {
   if (version < Version(1, 1))
     THROW("Cannot start chunked with HTTP version " << version);
   if (!mustHaveBody()) THROW("Cannot start chunked with " << method);
-  if (outputBuffer.getLength())
+  if (getOutputLength())
     THROW("Cannot start chunked data in output buffer");
 
   outSet("Transfer-Encoding", "chunked");
   chunked = true;
+
+  // The total size is not known so only the content type level applies
+  if (outputCompression != COMPRESSION_NONE && !outHas("Content-Encoding")) {
+    unsigned minSize;
+    int level = getCompressionLevel(minSize);
+
+    if (level) {
+      compressor = Event::BufferFilter::compressor(outputCompression, level);
+      outSetContentEncoding(outputCompression);
+    }
+  }
+
+  outputCompression = COMPRESSION_NONE;
   reply(code);
 }
 
@@ -565,6 +664,26 @@ void Request::startChunked(Status code) {
 void Request::sendChunk(const Event::Buffer &buf) {
   if (!chunked) THROW("Not chunked");
 
+  bool last = !buf.getLength();
+  if (compressor.isNull()) return writeChunk(buf);
+
+  // Flush each chunk so the client can decode it on arrival
+  Event::Buffer in(buf);
+  Event::Buffer out;
+  compressor->filter(in, out);
+
+  if (last) {
+    compressor->finish(out);
+    compressor = 0;
+
+  } else compressor->flush(out);
+
+  if (out.getLength()) writeChunk(out);
+  if (last) writeChunk(Event::Buffer());
+}
+
+
+void Request::writeChunk(const Event::Buffer &buf) {
   LOG_DEBUG(4, "Sending " << buf.getLength() << " byte chunk");
 
   // Check for final empty chunk.  Must be before add() below
@@ -610,7 +729,7 @@ void Request::onResponse(Event::ConnectionError error) {
   if (error) LOG_DEBUG(4, "< " << error);
   else {
     LOG_INFO(1, "< " << getResponseLine());
-    LOG_DEBUG(5, inputHeaders << '\n');
+    LOG_DEBUG(5, getInputHeaders() << '\n');
     LOG_DEBUG(6, inputBuffer.hexdump() << '\n');
   }
 
@@ -620,7 +739,7 @@ void Request::onResponse(Event::ConnectionError error) {
 
 void Request::onRequest() {
   LOG_INFO(1, "< " << getRequestLine());
-  LOG_DEBUG(5, inputHeaders << '\n');
+  LOG_DEBUG(5, getInputHeaders() << '\n');
   LOG_DEBUG(6, inputBuffer.hexdump() << '\n');
 }
 
@@ -637,7 +756,7 @@ bool Request::mayHaveBody() const {
 
 
 bool Request::needsClose() const {
-  return inputHeaders.needsClose() || outputHeaders.needsClose();
+  return inContains("Connection", "close") || outputHeaders.needsClose();
 }
 
 
@@ -663,6 +782,14 @@ void Request::parseResponseLine(const string &line) {
 
 
 void Request::write() {
+  if (replyCB) {
+    auto cb = replyCB;
+    replyCB = 0;
+    cb(*this);
+  }
+
+  if (outputCompression != COMPRESSION_NONE) compressBody();
+
   if (connection.isNull()) return onWriteComplete(false); // Ignore write
 
   Event::Buffer out;
@@ -672,7 +799,53 @@ void Request::write() {
   bytesWritten += out.getLength();
 
   auto cb = [this] (bool success) {onWriteComplete(success);};
-  connection->writeRequest(this, out, chunked || isWebsocket(), cb);
+  bool hasMore = chunked || isWebsocket();
+
+  if (connection->isIncoming() && !mustHaveBody()) outputFile.clear();
+  if (outputFile.empty())
+    return connection->writeRequest(this, out, hasMore, cb);
+
+  // Write the file separately so it does not pass through the buffer
+  bytesWritten += outputFileLength;
+  connection->writeRequest(this, out, true);
+  connection->writeFile(this, outputFile, outputFileOffset, outputFileLength,
+                        hasMore, cb);
+  outputFile.clear();
+}
+
+
+int Request::getCompressionLevel(unsigned &minSize) {
+  minSize = 0;
+  if (!isIncoming() || !hasConnection()) return -1;
+
+  if (!hasContentType()) guessContentType();
+
+  auto &server = connection.cast<ConnIn>()->getServer();
+  minSize = server.getCompressionMinSize();
+
+  return server.getCompressionLevel(getContentType());
+}
+
+
+void Request::compressBody() {
+  Compression compression = outputCompression;
+  outputCompression = COMPRESSION_NONE;
+
+  // Files are sent without passing through the buffer
+  if (!mustHaveBody() || !outputFile.empty() || outHas("Content-Encoding"))
+    return;
+
+  unsigned minSize;
+  int level = getCompressionLevel(minSize);
+  if (!level || outputBuffer.getLength() < minSize) return;
+
+  Event::Buffer body;
+  auto filter = Event::BufferFilter::compressor(compression, level);
+  filter->filter(outputBuffer, body);
+  filter->finish(body);
+  outputBuffer.add(body);
+
+  outSetContentEncoding(compression);
 }
 
 
@@ -684,23 +857,23 @@ void Request::writeResponse(Event::Buffer &buf) {
       outSet("Date", Time().toString("%a, %d %b %Y %H:%M:%S GMT"));
 
     // If the protocol is 1.0 and onnection was keep-alive add keep-alive
-    bool keepAlive = inputHeaders.connectionKeepAlive();
+    bool keepAlive = inContains("Connection", "keep-alive");
     if (!version.getMinor() && keepAlive) outSet("Connection", "keep-alive");
 
     if ((0 < version.getMinor() || keepAlive) && mustHaveBody() &&
         !outHas("Transfer-Encoding") && !outHas("Content-Length"))
-      outSet("Content-Length", String(outputBuffer.getLength()));
+      outSet("Content-Length", String(getOutputLength()));
   }
 
   // Don't reply with empty JSON
-  if (outputBuffer.isEmpty() && isJSONContentType())
+  if (!getOutputLength() && isJSONContentType())
     outputHeaders.remove("Content-Type");
 
   // Add Content-Type
   if (mustHaveBody() && !hasContentType()) guessContentType();
 
   // If request asked for close, send close
-  if (inputHeaders.needsClose()) outSet("Connection", "close");
+  if (inContains("Connection", "close")) outSet("Connection", "close");
 
   LOG_INFO(300 <= responseCode ? 1 : 4, "> " << getResponseLine());
   LOG_DEBUG(5, outputHeaders << '\n');
@@ -717,7 +890,7 @@ void Request::writeRequest(Event::Buffer &buf) {
 
   // Add missing content length if may have body
   if (mayHaveBody() && !outHas("Content-Length"))
-    outSet("Content-Length", String(outputBuffer.getLength()));
+    outSet("Content-Length", String(getOutputLength()));
 
   LOG_INFO(1, "> " << getRequestLine());
   LOG_DEBUG(5, outputHeaders << '\n');
@@ -738,3 +911,10 @@ void Request::writeHeaders(Event::Buffer &buf) {
 
   buf.add("\r\n");
 }
+
+
+void Request::flushOutputFile() {
+  if (outputFile.empty()) return;
+  outputBuffer.addFile(outputFile, outputFileOffset, outputFileLength);
+  outputFile.clear();
+}
@@ -34,9 +34,11 @@
 
 #include "Enum.h"
 #include "Headers.h"
+#include "HeaderBlock.h"
 #include "Session.h"
 
 #include <cbang/event/Buffer.h>
+#include <cbang/event/BufferFilter.h>
 #include <cbang/SmartPointer.h>
 #include <cbang/util/Version.h>
 #include <cbang/net/SockAddr.h>
@@ -48,6 +50,7 @@
 
 #include <string>
 #include <iostream>
+#include <functional>
 
 
 namespace cb {
@@ -58,12 +61,21 @@ namespace cb {
     class Conn;
 
     class Request : virtual public RefCounted, public Enum {
-      Headers inputHeaders;
+    public:
+      typedef std::function<void (Request &)> reply_cb_t;
+
+    private:
+      mutable HeaderBlock inputBlock;
+      mutable Headers inputHeaders;
       Headers outputHeaders;
 
       Event::Buffer inputBuffer;
       Event::Buffer outputBuffer;
 
+      std::string outputFile;
+      uint64_t outputFileOffset = 0;
+      uint64_t outputFileLength = 0;
+
       SmartPointer<Conn> connection;
       Method method;
       URI uri;
@@ -76,8 +88,10 @@ namespace cb {
       SmartPointer<Session> session;
       std::string user = "anonymous";
 
-      bool chunked  = false;
-      bool replying = false;
+      bool chunked    = false;
+      bool replying   = false;
+      bool bodyStream = false;
+      bool bodyPaused = false;
 
       uint64_t bytesRead    = 0;
       uint64_t bytesWritten = 0;
@@ -85,6 +99,11 @@ namespace cb {
       JSON::ValuePtr args;
       JSON::ValuePtr msg;
 
+      reply_cb_t replyCB;
+
+      Compression outputCompression = COMPRESSION_NONE;
+      SmartPointer<Event::BufferFilter> compressor;
+
     public:
       Request(const SmartPointer<Conn> &connection,
               Method method = Method(), const URI &uri = URI(),
@@ -100,9 +119,9 @@ namespace cb {
 
       uint64_t getID() const;
 
-      const Headers &getInputHeaders() const {return inputHeaders;}
+      const Headers &getInputHeaders() const;
       const Headers &getOutputHeaders() const {return outputHeaders;}
-      Headers &getInputHeaders() {return inputHeaders;}
+      Headers &getInputHeaders();
       Headers &getOutputHeaders() {return outputHeaders;}
 
       const Event::Buffer &getInputBuffer() const {return inputBuffer;}
@@ -146,10 +165,24 @@ namespace cb {
       void setUser(const std::string &user);
 
       virtual bool isWebsocket() const {return false;}
+      virtual bool isEventStream() const {return false;}
       bool isIncoming() const;
       bool isChunked() const {return chunked;}
       bool isReplying() const {return replying;}
 
+      /// Deliver the body to onBodyData() as it arrives instead of buffering
+      /// it.  Must be set before or in onHeaders().  The server's maximum
+      /// body size only applies to buffered bodies.
+      bool isBodyStream() const {return bodyStream;}
+      void setBodyStream(bool x) {bodyStream = x;}
+      /// Stop reading the body after the current onBodyData() call
+      bool isBodyPaused() const {return bodyPaused;}
+      void pauseBody() {bodyPaused = true;}
+      void resumeBody();
+
+      /// Called once, before the response headers are first written
+      void setReplyCallback(reply_cb_t cb) {replyCB = cb;}
+
       uint64_t getBytesRead() const {return bytesRead;}
       uint64_t getBytesWritten() const {return bytesWritten;}
 
@@ -168,6 +201,9 @@ namespace cb {
       std::string inGet(const std::string &name) const;
       void inSet(const std::string &name, const std::string &value);
       void inRemove(const std::string &name);
+      bool inContains(const std::string &name, const std::string &value) const;
+      /// Input headers are looked up in @param block until first modified
+      void setInputHeaders(HeaderBlock &block);
 
       bool outHas(const std::string &name) const;
       std::string outFind(const std::string &name) const;
@@ -187,6 +223,8 @@ namespace cb {
 
       void outSetContentEncoding(Compression compression);
       Compression getRequestedCompression() const;
+      /// @return the Accept-Encoding q-value of @param coding, or of "*"
+      double getAcceptedQuality(const std::string &coding) const;
 
       bool hasCookie(const std::string &name) const;
       std::string findCookie(const std::string &name) const;
@@ -210,6 +248,9 @@ namespace cb {
       SmartPointer<std::istream> getInputStream() const;
       SmartPointer<std::ostream>
       getOutputStream(Compression compression = COMPRESSION_NONE);
+      /// Compress the body, or each chunk, when it is written.  Server
+      /// responses obey the server's minimum size and content type levels.
+      void compressOutput(Compression compression = COMPRESSION_AUTO);
 
       virtual void sendJSONError(Status code, const std::string &message);
       virtual void sendError(Status code, const std::string &message);
@@ -222,7 +263,11 @@ namespace cb {
       virtual void send(const char *data, unsigned length);
       virtual void send(const char *s);
       virtual void send(const std::string &s);
-      virtual void sendFile(const std::string &path);
+      /// The file is written by the connection, with sendfile() if possible
+      virtual void sendFile(const std::string &path, uint64_t offset = 0,
+                            int64_t length = -1);
+      uint64_t getOutputLength() const;
+      bool hasOutputFile() const {return !outputFile.empty();}
 
       virtual void reply(Status::enum_t code = HTTP_OK);
       virtual void reply(const Event::Buffer &buf);
@@ -244,6 +289,10 @@ namespace cb {
       // Callbacks
       virtual void onHeaders() {}
       virtual bool onContinue() {return true;}
+      /// Called for each part of a streamed body, consumes @param data
+      virtual void onBodyData(Event::Buffer &data) {inputBuffer.add(data);}
+      /// Called when a streamed body is complete
+      virtual void onBodyEnd() {}
       virtual void onResponse(Event::ConnectionError error);
       virtual void onRequest();
       virtual void onWriteComplete(bool success) {}
@@ -260,9 +309,13 @@ namespace cb {
       virtual void write();
 
     protected:
+      int getCompressionLevel(unsigned &minSize);
+      void compressBody();
+      void writeChunk(const Event::Buffer &buf);
       virtual void writeResponse(Event::Buffer &buf);
       virtual void writeRequest(Event::Buffer &buf);
       void writeHeaders(Event::Buffer &buf);
+      void flushOutputFile();
     };
 
     typedef SmartPointer<Request> RequestPtr;
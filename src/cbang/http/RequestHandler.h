@@ -43,6 +43,10 @@ namespace cb {
     struct RequestHandler : public Enum {
       virtual ~RequestHandler() {}
       virtual bool operator()(Request &req) {return false;};
+
+      /// Called once the request headers are read, before any body.  Throw
+      /// to reject the request with the exception's HTTP status code.
+      virtual void admit(Request &req) {}
     };
 
 
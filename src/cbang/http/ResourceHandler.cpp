@@ -41,6 +41,21 @@ using namespace cb;
 using namespace cb::HTTP;
 
 
+namespace {
+  bool etagMatches(const string &header, const string &etag) {
+    vector<string> tags;
+    String::tokenize(header, tags, ", \t");
+
+    for (auto tag: tags) {
+      if (String::startsWith(tag, "W/")) tag = tag.substr(2);
+      if (tag == "*" || tag == etag) return true;
+    }
+
+    return false;
+  }
+}
+
+
 ResourceHandler::ResourceHandler(const string &path) :
   root(ResourceManager::instance().get(path)) {}
 
@@ -53,7 +68,45 @@ bool ResourceHandler::operator()(Request &req) {
 
   if (!res || res->isDirectory()) return false;
 
-  req.reply(HTTP_OK, res->getData(), res->getLength());
+  // Serve the variant compressed at build time the client prefers most
+  const Resource *body = res;
+  Compression compression = Compression::COMPRESSION_NONE;
+  double maxQ = req.getAcceptedQuality("identity");
+
+  for (auto &coding: {make_pair(Compression::COMPRESSION_GZIP, "gzip"),
+                      make_pair(Compression::COMPRESSION_LZ4,  "lz4")}) {
+    const Resource *encoded = res->getEncoded(coding.first);
+    if (!encoded) continue;
+
+    req.outSet("Vary", "Accept-Encoding");
+
+    // Ties go to an encoded body over identity, then to the first variant
+    double q = req.getAcceptedQuality(coding.second);
+    if (0 < q && (body == res ? maxQ <= q : maxQ < q)) {
+      body = encoded;
+      compression = coding.first;
+      maxQ = q;
+    }
+  }
+
+  const char *etag = body->getETag();
+  if (etag) {
+    req.outSet("ETag", etag);
+
+    Method method = req.getMethod();
+    if ((method == HTTP_GET || method == HTTP_HEAD) &&
+        req.inHas("If-None-Match") &&
+        etagMatches(req.inGet("If-None-Match"), etag)) {
+      req.reply(HTTP_NOT_MODIFIED);
+      return true;
+    }
+  }
+
+  const char *contentType = res->getContentType();
+  if (contentType && !req.hasContentType()) req.setContentType(contentType);
+  if (body != res) req.outSetContentEncoding(compression);
+
+  req.reply(HTTP_OK, body->getData(), body->getLength());
 
   return true;
 }
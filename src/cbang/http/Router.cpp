@@ -0,0 +1,272 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "Router.h"
+#include "RE2PatternMatcher.h"
+#include "MethodMatcher.h"
+#include "Request.h"
+
+#include <cbang/Exception.h>
+#include <cbang/thread/SmartLock.h>
+#include <cbang/log/Logger.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <re2/re2.h>
+#include <re2/set.h>
+
+using namespace std;
+using namespace cb;
+using namespace cb::HTTP;
+
+
+struct Router::Private {
+  RE2::Set set;
+  Private() : set(RE2::Options(), RE2::ANCHOR_BOTH) {}
+};
+
+
+namespace {
+  void split(const string &path, vector<string> &segs) {
+    size_t start = 0;
+
+    while (true) {
+      size_t end = path.find('/', start);
+      segs.push_back(path.substr(start, end - start));
+      if (end == string::npos) break;
+      start = end + 1;
+    }
+  }
+
+
+  bool isLiteral(char c) {
+    return isalnum(c) || (c && strchr("-_~%!@,;=&'", c));
+  }
+}
+
+
+Router::Router() : compiled(false) {}
+Router::~Router() {}
+
+
+void Router::add(const SmartPointer<RequestHandler> &handler) {
+  if (handler.isNull()) THROW("Handler cannot be NULL");
+
+  SmartLock lock(this);
+
+  Route route;
+  route.handler = handler;
+
+  // Unwrap an optional method filter and a pattern
+  RequestHandler *ptr = handler.get();
+  auto *methodMatcher = dynamic_cast<MethodMatcher *>(ptr);
+  if (methodMatcher) {
+    route.methods = methodMatcher->getMethods();
+    ptr = methodMatcher->getChild().get();
+  }
+
+  auto *patternMatcher = dynamic_cast<RE2PatternMatcher *>(ptr);
+  unsigned index = routes.size();
+
+  if (!patternMatcher) always.push_back(index);
+
+  else {
+    vector<string> segs;
+
+    if (parsePath(patternMatcher->getPattern(), segs, route.params)) {
+      route.type = Route::ROUTE_PATH;
+      route.child = patternMatcher->getChild();
+
+      Node *node = &root;
+      for (unsigned i = 0; i < segs.size(); i++) {
+        auto &next = route.params[i].empty() ?
+          node->children[segs[i]] : node->param;
+        if (next.isNull()) next = new Node;
+        node = next.get();
+      }
+
+      node->routes.push_back(index);
+
+    } else {
+      route.type = Route::ROUTE_REGEX;
+      route.pattern = patternMatcher->getPattern();
+      regexRoutes.push_back(index);
+      compiled = false;
+    }
+  }
+
+  routes.push_back(route);
+}
+
+
+bool Router::operator()(Request &req) {
+  vector<string> segs;
+  vector<unsigned> matches;
+  find(req, segs, matches);
+
+  for (unsigned i: matches)
+    if (dispatch(routes[i], req, segs)) return true;
+
+  return false;
+}
+
+
+void Router::admit(Request &req) {
+  vector<string> segs;
+  vector<unsigned> matches;
+  find(req, segs, matches);
+
+  for (unsigned i: matches) {
+    auto &route = routes[i];
+    if (route.type == Route::ROUTE_PATH) route.child->admit(req);
+    else route.handler->admit(req);
+  }
+}
+
+
+bool Router::parsePath(const string &pattern, vector<string> &segments,
+                       vector<string> &params) {
+  const char *paramStart = "(?P<";
+  const char *paramEnd = ">[^/]*)";
+
+  segments.clear();
+  params.clear();
+
+  string seg;
+  string param;
+
+  for (unsigned i = 0; i <= pattern.length(); i++) {
+    if (i == pattern.length() || pattern[i] == '/') {
+      segments.push_back(seg);
+      params.push_back(param);
+      seg.clear();
+      param.clear();
+
+    } else if (seg.empty() && param.empty() &&
+               !pattern.compare(i, strlen(paramStart), paramStart)) {
+      // A URLPatternMatcher argument which must fill the segment
+      size_t end = pattern.find(paramEnd, i);
+      if (end == string::npos) return false;
+
+      unsigned nameStart = i + strlen(paramStart);
+      param = pattern.substr(nameStart, end - nameStart);
+      i = end + strlen(paramEnd) - 1;
+
+      if (param.empty() ||
+          (i + 1 < pattern.length() && pattern[i + 1] != '/')) return false;
+
+      for (char c: param)
+        if (!isalnum(c) && c != '_') return false;
+
+    } else if (isLiteral(pattern[i]) && param.empty()) seg += pattern[i];
+    else return false;
+  }
+
+  return true;
+}
+
+
+void Router::compile() {
+  SmartLock lock(this);
+  if (compiled) return;
+
+  pri = new Private;
+
+  for (unsigned i: regexRoutes) {
+    string error;
+    if (pri->set.Add(routes[i].pattern, &error) < 0)
+      THROW("Failed to add RE2 to set: " << error);
+  }
+
+  if (!regexRoutes.empty() && !pri->set.Compile())
+    THROW("Failed to compile RE2 set");
+
+  compiled = true;
+}
+
+
+void Router::find(Request &req, vector<string> &segs,
+                  vector<unsigned> &matches) {
+  if (!compiled) compile();
+
+  const string &path = req.getURI().getPath();
+  split(path, segs);
+
+  match(root, segs, 0, req.getMethod(), matches);
+
+  if (!regexRoutes.empty()) {
+    vector<int> found;
+    pri->set.Match(path, &found);
+    for (int i: found) matches.push_back(regexRoutes[i]);
+  }
+
+  // Preserve registration order
+  matches.insert(matches.end(), always.begin(), always.end());
+  sort(matches.begin(), matches.end());
+}
+
+
+void Router::match(const Node &node, const vector<string> &segs,
+                   unsigned depth, unsigned method,
+                   vector<unsigned> &matches) const {
+  if (depth == segs.size()) {
+    for (unsigned i: node.routes)
+      if (routes[i].methods & method) matches.push_back(i);
+    return;
+  }
+
+  auto it = node.children.find(segs[depth]);
+  if (it != node.children.end())
+    match(*it->second, segs, depth + 1, method, matches);
+
+  if (node.param.isSet()) match(*node.param, segs, depth + 1, method, matches);
+}
+
+
+bool Router::dispatch(const Route &route, Request &req,
+                      const vector<string> &segs) const {
+  if (route.type != Route::ROUTE_PATH) return (*route.handler)(req);
+
+  LOG_DEBUG(5, req.getURI().getPath() << " matched route");
+
+  // Store args as RE2PatternMatcher would
+  auto &args = req.getArgs();
+  if (args.isSet())
+    for (unsigned i = 0; i < segs.size(); i++) {
+      auto &name = route.params[i];
+      if (!name.empty() && !segs[i].empty() && !args->has(name))
+        args->insert(name, segs[i]);
+    }
+
+  return (*route.child)(req);
+}
@@ -0,0 +1,108 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include "RequestHandler.h"
+
+#include <cbang/SmartPointer.h>
+#include <cbang/thread/Mutex.h>
+
+#include <map>
+#include <vector>
+#include <string>
+#include <atomic>
+
+
+namespace cb {
+  namespace HTTP {
+    /***
+     * Dispatches to a list of handlers in registration order without trying
+     * each one.  Pattern matchers whose RE2 pattern is a plain path, with
+     * literal and URLPatternMatcher style ":name" segments, are compiled into
+     * a tree of path segments and checked against the request method.  Other
+     * patterns are matched together with one RE2::Set.  Handlers without a
+     * pattern are always tried.  Candidates are called in the order they were
+     * added until one returns true.  admit() is passed to every candidate
+     * since which one will handle the request is not yet known.
+     */
+    class Router : public Mutex {
+      struct Private;
+      SmartPointer<Private> pri;
+
+      struct Route {
+        enum {ROUTE_ANY, ROUTE_PATH, ROUTE_REGEX} type = ROUTE_ANY;
+        SmartPointer<RequestHandler> handler;
+        SmartPointer<RequestHandler> child;
+        unsigned methods = ~0;
+        std::vector<std::string> params;
+        std::string pattern;
+      };
+
+      struct Node {
+        std::map<std::string, SmartPointer<Node> > children;
+        SmartPointer<Node> param;
+        std::vector<unsigned> routes;
+      };
+
+      std::vector<Route> routes;
+      std::vector<unsigned> always;
+      std::vector<unsigned> regexRoutes;
+      Node root;
+      std::atomic<bool> compiled;
+
+    public:
+      Router();
+      ~Router();
+
+      bool isEmpty() const {return routes.empty();}
+      void add(const SmartPointer<RequestHandler> &handler);
+
+      bool operator()(Request &req);
+      void admit(Request &req);
+
+      static bool parsePath(const std::string &pattern,
+                            std::vector<std::string> &segments,
+                            std::vector<std::string> &params);
+
+    protected:
+      void compile();
+      void find(Request &req, std::vector<std::string> &segs,
+                std::vector<unsigned> &matches);
+      void match(const Node &node, const std::vector<std::string> &segs,
+                 unsigned depth, unsigned method,
+                 std::vector<unsigned> &matches) const;
+      bool dispatch(const Route &route, Request &req,
+                    const std::vector<std::string> &segs) const;
+    };
+  }
+}
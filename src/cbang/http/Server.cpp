@@ -34,12 +34,16 @@
 #include "RequestErrorHandler.h"
 #include "ConnIn.h"
 #include "Request.h"
+#include "RateLimiter.h"
+#include "LoadShedder.h"
 
 #include <cbang/config.h>
 #include <cbang/Catch.h>
+#include <cbang/String.h>
 #include <cbang/log/Logger.h>
 #include <cbang/config/Options.h>
 #include <cbang/os/SystemUtilities.h>
+#include <cbang/openssl/SSL.h>
 #include <cbang/openssl/SSLContext.h>
 
 #include <cinttypes>
@@ -50,7 +54,37 @@ using namespace cb::HTTP;
 
 
 Server::Server(Event::Base &base, const SmartPointer<SSLContext> &sslCtx) :
-  Event::Server(base), sslCtx(sslCtx) {}
+  Event::Server(base), sslCtx(sslCtx), queuedRequests(0) {
+  // Already compressed formats
+  for (auto type: {"image/*", "video/*", "audio/*", "font/woff",
+                   "font/woff2", "application/zip", "application/gzip",
+                   "application/x-bzip2", "application/octet-stream"})
+    setCompressionLevel(type, 0);
+  setCompressionLevel("image/svg+xml", -1);
+}
+
+
+void Server::setCompressionLevel(const string &contentType, int level) {
+  compressionLevels[String::toLower(contentType)] = level;
+}
+
+
+int Server::getCompressionLevel(const string &contentType) const {
+  string type = String::toLower(String::trim(
+    contentType.substr(0, contentType.find(';'))));
+
+  auto it = compressionLevels.find(type);
+  if (it == compressionLevels.end())
+    it = compressionLevels.find(type.substr(0, type.find('/')) + "/*");
+  if (it == compressionLevels.end()) it = compressionLevels.find("*");
+
+  return it == compressionLevels.end() ? -1 : it->second;
+}
+
+
+void Server::setLoadShedder(const SmartPointer<LoadShedder> &shedder) {
+  loadShedder = shedder;
+}
 
 
 void Server::addListenPort(const SockAddr &addr) {
@@ -81,11 +115,48 @@ void Server::addOptions(Options &options) {
                     "Maximum size of an HTTP request body.");
   options.addTarget("http-max-headers-size", maxHeaderSize,
                     "Maximum size of the HTTP request headers.");
+  options.addTarget("http-pipeline-depth", maxPipelined,
+                    "Maximum number of requests read from a persistent "
+                    "connection ahead of their responses.  Responses are "
+                    "always sent in request order.");
+  options.addTarget("http-stream-buffer-size", streamBufferSize,
+                    "Maximum number of bytes of a streamed request body "
+                    "read before it is passed to the request.");
+  options.addTarget("http-compression-min-size", compressionMinSize,
+                    "Responses smaller than this are not compressed.");
+  opt = options.add("http-compression-levels", "A space separated list of "
+                    "<content type>=<level> pairs.  The content type may end "
+                    "in \"/*\" or be \"*\" to match all.  Level zero "
+                    "disables compression, a negative level selects the "
+                    "default.");
+  opt->setType(Option::TYPE_STRINGS);
+  options.add("http-rate-limit", "Requests per second allowed from each "
+              "client.  Zero disables rate limiting.")->setDefault(0);
+  options.add("http-rate-burst", "Requests a client may make at once before "
+              "it is limited to the rate.  Zero uses the rate.")
+    ->setDefault(0);
+  options.add("http-rate-limit-key", "Identifies clients by \"address\", "
+              "\"header:<name>\" or \"cookie:<name>\".  Clients without "
+              "the header or cookie are identified by address.")
+    ->setDefault("address");
+  options.add("http-rate-limit-clients", "Maximum number of clients "
+              "tracked.  The least recently seen are forgotten first.")
+    ->setDefault(10000);
+  options.add("http-max-loop-lag", "Reject new requests while the event loop "
+              "lags by more than this many seconds.  Zero disables.")
+    ->setDefault(0);
+  options.add("http-max-queued-requests", "Reject new requests while more "
+              "than this many are waiting for a response.  Zero disables.")
+    ->setDefault(0);
+  options.add("http-retry-after", "Seconds clients are asked to wait when a "
+              "request is rejected because the server is overloaded.")
+    ->setDefault(1);
 
   options.alias("connection-timeout", "http-timeout");
   options.alias("connection-backlog", "http-connection-backlog");
   options.alias("max-connections",    "http-max-connections");
   options.alias("max-ttl",            "http-max-ttl");
+  options.alias("server-threads",     "http-threads");
 
   options.popCategory();
 
@@ -102,6 +173,22 @@ void Server::addOptions(Options &options) {
                 "format.")->setDefault("certificate.pem");
     options.add("private-key-file", "The servers private key file in PEM "
                 "format.")->setDefault("private.pem");
+    options.add("https-ktls", "Use kernel TLS offload when available.")
+      ->setDefault(false);
+    options.add("https-record-size", "Maximum number of bytes gathered into "
+                "each TLS record.")->setDefault(16 * 1024);
+    options.add("https-dynamic-records", "Send small TLS records when a "
+                "connection starts or after it has been idle.")
+      ->setDefault(false);
+    options.add("https-session-cache-size", "Maximum number of TLS sessions "
+                "cached for resumption by session ID.")->setDefault(20480);
+    options.add("https-session-timeout", "Number of seconds a TLS session "
+                "may be resumed.")->setDefault(300);
+    options.add("https-session-tickets", "Allow TLS session resumption with "
+                "session tickets.")->setDefault(true);
+    options.add("https-ticket-key-rotation", "Number of seconds after which "
+                "the session ticket encryption key is replaced.  Zero uses a "
+                "fixed key.")->setDefault(3600);
     options.popCategory();
   }
 }
@@ -110,6 +197,36 @@ void Server::addOptions(Options &options) {
 void Server::init(Options &options) {
   Event::Server::init(options);
 
+  // Compression levels
+  if (options["http-compression-levels"].hasValue())
+    for (auto &pair: options["http-compression-levels"].toStrings()) {
+      size_t pos = pair.find('=');
+      if (pos == string::npos)
+        THROW("Invalid compression level '" << pair << "'");
+
+      setCompressionLevel(pair.substr(0, pos),
+                          String::parseS32(pair.substr(pos + 1)));
+    }
+
+  // Rate limiting
+  double rate = options["http-rate-limit"].toDouble();
+  if (rate) {
+    SmartPointer<RateLimiter> limiter =
+      new RateLimiter(rate, options["http-rate-burst"].toInteger(),
+                      options["http-rate-limit-clients"].toInteger());
+    limiter->setKey(options["http-rate-limit-key"].toString());
+    setRateLimiter(limiter);
+  }
+
+  // Load shedding
+  double maxLag = options["http-max-loop-lag"].toDouble();
+  unsigned maxQueued = options["http-max-queued-requests"].toInteger();
+  if (maxLag || maxQueued) {
+    SmartPointer<LoadShedder> shedder = new LoadShedder(maxLag, maxQueued);
+    shedder->setRetryAfter(options["http-retry-after"].toInteger());
+    setLoadShedder(shedder);
+  }
+
   // Configure ports
   Option::strings_t addresses = options["http-addresses"].toStrings();
   for (unsigned i = 0; i < addresses.size(); i++)
@@ -139,15 +256,28 @@ void Server::init(Options &options) {
         sslCtx->usePrivateKey(*SystemUtilities::open(priKeyFile));
       else LOG_WARNING("Private key file not found " << priKeyFile);
     }
+
+    sslCtx->setKTLS(options["https-ktls"].toBoolean());
+    sslCtx->setSessionCacheSize(
+      options["https-session-cache-size"].toInteger());
+    sslCtx->setSessionTimeout(options["https-session-timeout"].toInteger());
+    sslCtx->setSessionTickets(options["https-session-tickets"].toBoolean());
+    sslCtx->setTicketKeyRotation(
+      options["https-ticket-key-rotation"].toInteger());
+    sslCtx->setMaxRecordSize(options["https-record-size"].toInteger());
+    sslCtx->setDynamicRecords(options["https-dynamic-records"].toBoolean());
   }
 #endif // HAVE_OPENSSL
 }
 
 
-SmartPointer<Event::Connection> Server::createConnection() {
-  auto conn = SmartPtr(new ConnIn(*this));
+SmartPointer<Event::Connection>
+Server::createConnection(Event::Base &base) {
+  auto conn = SmartPtr(new ConnIn(*this, base));
   conn->setMaxHeaderSize(maxHeaderSize);
   conn->setMaxBodySize(maxBodySize);
+  conn->setMaxPipelined(maxPipelined);
+  conn->setStreamBufferSize(streamBufferSize);
   return conn;
 }
 
@@ -178,3 +308,9 @@ bool Server::operator()(Request &req) {
 
   return HandlerGroup::operator()(req);
 }
+
+
+void Server::admit(Request &req) {
+  if (loadShedder.isSet()) loadShedder->admit(req, queuedRequests);
+  HandlerGroup::admit(req);
+}
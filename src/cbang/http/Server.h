@@ -33,11 +33,15 @@
 #pragma once
 
 #include "HandlerGroup.h"
+#include "LoadShedder.h"
 
 #include <cbang/event/Server.h>
 #include <cbang/net/URI.h>
 #include <cbang/util/Version.h>
 
+#include <map>
+#include <atomic>
+
 
 namespace cb {
   class SSLContext;
@@ -54,6 +58,13 @@ namespace cb {
 
       unsigned maxBodySize   = std::numeric_limits<int>::max();
       unsigned maxHeaderSize = std::numeric_limits<int>::max();
+      unsigned maxPipelined  = 16;
+      unsigned streamBufferSize = 64 * 1024;
+      unsigned compressionMinSize = 1024;
+      std::map<std::string, int> compressionLevels;
+
+      SmartPointer<LoadShedder> loadShedder;
+      std::atomic<unsigned> queuedRequests;
 
     public:
       Server(Event::Base &base, const SmartPointer<SSLContext> &sslCtx = 0);
@@ -75,13 +86,37 @@ namespace cb {
       unsigned getMaxHeaderSize() const {return maxHeaderSize;}
       void setMaxHeaderSize(unsigned size) {maxHeaderSize = size;}
 
+      unsigned getMaxPipelined() const {return maxPipelined;}
+      void setMaxPipelined(unsigned x) {maxPipelined = x;}
+
+      unsigned getStreamBufferSize() const {return streamBufferSize;}
+      void setStreamBufferSize(unsigned x) {streamBufferSize = x;}
+
+      unsigned getCompressionMinSize() const {return compressionMinSize;}
+      void setCompressionMinSize(unsigned x) {compressionMinSize = x;}
+
+      /// @param contentType may be "type/subtype", "type/*" or "*".  A
+      /// negative @param level selects the default, zero disables.
+      void setCompressionLevel(const std::string &contentType, int level);
+      int getCompressionLevel(const std::string &contentType) const;
+
+      const SmartPointer<LoadShedder> &getLoadShedder() const
+      {return loadShedder;}
+      void setLoadShedder(const SmartPointer<LoadShedder> &shedder);
+
+      /// Requests read whose response has not been started
+      unsigned getQueuedRequests() const {return queuedRequests;}
+      void requestQueued() {queuedRequests++;}
+      void requestDequeued() {queuedRequests--;}
+
       void addListenPort(const SockAddr &addr);
       void addSecureListenPort(const SockAddr &addr);
 
       // From Event::Server
       void addOptions(Options &options) override;
       void init(Options &options) override;
-      SmartPointer<Event::Connection> createConnection() override;
+      SmartPointer<Event::Connection>
+      createConnection(Event::Base &base) override;
 
       virtual SmartPointer<Request>
       createRequest(const SmartPointer<Conn> &conn, Method method,
@@ -92,6 +127,7 @@ namespace cb {
 
       // From RequestHandler
       bool operator()(Request &req) override;
+      void admit(Request &req) override;
     };
   }
 }
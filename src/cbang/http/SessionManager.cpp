@@ -36,6 +36,7 @@
 #include <cbang/config/Options.h>
 #include <cbang/util/Random.h>
 #include <cbang/json/JSON.h>
+#include <cbang/thread/SmartLock.h>
 
 #ifdef HAVE_OPENSSL
 #include <cbang/openssl/Digest.h>
@@ -89,12 +90,14 @@ bool SessionManager::isExpired(const Session &session) const {
 
 
 bool SessionManager::hasSession(const string &sid) const {
+  SmartLock lock(this);
   auto it = sessions.find(sid);
   return it != sessions.end() && !isExpired(*it->second);
 }
 
 
 SmartPointer<Session> SessionManager::lookupSession(const string &sid) const {
+  SmartLock lock(this);
   auto it = sessions.find(sid);
   if (it == end() || isExpired(*it->second))
     THROW("Session ID '" << sid << "' does not exist");
@@ -116,12 +119,16 @@ SmartPointer<Session> SessionManager::openSession(const SockAddr &addr) {
 }
 
 
-void SessionManager::closeSession(const string &sid) {sessions.erase(sid);}
+void SessionManager::closeSession(const string &sid) {
+  SmartLock lock(this);
+  sessions.erase(sid);
+}
 
 
 void SessionManager::addSession(const SmartPointer<Session> &session) {
   if (isExpired(*session)) return;
 
+  SmartLock lock(this);
   auto result =
     sessions.insert(sessions_t::value_type(session->getID(), session));
 
@@ -132,6 +139,7 @@ void SessionManager::addSession(const SmartPointer<Session> &session) {
 
 
 void SessionManager::cleanup() {
+  SmartLock lock(this);
   lastCleanup = Time::now();
 
   // Remove expired Sessions
@@ -151,6 +159,7 @@ void SessionManager::read(const JSON::Value &value) {
 
 
 void SessionManager::write(JSON::Sink &sink) const {
+  SmartLock lock(this);
   sink.beginDict();
 
   for (auto &p: *this) {
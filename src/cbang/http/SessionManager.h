@@ -35,6 +35,7 @@
 #include "Session.h"
 
 #include <cbang/SmartPointer.h>
+#include <cbang/thread/Mutex.h>
 
 #include <string>
 #include <map>
@@ -44,7 +45,7 @@ namespace cb {
   class Options;
 
   namespace HTTP {
-    class SessionManager : public JSON::Serializable {
+    class SessionManager : public JSON::Serializable, public Mutex {
       typedef std::map<std::string, SmartPointer<Session> > sessions_t;
       sessions_t sessions;
 
@@ -450,9 +450,13 @@ void SockAddr::bind(socket_t socket) const {
 }
 
 
-socket_t SockAddr::accept(socket_t socket) {
+socket_t SockAddr::accept(socket_t socket, int flags) {
   socklen_t len = getCapacity();
+#ifdef __linux__
+  return ::accept4(socket, get(), &len, flags);
+#else
   return ::accept(socket, get(), &len);
+#endif
 }
 
 
@@ -122,7 +122,7 @@ namespace cb {
     bool adjacent(const SockAddr &o) const;
 
     void bind(socket_t socket) const;
-    socket_t accept(socket_t socket);
+    socket_t accept(socket_t socket, int flags = 0);
     void connect(socket_t socket) const;
 
   protected:
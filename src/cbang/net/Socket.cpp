@@ -57,6 +57,7 @@ typedef int socklen_t;  // Unix socket length
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -138,6 +139,57 @@ void Socket::setReuseAddr(bool reuse) {
 }
 
 
+void Socket::setReusePort(bool reuse) {
+  assertOpen();
+
+#ifdef SO_REUSEPORT
+  int opt = reuse;
+
+  SysError::clear();
+  if (setsockopt((socket_t)socket, SOL_SOCKET, SO_REUSEPORT, (char *)&opt,
+                 sizeof(opt)))
+    THROW("Failed to set reuse port: " << SysError());
+
+#else
+  if (reuse) THROW("SO_REUSEPORT not supported");
+#endif
+}
+
+
+void Socket::setDeferAccept(unsigned secs) {
+  assertOpen();
+
+#ifdef TCP_DEFER_ACCEPT
+  int opt = secs;
+
+  SysError::clear();
+  if (setsockopt((socket_t)socket, IPPROTO_TCP, TCP_DEFER_ACCEPT, (char *)&opt,
+                 sizeof(opt)))
+    THROW("Failed to set defer accept: " << SysError());
+
+#else
+  if (secs) LOG_WARNING("TCP_DEFER_ACCEPT not supported");
+#endif
+}
+
+
+void Socket::setFastOpen(unsigned queue) {
+  assertOpen();
+
+#ifdef TCP_FASTOPEN
+  int opt = queue;
+
+  SysError::clear();
+  if (setsockopt((socket_t)socket, IPPROTO_TCP, TCP_FASTOPEN, (char *)&opt,
+                 sizeof(opt)))
+    THROW("Failed to set TCP fast open: " << SysError());
+
+#else
+  if (queue) LOG_WARNING("TCP_FASTOPEN not supported");
+#endif
+}
+
+
 void Socket::setBlocking(bool blocking) {
   assertOpen();
 
@@ -182,6 +234,22 @@ void Socket::setKeepAlive(bool keepAlive) {
 }
 
 
+void Socket::setNoDelay(bool noDelay) {
+  assertOpen();
+
+#ifdef _WIN32
+  BOOL opt = noDelay;
+#else
+  int opt = noDelay;
+#endif
+
+  SysError::clear();
+  if (setsockopt((socket_t)socket, IPPROTO_TCP, TCP_NODELAY, (char *)&opt,
+                 sizeof(opt)))
+    THROW("Failed to set TCP no delay: " << SysError());
+}
+
+
 void Socket::setSendBuffer(int size) {
   assertOpen();
 
@@ -278,14 +346,24 @@ void Socket::listen(int backlog) {
 SmartPointer<Socket> Socket::accept(SockAddr &addr) {
   assertOpen();
 
+#ifdef __linux__
+  // Set flags atomically, saves two fcntl() calls per connection
+  int flags = SOCK_CLOEXEC | (blocking ? 0 : SOCK_NONBLOCK);
+  socket_t s = addr.accept(socket, flags);
+#else
   socket_t s = addr.accept(socket);
+#endif
 
   if (s != INVALID_SOCKET) {
     SmartPointer<Socket> aSock = create();
     aSock->socket = s;
 
     aSock->connected = true;
+#ifdef __linux__
+    aSock->blocking = blocking;
+#else
     aSock->setBlocking(blocking);
+#endif
 
     LOG_DEBUG(5, "accept() new connection");
 
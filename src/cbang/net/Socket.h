@@ -92,10 +92,14 @@ namespace cb {
     virtual bool canWrite(double timeout = 0) const;
 
     virtual void setReuseAddr(bool reuse);
+    virtual void setReusePort(bool reuse);
+    virtual void setDeferAccept(unsigned secs);
+    virtual void setFastOpen(unsigned queue);
     virtual void setBlocking(bool blocking);
     virtual bool getBlocking() const {return blocking;}
     virtual void setCloseOnExec(bool closeOnExec);
     virtual void setKeepAlive(bool keepAlive);
+    virtual void setNoDelay(bool noDelay);
     virtual void setSendBuffer(int size);
     virtual void setReceiveBuffer(int size);
     virtual void setReceiveLowWater(int size);
@@ -37,6 +37,7 @@
 
 #include <cbang/config.h>
 #include <cbang/log/Logger.h>
+#include <cbang/time/Time.h>
 
 #ifdef HAVE_VALGRIND
 #include <valgrind/memcheck.h>
@@ -85,6 +86,14 @@ namespace {
 
 bool     cb::SSL::initialized   = false;
 unsigned cb::SSL::maxHandshakes = 3;
+atomic<unsigned> cb::SSL::ktlsCount(0);
+
+
+namespace {
+  const unsigned smallRecordSize = 1400; // Fits in one TCP segment
+  const uint64_t streamThreshold = 1 << 20;
+  const uint64_t idleTimeout     = 1;
+}
 
 
 cb::SSL::SSL(_SSL *ssl) : ssl(ssl) {
@@ -99,10 +108,23 @@ cb::SSL::SSL(SSL_CTX *ctx, BIO *bio) {
   ssl = SSL_new(ctx);
   if (!ssl) THROW("Failed to create new SSL");
   if (bio) setBIO(bio);
+
+  SSL_set_app_data(ssl, (char *)this);
+  SSL_set_info_callback(ssl, ssl_info_callback);
 }
 
 
-cb::SSL::~SSL() {if (ssl) SSL_free(ssl);}
+cb::SSL::~SSL() {
+  if (ktlsSend || ktlsRecv) ktlsCount--;
+
+  // OpenSSL invalidates the session of a connection freed without a
+  // shutdown.  Keep it resumable unless the connection failed.
+  if (ssl && handshakeDone && lastErr != SSL_ERROR_SSL &&
+      lastErr != SSL_ERROR_SYSCALL)
+    SSL_set_shutdown(ssl, SSL_get_shutdown(ssl) | SSL_SENT_SHUTDOWN);
+
+  if (ssl) SSL_free(ssl);
+}
 
 
 void cb::SSL::setBIO(BIO *bio) {SSL_set_bio(ssl, bio, bio);}
@@ -188,6 +210,9 @@ void cb::SSL::setTLSExtHostname(const string &hostname) {
 }
 
 
+bool cb::SSL::isSessionReused() const {return SSL_session_reused(ssl);}
+
+
 void cb::SSL::setConnectState() {SSL_set_connect_state(ssl);}
 void cb::SSL::setAcceptState()  {SSL_set_accept_state(ssl);}
 
@@ -256,6 +281,18 @@ void cb::SSL::shutdown() {
 }
 
 
+unsigned cb::SSL::getWriteSize() const {
+  // OpenSSL requires retried writes to be at least as long
+  if (retrySize) return retrySize;
+
+  if (dynamicRecords && (streamBytes < streamThreshold ||
+                         lastWrite + idleTimeout < Time::now()))
+    return min(smallRecordSize, maxRecordSize);
+
+  return maxRecordSize;
+}
+
+
 unsigned cb::SSL::getPending() const {return SSL_pending(ssl);}
 
 
@@ -303,16 +340,33 @@ unsigned cb::SSL::write(const char *data, unsigned size) {
   int ret = SSL_write(ssl, data, size);
   if (ret <= 0) {
     lastErr = SSL_get_error(ssl, ret);
-    if (lastErr == SSL_ERROR_WANT_READ || lastErr == SSL_ERROR_WANT_WRITE)
+    if (lastErr == SSL_ERROR_WANT_READ || lastErr == SSL_ERROR_WANT_WRITE) {
+      retrySize = size;
       return 0;
+    }
     THROW("SSL write failed: " << getFullSSLErrorStr(lastErr));
   }
 
+  retrySize = 0;
+
+  if (dynamicRecords) {
+    uint64_t now = Time::now();
+    if (lastWrite + idleTimeout < now) streamBytes = 0;
+    streamBytes += ret;
+    lastWrite = now;
+  }
+
   LOG_DEBUG(5, CBANG_FUNC << "()=" << ret);
   return (unsigned)ret;
 }
 
 
+void cb::SSL::setMaxRecordSize(unsigned size) {
+  // TLS records carry at most 16 KiB of plaintext
+  maxRecordSize = max(1U, min(size, 16U * 1024));
+}
+
+
 void cb::SSL::init() {
   if (initialized) return;
 
@@ -407,7 +461,21 @@ void cb::SSL::loadProvider(const string &provider) {
 
 
 void cb::SSL::infoCallback(int where, int ret) {
-  if (where & SSL_CB_HANDSHAKE_START) handshakes++;
+  // Only servers limit renegotiation
+  if ((where & SSL_CB_HANDSHAKE_START) && SSL_is_server(ssl)) handshakes++;
+
+  // TLS 1.3 post-handshake messages also signal done
+  if ((where & SSL_CB_HANDSHAKE_DONE) && !handshakeDone) {
+    handshakeDone = true;
+
+    // However the handshake was driven, the record keys are now in place
+    checkKTLS();
+
+    if (stats.isSet()) {
+      stats->event("tls-handshake");
+      if (isSessionReused()) stats->event("tls-resumed");
+    }
+  }
 }
 
 
@@ -417,6 +485,21 @@ void cb::SSL::checkHandshakes() {
 }
 
 
+void cb::SSL::checkKTLS() {
+#if defined(BIO_get_ktls_send) && defined(BIO_get_ktls_recv)
+  if (ktlsSend || ktlsRecv) return;
+
+  ktlsSend = BIO_get_ktls_send(SSL_get_wbio(ssl));
+  ktlsRecv = BIO_get_ktls_recv(SSL_get_rbio(ssl));
+
+  if (ktlsSend || ktlsRecv) {
+    ktlsCount++;
+    LOG_DEBUG(5, "kTLS active send=" << ktlsSend << " recv=" << ktlsRecv);
+  }
+#endif
+}
+
+
 bool cb::SSL::checkWants() {
   switch (state) {
   case WANTS_ACCEPT:  accept();  break;
@@ -34,9 +34,11 @@
 
 #include <cbang/config.h>
 #include <cbang/SmartPointer.h>
+#include <cbang/util/RateSet.h>
 
 #include <string>
 #include <vector>
+#include <atomic>
 
 #ifdef HAVE_OPENSSL
 typedef struct ssl_st _SSL;
@@ -54,6 +56,7 @@ namespace cb {
 
     static bool initialized;
     static unsigned maxHandshakes;
+    static std::atomic<unsigned> ktlsCount;
 
     enum {
       PROCEED,
@@ -62,6 +65,18 @@ namespace cb {
     } state = PROCEED;
 
     int lastErr = 0;
+    bool ktlsSend = false;
+    bool ktlsRecv = false;
+
+    unsigned maxRecordSize = 16 * 1024;
+    bool dynamicRecords = false;
+    uint64_t streamBytes = 0;
+    uint64_t lastWrite = 0;
+    unsigned retrySize = 0;
+
+    std::string sessionKey;
+    bool handshakeDone = false;
+    SmartPointer<RateSet> stats;
 
   public:
     SSL(_SSL *ssl);
@@ -88,6 +103,14 @@ namespace cb {
     std::vector<SmartPointer<Certificate> > getVerifiedChain() const;
     void setTLSExtHostname(const std::string &hostname);
 
+    /// Key under which the SSLContext stores client sessions for resumption
+    const std::string &getSessionKey() const {return sessionKey;}
+    void setSessionKey(const std::string &key) {sessionKey = key;}
+    bool isSessionReused() const;
+
+    /// Records "tls-handshake" and "tls-resumed" events
+    void setStats(const SmartPointer<RateSet> &stats) {this->stats = stats;}
+
     void setConnectState();
     void setAcceptState();
 
@@ -95,6 +118,24 @@ namespace cb {
     void accept();
     void shutdown();
 
+    /// True if the kernel encrypts records after the handshake
+    bool isKTLSSend() const {return ktlsSend;}
+    bool isKTLSRecv() const {return ktlsRecv;}
+
+    unsigned getMaxRecordSize() const {return maxRecordSize;}
+    void setMaxRecordSize(unsigned size);
+
+    /**
+     * Write single segment records until a connection has streamed enough
+     * data, and again after it goes idle, so the peer can process the first
+     * bytes before a full record arrives.
+     */
+    bool getDynamicRecords() const {return dynamicRecords;}
+    void setDynamicRecords(bool x) {dynamicRecords = x;}
+
+    /// Number of bytes to gather for the next write
+    unsigned getWriteSize() const;
+
     unsigned getPending() const;
     int read(char *data, unsigned size);
     unsigned write(const char *data, unsigned size);
@@ -104,6 +145,9 @@ namespace cb {
     static unsigned getMaxHandshakes() {return maxHandshakes;}
     static void setMaxHandshakes(unsigned n) {maxHandshakes = n;}
 
+    /// Number of open connections with kTLS active
+    static unsigned getKTLSCount() {return ktlsCount;}
+
     static int passwordCallback(char *buf, int num, int rwflags, void *data);
 
     static void flushErrors();
@@ -126,6 +170,7 @@ namespace cb {
 
   protected:
     void checkHandshakes();
+    void checkKTLS();
     bool checkWants();
     void checkError(int ret);
   };
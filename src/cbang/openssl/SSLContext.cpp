@@ -39,11 +39,13 @@
 #include "CertificateChain.h"
 #include "CRL.h"
 
-#include <cbang/Exception.h>
+#include <cbang/Catch.h>
 #include <cbang/log/Logger.h>
 #include <cbang/os/SystemUtilities.h>
 #include <cbang/os/SysError.h>
 #include <cbang/io/InputSource.h>
+#include <cbang/thread/SmartLock.h>
+#include <cbang/time/Time.h>
 
 // This avoids a conflict with OCSP_RESPONSE in wincrypt.h
 #ifdef OCSP_RESPONSE
@@ -56,6 +58,19 @@
 #include <openssl/x509.h>
 #include <openssl/x509_vfy.h>
 #include <openssl/opensslv.h>
+#include <openssl/rand.h>
+#include <openssl/evp.h>
+
+#if 0x3000000fL <= OPENSSL_VERSION_NUMBER
+#include <openssl/core_names.h>
+typedef EVP_MAC_CTX ticket_mac_ctx_t;
+#else
+#include <openssl/hmac.h>
+typedef HMAC_CTX ticket_mac_ctx_t;
+#endif
+
+#include <cstring>
+#include <ctime>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -92,6 +107,41 @@ namespace {
 
       return preverify_ok;
     }
+
+
+    SSLContext *get_context(::SSL *ssl) {
+      return (SSLContext *)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    }
+
+
+    int new_session_callback(::SSL *ssl, SSL_SESSION *session) {
+      cb::SSL *_ssl = (cb::SSL *)SSL_get_app_data(ssl);
+      return _ssl && get_context(ssl)->storeSession(*_ssl, session);
+    }
+
+
+    int ticket_key_callback(::SSL *ssl, unsigned char *name,
+                            unsigned char *iv, EVP_CIPHER_CTX *cipherCtx,
+                            ticket_mac_ctx_t *macCtx, int encrypt) {
+      try {
+        int ret = get_context(ssl)->ticketKey(name, iv, cipherCtx, macCtx,
+                                              encrypt);
+
+        // TLS 1.3 only issues tickets after resumption when asked to renew
+        if (ret == 1 && !encrypt && SSL_version(ssl) == TLS1_3_VERSION)
+          ret = 2;
+
+        return ret;
+      } CATCH_ERROR;
+
+      return -1;
+    }
+  }
+
+
+  bool expired(SSL_SESSION *session) {
+    return (uint64_t)SSL_SESSION_get_time(session) +
+      SSL_SESSION_get_timeout(session) <= (uint64_t)time(0);
   }
 }
 
@@ -104,6 +154,8 @@ SSLContext::SSLContext() : ctx(0) {reset();}
 
 
 SSLContext::~SSLContext() {
+  freeClientSessions();
+
   if (ctx) {
     SSL_CTX_free(ctx);
     ctx = 0;
@@ -112,16 +164,23 @@ SSLContext::~SSLContext() {
 
 
 void SSLContext::reset() {
+  freeClientSessions();
   if (ctx) SSL_CTX_free(ctx);
 
   ctx = SSL_CTX_new(TLS_method());
   if (!ctx) THROW("Failed to create SSL context: " << cb::SSL::getErrorStr());
 
+  SSL_CTX_set_app_data(ctx, this);
   SSL_CTX_set_default_passwd_cb(ctx, cb::SSL::passwordCallback);
 
   // A session ID is required for session caching to work
   SSL_CTX_set_session_id_context(ctx, (unsigned char *)"cbang", 5);
 
+  // Cache server sessions internally and pass client sessions to the store
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_BOTH);
+  SSL_CTX_sess_set_new_cb(ctx, new_session_callback);
+  setTicketKeyRotation(ticketKeyRotation);
+
   setVerifyNone();
 }
 
@@ -136,7 +195,10 @@ X509_STORE *SSLContext::getStore() const {
 
 
 SmartPointer<cb::SSL> SSLContext::createSSL(BIO *bio) {
-  return new cb::SSL(ctx, bio);
+  SmartPointer<cb::SSL> ssl = new cb::SSL(ctx, bio);
+  ssl->setMaxRecordSize(maxRecordSize);
+  ssl->setDynamicRecords(dynamicRecords);
+  return ssl;
 }
 
 
@@ -147,6 +209,126 @@ void SSLContext::setCipherList(const string &list) {
 }
 
 
+void SSLContext::setKTLS(bool enable) {
+#ifdef SSL_OP_ENABLE_KTLS
+  if (enable) SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+  else SSL_CTX_clear_options(ctx, SSL_OP_ENABLE_KTLS);
+#else
+  if (enable) LOG_WARNING("kTLS is not supported by this version of OpenSSL");
+#endif
+}
+
+
+bool SSLContext::getKTLS() const {
+#ifdef SSL_OP_ENABLE_KTLS
+  return SSL_CTX_get_options(ctx) & SSL_OP_ENABLE_KTLS;
+#else
+  return false;
+#endif
+}
+
+
+void SSLContext::setSessionCacheSize(unsigned size) {
+  SSL_CTX_sess_set_cache_size(ctx, size);
+}
+
+
+unsigned SSLContext::getSessionCacheSize() const {
+  return SSL_CTX_sess_get_cache_size(ctx);
+}
+
+
+void SSLContext::setSessionTimeout(unsigned secs) {
+  SSL_CTX_set_timeout(ctx, secs);
+}
+
+
+unsigned SSLContext::getSessionTimeout() const {
+  return SSL_CTX_get_timeout(ctx);
+}
+
+
+void SSLContext::setSessionTickets(bool enable) {
+  if (enable) SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+  else SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+}
+
+
+bool SSLContext::getSessionTickets() const {
+  return !(SSL_CTX_get_options(ctx) & SSL_OP_NO_TICKET);
+}
+
+
+void SSLContext::setTicketKeyRotation(unsigned secs) {
+  ticketKeyRotation = secs;
+
+#if 0x3000000fL <= OPENSSL_VERSION_NUMBER
+  SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, secs ? ticket_key_callback : 0);
+#else
+  SSL_CTX_set_tlsext_ticket_key_cb(ctx, secs ? ticket_key_callback : 0);
+#endif
+}
+
+
+void SSLContext::rotateTicketKeys() {
+  SmartLock lock(&ticketLock);
+  addTicketKey();
+}
+
+
+void SSLContext::setMaxClientSessions(unsigned max) {
+  SmartLock lock(&sessionLock);
+  maxClientSessions = max;
+
+  while (maxClientSessions < clientSessions.size()) {
+    auto oldest = clientSessions.begin();
+
+    for (auto it = clientSessions.begin(); it != clientSessions.end(); it++)
+      if (it->second.stored < oldest->second.stored) oldest = it;
+
+    SSL_SESSION_free(oldest->second.session);
+    clientSessions.erase(oldest);
+  }
+}
+
+
+unsigned SSLContext::getClientSessionCount() {
+  SmartLock lock(&sessionLock);
+  return clientSessions.size();
+}
+
+
+void SSLContext::resumeSession(cb::SSL &ssl, const string &key) {
+  if (!maxClientSessions) return;
+
+  ssl.setSessionKey(key);
+
+  SmartLock lock(&sessionLock);
+  auto it = clientSessions.find(key);
+  if (it == clientSessions.end()) return;
+
+  SSL_SESSION *session = it->second.session;
+  bool reusable = SSL_SESSION_is_resumable(session) && !expired(session);
+
+  if (reusable && !SSL_set_session(ssl.getSSL(), session))
+    LOG_DEBUG(3, "Failed to set TLS session for " << key << ": "
+              << cb::SSL::getErrorStr());
+
+  // TLS 1.3 tickets should only be used once, the server sends new ones
+  if (!reusable ||
+      SSL_SESSION_get_protocol_version(session) == TLS1_3_VERSION) {
+    SSL_SESSION_free(session);
+    clientSessions.erase(it);
+  }
+}
+
+
+void SSLContext::clearClientSessions() {
+  SmartLock lock(&sessionLock);
+  freeClientSessions();
+}
+
+
 void SSLContext::setVerifyNone() {
   SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, verify_callback);
 }
@@ -469,6 +651,104 @@ void SSLContext::setCheckCRL(bool x) {
 long SSLContext::getOptions() const {return SSL_CTX_get_options(ctx);}
 void SSLContext::setOptions(long options) {SSL_CTX_set_options(ctx, options);}
 
+
+bool SSLContext::storeSession(cb::SSL &ssl, SSL_SESSION *session) {
+  const string &key = ssl.getSessionKey();
+  if (key.empty() || !SSL_SESSION_is_resumable(session)) return false;
+
+  SmartLock lock(&sessionLock);
+  if (!maxClientSessions) return false;
+
+  auto it = clientSessions.find(key);
+  if (it != clientSessions.end()) SSL_SESSION_free(it->second.session);
+
+  else if (maxClientSessions <= clientSessions.size()) {
+    auto oldest = clientSessions.begin();
+
+    for (it = clientSessions.begin(); it != clientSessions.end(); it++)
+      if (it->second.stored < oldest->second.stored) oldest = it;
+
+    SSL_SESSION_free(oldest->second.session);
+    clientSessions.erase(oldest);
+  }
+
+  clientSessions[key] = ClientSession{session, Time::now()};
+  LOG_DEBUG(5, "Stored TLS session for " << key);
+
+  return true; // Keep the reference
+}
+
+
+int SSLContext::ticketKey(uint8_t *name, uint8_t *iv, void *cipherCtx,
+                          void *macCtx, bool encrypt) {
+  SmartLock lock(&ticketLock);
+
+  uint64_t now = Time::now();
+  if (ticketKeys.empty() ||
+      ticketKeys.front().created + ticketKeyRotation <= now) addTicketKey();
+
+  const TicketKey *key = 0;
+  const EVP_CIPHER *cipher = EVP_aes_256_cbc();
+
+  if (encrypt) {
+    key = &ticketKeys.front();
+    memcpy(name, key->name, sizeof(key->name));
+    if (RAND_bytes(iv, EVP_CIPHER_iv_length(cipher)) != 1) return -1;
+
+  } else {
+    for (auto &k: ticketKeys)
+      if (!memcmp(name, k.name, sizeof(k.name)) &&
+          now < k.created + 2 * ticketKeyRotation) key = &k;
+
+    if (!key) return 0; // Unknown or expired key, do a full handshake
+  }
+
+  if (!EVP_CipherInit_ex((EVP_CIPHER_CTX *)cipherCtx, cipher, 0, key->aesKey,
+                         iv, encrypt)) return -1;
+
+#if 0x3000000fL <= OPENSSL_VERSION_NUMBER
+  OSSL_PARAM params[] = {
+    OSSL_PARAM_construct_octet_string(
+      OSSL_MAC_PARAM_KEY, (void *)key->hmacKey, sizeof(key->hmacKey)),
+    OSSL_PARAM_construct_utf8_string(
+      OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0),
+    OSSL_PARAM_construct_end()
+  };
+
+  if (!EVP_MAC_CTX_set_params((EVP_MAC_CTX *)macCtx, params)) return -1;
+#else
+  if (!HMAC_Init_ex((HMAC_CTX *)macCtx, key->hmacKey, sizeof(key->hmacKey),
+                    EVP_sha256(), 0)) return -1;
+#endif
+
+  // Ask for a new ticket if an older key was used
+  return key == &ticketKeys.front() ? 1 : 2;
+}
+
+
+void SSLContext::freeClientSessions() {
+  for (auto &p: clientSessions) SSL_SESSION_free(p.second.session);
+  clientSessions.clear();
+}
+
+
+void SSLContext::addTicketKey() {
+  TicketKey key;
+
+  if (RAND_bytes(key.name, sizeof(key.name)) != 1 ||
+      RAND_bytes(key.aesKey, sizeof(key.aesKey)) != 1 ||
+      RAND_bytes(key.hmacKey, sizeof(key.hmacKey)) != 1)
+    THROW("Failed to generate TLS ticket key: " << cb::SSL::getErrorStr());
+
+  key.created = Time::now();
+
+  // Keep the previous key to decrypt tickets issued before rotation
+  ticketKeys.insert(ticketKeys.begin(), key);
+  if (2 < ticketKeys.size()) ticketKeys.resize(2);
+
+  LOG_DEBUG(4, "Rotated TLS session ticket key");
+}
+
 #ifdef __APPLE__
 } // namespace cb
 #endif
@@ -34,14 +34,19 @@
 
 #include <cbang/config.h>
 #include <cbang/SmartPointer.h>
+#include <cbang/thread/Mutex.h>
 
 #include <istream>
 #include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
 
 #ifdef HAVE_OPENSSL
 typedef struct ssl_ctx_st SSL_CTX;
 typedef struct x509_store_st X509_STORE;
 typedef struct bio_st BIO;
+typedef struct ssl_session_st SSL_SESSION;
 
 namespace cb {
   class SSL;
@@ -53,6 +58,29 @@ namespace cb {
   class SSLContext {
     SSL_CTX *ctx;
 
+    struct TicketKey {
+      uint8_t name[16];
+      uint8_t aesKey[32];
+      uint8_t hmacKey[32];
+      uint64_t created;
+    };
+
+    Mutex ticketLock;
+    std::vector<TicketKey> ticketKeys; // Newest first
+    unsigned ticketKeyRotation = 0;
+
+    struct ClientSession {
+      SSL_SESSION *session;
+      uint64_t stored;
+    };
+
+    Mutex sessionLock;
+    std::map<std::string, ClientSession> clientSessions;
+    unsigned maxClientSessions = 1024;
+
+    unsigned maxRecordSize = 16 * 1024;
+    bool dynamicRecords = false;
+
   public:
     SSLContext();
     ~SSLContext();
@@ -66,6 +94,43 @@ namespace cb {
 
     void setCipherList(const std::string &list);
 
+    /// Request kernel TLS offload for new connections
+    void setKTLS(bool enable = true);
+    bool getKTLS() const;
+
+    /// Record settings applied to each SSL created, see cb::SSL
+    void setMaxRecordSize(unsigned size) {maxRecordSize = size;}
+    unsigned getMaxRecordSize() const {return maxRecordSize;}
+    void setDynamicRecords(bool x) {dynamicRecords = x;}
+    bool getDynamicRecords() const {return dynamicRecords;}
+
+    /// Server side session ID cache
+    void setSessionCacheSize(unsigned size);
+    unsigned getSessionCacheSize() const;
+    void setSessionTimeout(unsigned secs);
+    unsigned getSessionTimeout() const;
+
+    void setSessionTickets(bool enable);
+    bool getSessionTickets() const;
+
+    /***
+     * Encrypt session tickets with random keys which are replaced every
+     * @param secs seconds.  Tickets issued under the previous key are still
+     * accepted and renewed.  Zero uses OpenSSL's fixed internal keys.
+     */
+    void setTicketKeyRotation(unsigned secs);
+    unsigned getTicketKeyRotation() const {return ticketKeyRotation;}
+    void rotateTicketKeys();
+
+    /// Client sessions kept for resumption, zero disables the store
+    void setMaxClientSessions(unsigned max);
+    unsigned getMaxClientSessions() const {return maxClientSessions;}
+    unsigned getClientSessionCount();
+
+    /// Offer the session stored under @param key and store new ones there
+    void resumeSession(cb::SSL &ssl, const std::string &key);
+    void clearClientSessions();
+
     void setVerifyNone();
     void setVerifyPeer(bool verifyClientOnce = true,
                        bool failIfNoPeerCert = false, unsigned depth = 1);
@@ -99,6 +164,15 @@ namespace cb {
 
     long getOptions() const;
     void setOptions(long options);
+
+    // Callbacks
+    bool storeSession(cb::SSL &ssl, SSL_SESSION *session);
+    int ticketKey(uint8_t *name, uint8_t *iv, void *cipherCtx, void *macCtx,
+                  bool encrypt);
+
+  protected:
+    void freeClientSessions();
+    void addTicketKey();
   };
 }
 
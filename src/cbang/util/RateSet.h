@@ -37,13 +37,16 @@
 #include <cbang/Exception.h>
 #include <cbang/json/Serializable.h>
 #include <cbang/json/Sink.h>
+#include <cbang/thread/Mutex.h>
+#include <cbang/thread/SmartLock.h>
 
 #include <string>
 #include <map>
 
 
 namespace cb {
-  class RateSet : public JSON::Serializable {
+  /// Thread safe except for iteration and references returned by getRate()
+  class RateSet : public JSON::Serializable, public Mutex {
     const unsigned size;
     const unsigned period;
 
@@ -56,33 +59,41 @@ namespace cb {
 
 
     Rate &getRate(const std::string &key) {
+      SmartLock lock(this);
       return rates.insert(rates_t::value_type(key, Rate(size, period)))
         .first->second;
     }
 
 
     const Rate &getRate(const std::string &key) const {
+      SmartLock lock(this);
       auto it = rates.find(key);
       if (it == rates.end()) CBANG_THROW("Rate '" << key << "' not in set");
       return it->second;
     }
 
 
-    void reset() {for (auto &p: rates)p.second.reset();}
+    void reset() {
+      SmartLock lock(this);
+      for (auto &p: rates) p.second.reset();
+    }
 
 
     bool has(const std::string &key) const {
+      SmartLock lock(this);
       return rates.find(key) != rates.end();
     }
 
 
     double get(const std::string &key, uint64_t now = Time::now()) const {
+      SmartLock lock(this);
       return getRate(key).get(now);
     }
 
 
     void event(const std::string &key, double value = 1,
                uint64_t now = Time::now()) {
+      SmartLock lock(this);
       getRate(key).event(value, now);
     }
 
@@ -93,6 +104,7 @@ namespace cb {
 
 
     void insert(JSON::Sink &sink, bool withTotals = false) const {
+      SmartLock lock(this);
       for (auto &p: *this)
         if (!withTotals) sink.insert(p.first, p.second.get());
         else {
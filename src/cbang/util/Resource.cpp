@@ -45,6 +45,15 @@ const Resource &Resource::get(const string &path) const {
 }
 
 
+const Resource *FileResource::getEncoded(Compression compression) const {
+  switch (compression) {
+  case Compression::COMPRESSION_GZIP: return gzip;
+  case Compression::COMPRESSION_LZ4:  return lz4;
+  default: return 0;
+  }
+}
+
+
 const Resource *DirectoryResource::find(const string &path) const {
   if (path.empty()) return 0;
   if (path[0] == '/') return find(path.substr(1));
@@ -33,6 +33,7 @@
 #pragma once
 
 #include <cbang/Exception.h>
+#include <cbang/comp/Compression.h>
 
 #include <string>
 #include <ostream>
@@ -62,6 +63,10 @@ namespace cb {
     {CBANG_THROW(CBANG_FUNC << "() not supported by resource");}
     virtual std::string toString() const
     {CBANG_THROW(CBANG_FUNC << "() not supported by resource");}
+    virtual const char *getETag() const {return 0;}
+    virtual const char *getContentType() const {return 0;}
+    virtual const Resource *getEncoded(Compression compression) const
+    {return 0;}
 
     const Resource &get(const std::string &path) const;
   };
@@ -71,14 +76,24 @@ namespace cb {
   public:
     const char *data;
     const unsigned length;
+    const char *etag;
+    const char *contentType;
+    const Resource *gzip;
+    const Resource *lz4;
 
-    FileResource(const char *name, const char *data, unsigned length) :
-      Resource(name), data(data), length(length) {}
+    FileResource(const char *name, const char *data, unsigned length,
+                 const char *etag = 0, const char *contentType = 0,
+                 const Resource *gzip = 0, const Resource *lz4 = 0) :
+      Resource(name), data(data), length(length), etag(etag),
+      contentType(contentType), gzip(gzip), lz4(lz4) {}
 
     // From Resource
     const char *getData() const override {return data;}
     unsigned getLength() const override {return length;}
     std::string toString() const override {return std::string(data, length);}
+    const char *getETag() const override {return etag;}
+    const char *getContentType() const override {return contentType;}
+    const Resource *getEncoded(Compression compression) const override;
   };
 
 
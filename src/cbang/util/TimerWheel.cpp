@@ -0,0 +1,146 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "TimerWheel.h"
+
+#include <cstring>
+
+using namespace cb;
+
+
+void TimerWheel::Entry::cancel() {
+  if (!wheel) return;
+
+  unlink();
+  wheel->count--;
+  wheel = 0;
+}
+
+
+void TimerWheel::Entry::unlink() {
+  *prev = next;
+  if (next) next->prev = prev;
+  next = 0;
+  prev = 0;
+}
+
+
+TimerWheel::TimerWheel(uint64_t now) : current(now) {
+  memset(slots, 0, sizeof(slots));
+}
+
+
+TimerWheel::~TimerWheel() {
+  for (unsigned level = 0; level < numLevels; level++)
+    for (unsigned slot = 0; slot < numSlots; slot++)
+      while (slots[level][slot]) slots[level][slot]->cancel();
+}
+
+
+void TimerWheel::schedule(Entry &e, uint64_t time) {
+  if (e.wheel && e.wheel != this) e.cancel();
+  if (e.wheel) e.unlink();
+  else count++;
+
+  e.wheel = this;
+  e.time = time;
+  place(e, current + 1);
+}
+
+
+void TimerWheel::advance(uint64_t now) {
+  while (current < now) {
+    // Nothing can expire, skip ahead
+    if (!count) {
+      current = now;
+      break;
+    }
+
+    current++;
+
+    // Move entries down from higher levels when their turn comes
+    for (unsigned level = 1; level < numLevels; level++) {
+      if (current & ((1ULL << (level * levelBits)) - 1)) break;
+      cascade(level);
+    }
+
+    Entry *&head = slots[0][current & slotMask];
+
+    while (head) {
+      Entry &e = *head;
+
+      // Clamped far future entry
+      if (current <= e.time) {
+        e.unlink();
+        place(e, current + 1);
+
+      } else {
+        e.cancel();
+        e.expired(current);
+      }
+    }
+  }
+}
+
+
+void TimerWheel::place(Entry &e, uint64_t earliest) {
+  uint64_t expires = e.time + 1;
+  if (expires < earliest) expires = earliest;
+
+  uint64_t delta = expires - current;
+  unsigned level = 0;
+
+  while (level < numLevels - 1 && (1ULL << ((level + 1) * levelBits)) <= delta)
+    level++;
+
+  // Beyond the wheel, placed again when the last slot is reached
+  uint64_t span = 1ULL << ((level + 1) * levelBits);
+  if (span <= delta) expires = current + span - 1;
+
+  Entry *&head = slots[level][(expires >> (level * levelBits)) & slotMask];
+
+  e.next = head;
+  e.prev = &head;
+  if (head) head->prev = &e.next;
+  head = &e;
+}
+
+
+void TimerWheel::cascade(unsigned level) {
+  Entry *&head = slots[level][(current >> (level * levelBits)) & slotMask];
+
+  while (head) {
+    Entry &e = *head;
+    e.unlink();
+    place(e, current);
+  }
+}
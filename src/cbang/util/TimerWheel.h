@@ -0,0 +1,90 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+
+namespace cb {
+  /**
+   * Hierarchical timing wheel with one tick resolution.  Entries are linked
+   * into the wheel directly so scheduling and canceling never allocate.
+   */
+  class TimerWheel {
+  public:
+    class Entry {
+      friend class TimerWheel;
+
+      TimerWheel *wheel = 0;
+      Entry *next = 0;
+      Entry **prev = 0;
+      uint64_t time = 0;
+
+    public:
+      virtual ~Entry() {cancel();}
+
+      bool isScheduled() const {return wheel;}
+      uint64_t getTime() const {return time;}
+      void cancel();
+
+      /// Called on the first tick after the scheduled time
+      virtual void expired(uint64_t now) = 0;
+
+    protected:
+      void unlink();
+    };
+
+  protected:
+    static const unsigned levelBits = 6;
+    static const unsigned numLevels = 4;
+    static const unsigned numSlots  = 1 << levelBits;
+    static const unsigned slotMask  = numSlots - 1;
+
+    Entry *slots[numLevels][numSlots];
+    uint64_t current;
+    unsigned count = 0;
+
+  public:
+    TimerWheel(uint64_t now);
+    ~TimerWheel();
+
+    unsigned getCount() const {return count;}
+
+    void schedule(Entry &e, uint64_t time);
+    void advance(uint64_t now);
+
+  protected:
+    void place(Entry &e, uint64_t earliest);
+    void cascade(unsigned level);
+  };
+}
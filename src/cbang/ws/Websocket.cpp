@@ -108,7 +108,7 @@ void Websocket::ping(const string &payload) {
 
 bool Websocket::upgrade() {
   // Check if websocket upgrade is allowed
-  bool upgrade = getInputHeaders().keyContains("Connection", "upgrade");
+  bool upgrade = inContains("Connection", "upgrade");
   string key = inFind("Sec-WebSocket-Key");
 
   if (!upgrade || key.empty() || getVersion() < Version(1, 1)) return false;
@@ -0,0 +1,301 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+#include <cbang/event/Base.h>
+#include <cbang/event/Event.h>
+#include <cbang/http/Server.h>
+#include <cbang/http/Request.h>
+#include <cbang/http/Conn.h>
+#include <cbang/http/CacheHandler.h>
+#include <cbang/http/FileHandler.h>
+#include <cbang/os/SystemUtilities.h>
+#include <cbang/thread/Thread.h>
+#include <cbang/time/Timer.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/log/Logger.h>
+
+#include <common/HTTPTestClient.h>
+
+#include <iostream>
+
+#include <signal.h>
+
+using namespace cb;
+using namespace std;
+
+
+// Counts calls and replies with the path and a call number
+class Handler : public HTTP::RequestHandler {
+  vector<SmartPointer<Event::Event> > delayed;
+
+public:
+  unsigned calls = 0;
+
+
+  // From HTTP::RequestHandler
+  bool operator()(HTTP::Request &req) override {
+    string path = req.getURI().getPath();
+    string body = SSTR(path << " call=" << ++calls);
+
+    if (path == "/api/nostore") req.setCache(0);
+    if (path == "/api/ttl") req.outSet("Cache-Control", "max-age=2");
+    if (path == "/api/large") body += string(4096, 'x');
+    if (path == "/api/vary") body += " user=" + req.inFind("X-User");
+    if (path == "/api/missing") return false;
+
+    if (path == "/api/slow") {
+      // Reply on the event loop that owns the connection
+      auto &base = req.getConnection()->getBase();
+      auto reqPtr = SmartPtr(&req);
+      delayed.push_back(base.newEvent([reqPtr, body] () {
+        reqPtr->reply(body);
+      }, 0));
+      delayed.back()->add(0.25);
+
+    } else req.reply(body);
+
+    return true;
+  }
+};
+
+
+class CacheClient : public Thread {
+  Event::Base &base;
+  SockAddr addr;
+  string test;
+
+public:
+  CacheClient(Event::Base &base, const SockAddr &addr, const string &test) :
+    base(base), addr(addr), test(test) {}
+
+
+  HTTPTest::Response request(const string &path,
+                             const string &headers = "") {
+    return HTTPTest::request(addr, path, headers);
+  }
+
+
+  void print(const HTTPTest::Response &res) {
+    cout << res.code;
+
+    for (auto name: {"Content-Encoding", "Vary"}) {
+      string value = res.get(name);
+      if (!value.empty()) cout << ' ' << name << '=' << value;
+    }
+
+    if (res.get("Content-Encoding").empty())
+      cout << ' ' << res.body.substr(0, 40);
+    else cout << " compressed=" << (res.body.length() < 4096);
+
+    cout << endl;
+  }
+
+
+  void basic() {
+    for (unsigned i = 0; i < 3; i++) print(request("/api/data"));
+    print(request("/api/data?x=1"));
+    print(request("/api/data?x=1"));
+    print(request("/api/missing"));
+  }
+
+
+  void ttl() {
+    print(request("/api/nostore"));
+    print(request("/api/nostore"));
+    print(request("/api/ttl"));
+    print(request("/api/ttl"));
+    Timer::sleep(3);
+    print(request("/api/ttl"));
+  }
+
+
+  void coalesce() {
+    vector<SmartPointer<HTTPTest::Connection> > conns;
+    for (unsigned i = 0; i < 10; i++)
+      conns.push_back(HTTPTest::send(addr, "/api/slow"));
+    for (auto &conn: conns) print(conn->receive());
+    print(request("/api/slow"));
+  }
+
+
+  void vary() {
+    print(request("/api/vary", "X-User: alice\r\n"));
+    print(request("/api/vary", "X-User: bob\r\n"));
+    print(request("/api/vary", "X-User: alice\r\n"));
+  }
+
+
+  void gzip() {
+    print(request("/api/large", "Accept-Encoding: gzip\r\n"));
+    print(request("/api/large", "Accept-Encoding: gzip\r\n"));
+    print(request("/api/large"));
+  }
+
+
+  void file() {
+    for (unsigned i = 0; i < 2; i++) {
+      auto res = request("/files/large.txt");
+      cout << res.code << " length=" << res.body.length() << " cached="
+           << res.has("Age") << endl;
+    }
+  }
+
+
+  void encoded() {
+    print(request("/files/small.txt", "Accept-Encoding: gzip\r\n"));
+    print(request("/files/small.txt"));
+    print(request("/files/small.txt", "Accept-Encoding: gzip\r\n"));
+    print(request("/files/small.txt"));
+  }
+
+
+  void evict() {
+    // Room for two of the small files, the least recently used goes first
+    print(request("/files/small.txt", "Accept-Encoding: gzip\r\n"));
+    print(request("/files/small.txt"));
+    print(request("/files/small.txt"));
+    print(request("/files/other.txt"));
+
+    // The plain variant is still found after its sibling was evicted
+    print(request("/files/small.txt"));
+    print(request("/files/small.txt", "Accept-Encoding: gzip\r\n"));
+  }
+
+
+  void fallthrough() {
+    vector<SmartPointer<HTTPTest::Connection> > conns;
+    for (unsigned i = 0; i < 4; i++)
+      conns.push_back(HTTPTest::send(addr, "/undecided"));
+    for (auto &conn: conns) print(conn->receive());
+  }
+
+
+  // From Thread
+  void run() override {
+    try {
+      if (test == "basic") basic();
+      else if (test == "ttl") ttl();
+      else if (test == "coalesce") coalesce();
+      else if (test == "vary") vary();
+      else if (test == "gzip") gzip();
+      else if (test == "file") file();
+      else if (test == "encoded") encoded();
+      else if (test == "evict") evict();
+      else if (test == "fallthrough") fallthrough();
+      else THROW("Unknown test " << test);
+    } CATCH_ERROR;
+
+    base.loopExit();
+  }
+};
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("bind", "Server listen address and port")
+      ->setDefault("127.0.0.1:8769");
+    cmdLine.add("test", "Test to run")->setDefault("basic");
+    cmdLine.add("default-ttl", "Cache time for responses without max-age")
+      ->setDefault(60);
+    cmdLine.add("threads", "Server event loop threads")->setDefault(1);
+    cmdLine.parse(argc, argv);
+
+    SockAddr addr = SockAddr::parse(cmdLine["--bind"]);
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    Event::Base base(true);
+    HTTP::Server server(base);
+    server.setThreads(cmdLine["--threads"].toInteger());
+    SmartPointer<RateSet> stats = new RateSet;
+
+    SmartPointer<Handler> handler = new Handler;
+    SmartPointer<HTTP::CacheHandler> cache = new HTTP::CacheHandler(handler);
+    cache->setStats(stats);
+    cache->setDefaultTTL(cmdLine["--default-ttl"].toInteger());
+    cache->addVary("X-User");
+
+    // Files are served from disk and some have precompressed variants
+    string root = SystemUtilities::absolute("cache-test-root");
+    SystemUtilities::ensureDirectory(root + "/files");
+    *SystemUtilities::oopen(root + "/files/large.txt") << string(1000000, 'x');
+    *SystemUtilities::oopen(root + "/files/small.txt") << "Small file";
+    *SystemUtilities::oopen(root + "/files/small.txt.gz") << "GZIP DATA";
+    *SystemUtilities::oopen(root + "/files/other.txt") << "Other file";
+
+    SmartPointer<HTTP::CacheHandler> files =
+      new HTTP::CacheHandler(new HTTP::FileHandler(root));
+    files->setDefaultTTL(60);
+    files->setMaxBytes(350); // About two small files
+    files->setStats(stats);
+    server.addHandler(HTTP::Method::HTTP_GET, "/files/.*", files);
+
+    // Decides slowly not to handle the request, the next handler does
+    server.addHandler(
+      HTTP::Method::HTTP_GET, "/undecided", new HTTP::CacheHandler(
+        new HTTP::RequestFunctionHandler([] (HTTP::Request &req) {
+          Timer::sleep(0.25);
+          return false;
+        })));
+    server.addHandler(
+      HTTP::Method::HTTP_GET, "/undecided",
+      new HTTP::RequestFunctionHandler([] (HTTP::Request &req) {
+        req.reply("fallback");
+        return true;
+      }));
+
+    server.addHandler(cache);
+    server.bind(addr);
+
+    CacheClient client(base, addr, cmdLine["--test"]);
+    client.start();
+
+    base.dispatch();
+    client.join();
+
+    SystemUtilities::rmdir(root, true);
+
+    cout << "calls=" << handler->calls;
+    for (auto &p: *stats)
+      cout << ' ' << p.first.substr(6) << '=' << p.second.getTotal();
+    cout << endl;
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
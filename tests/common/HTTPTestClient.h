@@ -0,0 +1,232 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/String.h>
+#include <cbang/Exception.h>
+#include <cbang/SmartPointer.h>
+#include <cbang/net/Socket.h>
+#include <cbang/net/SockAddr.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+// Blocking raw HTTP/1.1 client shared by the HTTP server tests.  Requests
+// are written as given so tests control exactly what the server reads.
+namespace HTTPTest {
+  struct Response {
+    unsigned code = 0;
+    std::map<std::string, std::string> headers; ///< Lower case names
+    std::string body;    ///< Without chunk framing
+    unsigned chunks = 0; ///< Non-empty chunks in a chunked body
+
+    bool has(const std::string &name) const
+    {return headers.count(cb::String::toLower(name));}
+
+    std::string get(const std::string &name) const {
+      auto it = headers.find(cb::String::toLower(name));
+      return it == headers.end() ? "" : it->second;
+    }
+
+
+    /// Parses the response head
+    void parseHead(const std::string &head) {
+      std::vector<std::string> lines;
+      cb::String::tokenize(head, lines, "\r\n");
+      if (lines.empty() || lines[0].length() < 12)
+        THROW("Invalid status line");
+
+      code = cb::String::parseU32(lines[0].substr(9, 3));
+
+      for (unsigned i = 1; i < lines.size(); i++) {
+        size_t colon = lines[i].find(':');
+        headers[cb::String::toLower(lines[i].substr(0, colon))] =
+          cb::String::trim(lines[i].substr(colon + 1));
+      }
+    }
+
+
+    /// Removes the chunk framing from @param data.
+    /// @return the bytes of @param data consumed, or zero if incomplete
+    static size_t dechunk(const std::string &data, std::string &body,
+                          unsigned *chunks = 0) {
+      size_t offset = 0;
+
+      while (true) {
+        size_t eol = data.find("\r\n", offset);
+        if (eol == std::string::npos) return 0;
+
+        unsigned size =
+          cb::String::parseU32("0x" + data.substr(offset, eol - offset));
+        if (data.length() < eol + 2 + size + 2) return 0;
+        if (!size) return eol + 4;
+
+        body += data.substr(eol + 2, size);
+        if (chunks) (*chunks)++;
+        offset = eol + 2 + size + 2;
+      }
+    }
+
+
+    /// Parses a complete response which ends with the input
+    static Response parse(const std::string &input) {
+      size_t end = input.find("\r\n\r\n");
+      if (end == std::string::npos) THROW("Incomplete response");
+
+      Response res;
+      res.parseHead(input.substr(0, end));
+
+      std::string body = input.substr(end + 4);
+      if (res.get("Transfer-Encoding") == "chunked")
+        dechunk(body, res.body, &res.chunks);
+      else res.body = body;
+
+      return res;
+    }
+  };
+
+
+  inline std::string format(const std::string &method,
+                            const std::string &path,
+                            const std::string &headers = "",
+                            const std::string &body = "",
+                            bool close = true) {
+    return method + " " + path + " HTTP/1.1\r\nHost: test\r\n" +
+      (close ? "Connection: close\r\n" : "") + headers + "\r\n" + body;
+  }
+
+
+  class Connection {
+    cb::Socket socket;
+    std::string input;
+
+  public:
+    Connection(const cb::SockAddr &addr) {
+      socket.open();
+      socket.connect(addr);
+    }
+
+
+    /// Data read but not yet consumed
+    std::string &getInput() {return input;}
+
+    void write(const std::string &data)
+    {socket.write((const uint8_t *)data.data(), data.length());}
+
+
+    /// @return false at the end of the stream
+    bool fill() {
+      try {
+        uint8_t buf[4096];
+        auto bytes = socket.read(buf, sizeof(buf));
+        input.append((char *)buf, bytes);
+        return true;
+      } catch (const cb::Socket::EndOfStream &) {}
+
+      return false;
+    }
+
+
+    void readAll() {while (fill()) continue;}
+
+
+    bool readUntil(const std::string &delim, std::string &data) {
+      while (true) {
+        size_t end = input.find(delim);
+
+        if (end != std::string::npos) {
+          data = input.substr(0, end);
+          input = input.substr(end + delim.length());
+          return true;
+        }
+
+        if (!fill()) return false;
+      }
+    }
+
+
+    bool readBody(unsigned length, std::string &body) {
+      while (input.length() < length)
+        if (!fill()) return false;
+
+      body = input.substr(0, length);
+      input = input.substr(length);
+      return true;
+    }
+
+
+    /// Reads one of several responses on a persistent connection.  The
+    /// body length comes from Content-Length.
+    bool readResponse(Response &res) {
+      std::string head;
+      if (!readUntil("\r\n\r\n", head)) return false;
+
+      res = Response();
+      res.parseHead(head);
+
+      std::string length = res.get("Content-Length");
+      return readBody(length.empty() ? 0 : cb::String::parseU32(length),
+                      res.body);
+    }
+
+
+    /// Reads the response to a "Connection: close" request
+    Response receive() {
+      readAll();
+      auto res = Response::parse(input);
+      input.clear();
+      return res;
+    }
+  };
+
+
+  inline cb::SmartPointer<Connection>
+  send(const cb::SockAddr &addr, const std::string &path,
+       const std::string &headers = "", const std::string &method = "GET",
+       const std::string &body = "") {
+    cb::SmartPointer<Connection> conn = new Connection(addr);
+    conn->write(format(method, path, headers, body));
+    return conn;
+  }
+
+
+  /// Makes one request on a new connection
+  inline Response request(const cb::SockAddr &addr, const std::string &path,
+                          const std::string &headers = "",
+                          const std::string &method = "GET",
+                          const std::string &body = "") {
+    return send(addr, path, headers, method, body)->receive();
+  }
+}
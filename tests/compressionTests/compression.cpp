@@ -0,0 +1,241 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+#include <cbang/event/Base.h>
+#include <cbang/event/Buffer.h>
+#include <cbang/event/BufferFilter.h>
+#include <cbang/http/Server.h>
+#include <cbang/http/Request.h>
+#include <cbang/thread/Thread.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/log/Logger.h>
+
+#include <common/HTTPTestClient.h>
+
+#include <iostream>
+
+#include <signal.h>
+
+using namespace cb;
+using namespace std;
+
+
+string makeBody(unsigned size) {
+  string body;
+  for (unsigned i = 0; body.length() < size; i++)
+    body += SSTR("line " << i << " of the response body\n");
+  return body.substr(0, size);
+}
+
+
+string chunkedBody() {
+  string body;
+  for (unsigned i = 0; i < 3; i++) body += makeBody(1000 + i);
+  return body;
+}
+
+
+string decompress(Compression compression, const string &data) {
+  Event::Buffer in(data);
+  Event::Buffer out;
+  Event::BufferFilter::decompressor(compression)->filter(in, out);
+  return out.toString();
+}
+
+
+// Streams pieces through each compressor, flushing after every piece, and
+// checks the decompressor can decode everything sent so far.  BZip2 cannot
+// flush to a byte boundary so it only streams whole blocks.
+void filterTest() {
+  string body = makeBody(100000);
+
+  for (auto compression:
+         {Compression::COMPRESSION_GZIP, Compression::COMPRESSION_ZLIB,
+          Compression::COMPRESSION_BZIP2, Compression::COMPRESSION_LZ4}) {
+    auto compressor = Event::BufferFilter::compressor(compression);
+    auto decompressor = Event::BufferFilter::decompressor(compression);
+    Event::Buffer compressed;
+    Event::Buffer result;
+    bool streamed = true;
+
+    for (unsigned i = 0; i < body.length(); i += 30000) {
+      Event::Buffer piece(body.substr(i, 30000));
+      compressor->filter(piece, compressed);
+      compressor->flush(compressed);
+
+      decompressor->filter(compressed, result);
+      if (result.getLength() != min((unsigned)body.length(), i + 30000))
+        streamed = false;
+    }
+
+    compressor->finish(compressed);
+    decompressor->filter(compressed, result);
+
+    cout << String::toLower(Compression(compression).toString())
+         << " streamed=" << streamed << " match=" << (result.toString() == body)
+         << endl;
+  }
+}
+
+
+class Handler : public HTTP::RequestHandler {
+public:
+  // From HTTP::RequestHandler
+  bool operator()(HTTP::Request &req) override {
+    string path = req.getURI().getPath();
+
+    req.compressOutput();
+
+    if (path == "/small") req.reply("small");
+    else if (path == "/image.png") req.reply(makeBody(4096));
+    else if (path == "/text") {
+      // Written through the output stream
+      *req.getOutputStream() << makeBody(4096);
+      req.reply();
+
+    } else if (path == "/chunked") {
+      req.setContentType("text/plain");
+      req.startChunked();
+      for (unsigned i = 0; i < 3; i++) req.sendChunk(makeBody(1000 + i));
+      req.endChunked();
+
+    } else return false;
+
+    return true;
+  }
+};
+
+
+class CompressionClient : public Thread {
+  Event::Base &base;
+  SockAddr addr;
+  string test;
+
+public:
+  CompressionClient(Event::Base &base, const SockAddr &addr,
+                    const string &test) : base(base), addr(addr), test(test) {}
+
+
+  void request(const string &path, const string &expect,
+               const string &encoding = "") {
+    string headers;
+    if (!encoding.empty()) headers = "Accept-Encoding: " + encoding + "\r\n";
+    auto res = HTTPTest::request(addr, path, headers);
+
+    string body = res.body;
+    string encoding_ = res.get("Content-Encoding");
+    if (encoding_ == "gzip")
+      body = decompress(Compression::COMPRESSION_GZIP, body);
+    else if (encoding_ == "lz4")
+      body = decompress(Compression::COMPRESSION_LZ4, body);
+
+    cout << res.code << ' ' << path << " encoding=" << encoding_
+         << " vary=" << res.get("Vary");
+    if (res.chunks) cout << " chunks=" << res.chunks;
+    cout << " length=" << body.length() << " match=" << (body == expect)
+         << endl;
+  }
+
+
+  void response() {
+    request("/text", makeBody(4096), "gzip");
+    request("/text", makeBody(4096), "lz4");
+    request("/text", makeBody(4096));
+    request("/small", "small", "gzip");
+    request("/image.png", makeBody(4096), "gzip");
+  }
+
+
+  void chunked() {
+    request("/chunked", chunkedBody(), "gzip");
+    request("/chunked", chunkedBody());
+  }
+
+
+  // From Thread
+  void run() override {
+    try {
+      if (test == "response") response();
+      else if (test == "chunked") chunked();
+      else THROW("Unknown test " << test);
+    } CATCH_ERROR;
+
+    base.loopExit();
+  }
+};
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("bind", "Server listen address and port")
+      ->setDefault("127.0.0.1:8770");
+    cmdLine.add("test", "Test to run")->setDefault("filter");
+    cmdLine.add("min-size", "Minimum size of compressed responses")
+      ->setDefault(1024);
+    cmdLine.add("text-level", "Compression level for text/*")
+      ->setDefault(-1);
+    cmdLine.parse(argc, argv);
+
+    string test = cmdLine["--test"];
+    if (test == "filter") {
+      filterTest();
+      return 0;
+    }
+
+    SockAddr addr = SockAddr::parse(cmdLine["--bind"]);
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    Event::Base base(true);
+    HTTP::Server server(base);
+    server.setCompressionMinSize(cmdLine["--min-size"].toInteger());
+    server.setCompressionLevel("text/*",
+                               cmdLine["--text-level"].toInteger());
+    server.addHandler(new Handler);
+    server.bind(addr);
+
+    CompressionClient client(base, addr, test);
+    client.start();
+
+    base.dispatch();
+    client.join();
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
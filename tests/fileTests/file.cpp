@@ -0,0 +1,217 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+#include <cbang/event/Base.h>
+#include <cbang/http/Server.h>
+#include <cbang/http/FileHandler.h>
+#include <cbang/os/SystemUtilities.h>
+#include <cbang/thread/Thread.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/log/Logger.h>
+
+#include <common/HTTPTestClient.h>
+
+#include <iostream>
+
+#include <signal.h>
+
+using namespace cb;
+using namespace std;
+
+
+// Sends each request on a new connection and prints what came back
+class FileClient : public Thread {
+  Event::Base &base;
+  SockAddr addr;
+  string test;
+  string root;
+
+public:
+  FileClient(Event::Base &base, const SockAddr &addr, const string &test,
+             const string &root) :
+    base(base), addr(addr), test(test), root(root) {}
+
+
+  void print(const HTTPTest::Response &res) {
+    cout << res.code;
+
+    for (auto name: {"Content-Length", "Content-Range", "Content-Encoding",
+          "Vary"}) {
+      string value = res.get(name);
+      if (!value.empty()) cout << ' ' << name << '=' << value;
+    }
+
+    string type = res.get("Content-Type");
+    string body = res.body;
+    size_t pos = type.find("boundary=");
+
+    if (pos != string::npos) {
+      string boundary = type.substr(pos + 9);
+      type = type.substr(0, type.find(';'));
+      body = String::replace(body, boundary, "BOUNDARY");
+    }
+
+    if (!type.empty()) cout << " Content-Type=" << type;
+    cout << endl;
+
+    if (!body.empty()) cout << String::escapeC(body) << endl;
+  }
+
+
+  HTTPTest::Response request(const string &path, const string &headers = "",
+                             const string &method = "GET") {
+    return HTTPTest::request(addr, path, headers, method);
+  }
+
+
+  void conditional() {
+    auto res = request("/hello.txt");
+    print(res);
+
+    string etag = res.get("ETag");
+    string lastModified = res.get("Last-Modified");
+
+    print(request("/hello.txt", "If-None-Match: " + etag + "\r\n"));
+    print(request("/hello.txt", "If-None-Match: \"other\"\r\n"));
+    print(request("/hello.txt", "If-Modified-Since: " + lastModified +
+                  "\r\n"));
+    print(request("/hello.txt", "If-Modified-Since: "
+                  "Thu, 01 Jan 1970 00:00:00 GMT\r\n"));
+    print(request("/hello.txt", "", "HEAD"));
+  }
+
+
+  void range() {
+    for (auto range: {"bytes=0-4", "bytes=6-", "bytes=-6", "bytes=6-100",
+          "bytes=100-", "bytes=0-4,6-10", "bytes=a-b", "items=0-4"})
+      print(request("/hello.txt", SSTR("Range: " << range << "\r\n")));
+
+    auto etag = request("/hello.txt").get("ETag");
+    print(request("/hello.txt", "Range: bytes=0-4\r\nIf-Range: " + etag +
+                  "\r\n"));
+    print(request("/hello.txt", "Range: bytes=0-4\r\nIf-Range: \"old\"\r\n"));
+  }
+
+
+  void precompressed() {
+    print(request("/hello.txt", "Accept-Encoding: gzip\r\n"));
+    print(request("/hello.txt", "Accept-Encoding: lz4\r\n"));
+    print(request("/hello.txt", "Accept-Encoding: identity\r\n"));
+    print(request("/plain.txt", "Accept-Encoding: gzip\r\n"));
+  }
+
+
+  void modified() {
+    print(request("/hello.txt"));
+    *SystemUtilities::oopen(root + "/hello.txt") << "Goodbye World!\n";
+    print(request("/hello.txt"));
+    SystemUtilities::unlink(root + "/hello.txt");
+    print(request("/hello.txt"));
+  }
+
+
+  void rewrite() {
+    auto res = request("/hello.txt");
+    print(res);
+
+    // Same size and inode, usually within the same second
+    *SystemUtilities::oopen(root + "/hello.txt") << "Hello There!\n";
+    auto rewritten = request("/hello.txt");
+    print(rewritten);
+
+    cout << "etag-changed=" << (res.get("ETag") != rewritten.get("ETag"))
+         << endl;
+  }
+
+
+  // From Thread
+  void run() override {
+    try {
+      if (test == "conditional") conditional();
+      else if (test == "range") range();
+      else if (test == "precompressed") precompressed();
+      else if (test == "modified") modified();
+      else if (test == "rewrite") rewrite();
+      else THROW("Unknown test " << test);
+    } CATCH_ERROR;
+
+    base.loopExit();
+  }
+};
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("bind", "Server listen address and port")
+      ->setDefault("127.0.0.1:8768");
+    cmdLine.add("test", "Test to run")->setDefault("conditional");
+    cmdLine.add("cache-file-size", "Largest file cached in memory")
+      ->setDefault(1024);
+    cmdLine.parse(argc, argv);
+
+    SockAddr addr = SockAddr::parse(cmdLine["--bind"]);
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    string root = SystemUtilities::absolute("file-test-root");
+    SystemUtilities::ensureDirectory(root);
+    *SystemUtilities::oopen(root + "/hello.txt") << "Hello World!\n";
+    *SystemUtilities::oopen(root + "/hello.txt.gz") << "GZIP DATA";
+    *SystemUtilities::oopen(root + "/hello.txt.lz4") << "LZ4 DATA";
+    *SystemUtilities::oopen(root + "/plain.txt") << "Plain\n";
+
+    Event::Base base(true);
+    HTTP::Server server(base);
+    SmartPointer<HTTP::FileHandler> handler = new HTTP::FileHandler(root);
+    handler->getCache()->setMaxFileSize(
+      cmdLine["--cache-file-size"].toInteger());
+    server.addHandler(handler);
+    server.bind(addr);
+
+    FileClient client(base, addr, cmdLine["--test"], root);
+    client.start();
+
+    base.dispatch();
+    client.join();
+
+    SystemUtilities::rmdir(root, true);
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
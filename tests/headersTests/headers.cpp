@@ -0,0 +1,94 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Exception.h>
+#include <cbang/String.h>
+#include <cbang/event/Buffer.h>
+#include <cbang/http/Headers.h>
+
+#include <exception>
+#include <iostream>
+
+using namespace cb;
+using namespace std;
+
+
+int main(int argc, char *argv[]) {
+  try {
+    for (int i = 1; i < argc; i++) {
+      cout << String::escapeC(argv[i]) << " => ";
+
+      try {
+        Event::Buffer buf(argv[i]);
+        HTTP::Headers hdrs;
+
+        if (!hdrs.parse(buf)) THROW("Incomplete headers");
+
+        cout << "{" << endl;
+        for (auto &p: hdrs) {
+          string lower = String::toLower(p.first);
+          string upper = String::toUpper(p.first);
+
+          cout << "  " << p.first << ": '" << p.second << "' id="
+               << HTTP::Headers::getID(lower) << " lower='"
+               << hdrs.find(lower) << "' upper='" << hdrs.find(upper)
+               << "'" << endl;
+        }
+
+        cout << "  Connection close="
+             << (hdrs.needsClose() ? "true" : "false") << " keep-alive="
+             << (hdrs.connectionKeepAlive() ? "true" : "false") << endl;
+
+        hdrs.remove(HTTP::HEADER_CONTENT_LENGTH);
+        hdrs.set("X-Added", "1");
+        cout << "  Keys:";
+        for (auto &p: hdrs) cout << ' ' << p.first;
+        cout << endl << "}";
+
+      } catch (const Exception &e) {
+        cout << "INVALID: " << e.getMessage();
+      }
+
+      cout << endl;
+    }
+
+    return 0;
+
+  } catch (const Exception &e) {
+    cerr << "Exception: " << e << endl;
+
+  } catch (const std::exception &e) {
+    cerr << "std::exception: " << e.what() << endl;
+  }
+
+  return 1;
+}
@@ -0,0 +1,174 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+#include <cbang/event/Base.h>
+#include <cbang/event/Event.h>
+#include <cbang/http/Server.h>
+#include <cbang/http/Request.h>
+#include <cbang/http/ConnIn.h>
+#include <cbang/thread/Thread.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/log/Logger.h>
+
+#include <common/HTTPTestClient.h>
+
+#include <iostream>
+
+#include <signal.h>
+
+using namespace cb;
+using namespace std;
+
+
+// The first response is delayed so the server reads ahead as far as it will
+class PipelineServer : public HTTP::Server {
+  SmartPointer<Event::Event> delayEvent;
+  HTTP::Request *first = 0;
+
+public:
+  unsigned maxQueued = 0;
+
+  PipelineServer(Event::Base &base) :
+    HTTP::Server(base),
+    delayEvent(base.newEvent(this, &PipelineServer::replyFirst, 0)) {}
+
+
+  void reply(HTTP::Request &req) {
+    req.reply(req.getURI().getPath() + req.getInputBuffer().toString());
+  }
+
+
+  void replyFirst() {
+    maxQueued = first->getConnection()->getNumRequests();
+    reply(*first);
+  }
+
+
+  // From HTTP::Server
+  bool operator()(HTTP::Request &req) override {
+    if (!first) {
+      first = &req;
+      delayEvent->add(0.25);
+
+    } else reply(req);
+
+    return true;
+  }
+};
+
+
+// Writes all requests at once on one connection then checks the responses
+class PipelineClient : public Thread {
+  Event::Base &base;
+  SockAddr addr;
+  unsigned count;
+  bool post;
+
+public:
+  unsigned responses = 0;
+  unsigned inOrder = 0;
+
+  PipelineClient(Event::Base &base, const SockAddr &addr, unsigned count,
+                 bool post) :
+    base(base), addr(addr), count(count), post(post) {}
+
+
+  // From Thread
+  void run() override {
+    try {
+      HTTPTest::Connection conn(addr);
+
+      string requests;
+      for (unsigned i = 0; i < count; i++) {
+        string close = i == count - 1 ? "Connection: close\r\n" : "";
+
+        if (post)
+          requests += SSTR("POST /" << i << " HTTP/1.1\r\nHost: test\r\n"
+                           << close << "Content-Length: 5\r\n\r\n:body");
+        else requests += SSTR("GET /" << i << " HTTP/1.1\r\nHost: test\r\n"
+                              << close << "\r\n");
+      }
+
+      conn.write(requests);
+
+      HTTPTest::Response res;
+      while (conn.readResponse(res)) {
+        string expected = SSTR('/' << responses << (post ? ":body" : ""));
+        if (res.body == expected) inOrder++;
+        responses++;
+      }
+    } CATCH_ERROR;
+
+    base.loopExit();
+  }
+};
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("bind", "Server listen address and port")
+      ->setDefault("127.0.0.1:8767");
+    cmdLine.add("count", "Number of pipelined requests")->setDefault(1000);
+    cmdLine.add("depth", "Server pipeline depth")->setDefault(16);
+    cmdLine.add("post", "Send POST requests with a body")->setDefault(false);
+    cmdLine.parse(argc, argv);
+
+    SockAddr addr = SockAddr::parse(cmdLine["--bind"]);
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    Event::Base base(true);
+    PipelineServer server(base);
+    server.setMaxPipelined(cmdLine["--depth"].toInteger());
+    server.bind(addr);
+
+    PipelineClient client(base, addr, cmdLine["--count"].toInteger(),
+                          cmdLine["--post"].toBoolean());
+    client.start();
+
+    base.dispatch();
+    client.join();
+
+    cout << "responses=" << client.responses << endl
+         << "in-order=" << client.inOrder << endl
+         << "read-ahead=" << server.maxQueued << endl;
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
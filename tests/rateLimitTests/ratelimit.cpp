@@ -0,0 +1,255 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+#include <cbang/event/Base.h>
+#include <cbang/event/Event.h>
+#include <cbang/http/Server.h>
+#include <cbang/http/Request.h>
+#include <cbang/http/Conn.h>
+#include <cbang/http/RateLimiter.h>
+#include <cbang/http/LoadShedder.h>
+#include <cbang/thread/Thread.h>
+#include <cbang/time/Timer.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/log/Logger.h>
+
+#include <common/HTTPTestClient.h>
+
+#include <iostream>
+
+#include <signal.h>
+
+using namespace cb;
+using namespace std;
+
+
+// Replies with the path, "/slow" after a delay and "/block" after blocking
+// the event loop
+class Handler : public HTTP::RequestHandler {
+  vector<SmartPointer<Event::Event> > delayed;
+
+public:
+  // From HTTP::RequestHandler
+  bool operator()(HTTP::Request &req) override {
+    string path = req.getURI().getPath();
+
+    if (path == "/slow") {
+      auto &base = req.getConnection()->getBase();
+      auto reqPtr = SmartPtr(&req);
+      delayed.push_back(base.newEvent([reqPtr, path] () {
+        reqPtr->reply(path);
+      }, 0));
+      delayed.back()->add(0.5);
+      return true;
+    }
+
+    if (path == "/block") Timer::sleep(0.3);
+
+    req.reply(path);
+    return true;
+  }
+};
+
+
+class RateClient : public Thread {
+  Event::Base &base;
+  SockAddr addr;
+  string test;
+
+public:
+  RateClient(Event::Base &base, const SockAddr &addr, const string &test) :
+    base(base), addr(addr), test(test) {}
+
+
+  void print(const HTTPTest::Response &res) {
+    cout << res.code;
+
+    string retry = res.get("Retry-After");
+    if (!retry.empty()) cout << " Retry-After=" << retry;
+    if (res.code == 200) cout << ' ' << res.body;
+
+    cout << endl;
+  }
+
+
+  void request(const string &path, const string &headers = "",
+               const string &method = "GET", const string &body = "") {
+    print(HTTPTest::request(addr, path, headers, method, body));
+  }
+
+
+  void global() {
+    for (unsigned i = 0; i < 5; i++) request("/data");
+  }
+
+
+  void key() {
+    for (unsigned i = 0; i < 3; i++) request("/data", "X-API-Key: one\r\n");
+    request("/data", "X-API-Key: two\r\n");
+    request("/data");
+  }
+
+
+  void group() {
+    request("/api/data");
+    request("/api/data");
+    for (unsigned i = 0; i < 3; i++) request("/public");
+  }
+
+
+  void body() {
+    request("/api/upload", "Content-Length: 4\r\n", "POST", "data");
+
+    // Rejected without waiting for the body which is never sent
+    request("/api/upload", "Content-Length: 10000000\r\n", "POST");
+  }
+
+
+  void queued() {
+    auto slow1 = HTTPTest::send(addr, "/slow");
+    auto slow2 = HTTPTest::send(addr, "/slow");
+    Timer::sleep(0.1);
+
+    request("/fast");
+    print(slow1->receive());
+    print(slow2->receive());
+    request("/fast");
+  }
+
+
+  void lag() {
+    request("/block");
+    request("/fast");
+    Timer::sleep(0.2);
+    request("/fast");
+  }
+
+
+  // From Thread
+  void run() override {
+    try {
+      if (test == "global") global();
+      else if (test == "key") key();
+      else if (test == "group") group();
+      else if (test == "body") body();
+      else if (test == "queued") queued();
+      else if (test == "lag") lag();
+      else THROW("Unknown test " << test);
+    } CATCH_ERROR;
+
+    base.loopExit();
+  }
+};
+
+
+void buckets() {
+  HTTP::RateLimiter limiter(2, 3, 2);
+
+  for (unsigned i = 0; i < 4; i++)
+    cout << "a t=0 wait=" << limiter.take("a", 0) << endl;
+  cout << "a t=0.5 wait=" << limiter.take("a", 0.5) << endl;
+  cout << "a t=0.5 wait=" << limiter.take("a", 0.5) << endl;
+  cout << "a t=10 wait=" << limiter.take("a", 10) << endl;
+
+  // Only the two most recent clients are kept
+  limiter.take("b", 10);
+  limiter.take("c", 10);
+  cout << "clients=" << limiter.getClientCount() << endl;
+  for (unsigned i = 0; i < 4; i++)
+    cout << "a evicted wait=" << limiter.take("a", 10) << endl;
+}
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("bind", "Server listen address and port")
+      ->setDefault("127.0.0.1:8772");
+    cmdLine.add("test", "Test to run")->setDefault("global");
+    cmdLine.add("threads", "Server event loop threads")->setDefault(1);
+    cmdLine.parse(argc, argv);
+
+    string test = cmdLine["--test"];
+    if (test == "buckets") {
+      buckets();
+      return 0;
+    }
+
+    SockAddr addr = SockAddr::parse(cmdLine["--bind"]);
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    Event::Base base(true);
+    HTTP::Server server(base);
+    server.setThreads(cmdLine["--threads"].toInteger());
+
+    SmartPointer<Handler> handler = new Handler;
+
+    if (test == "global") server.setRateLimiter(new HTTP::RateLimiter(1, 3));
+
+    if (test == "key") {
+      SmartPointer<HTTP::RateLimiter> limiter = new HTTP::RateLimiter(1, 2);
+      limiter->setKey("header:X-API-Key");
+      server.setRateLimiter(limiter);
+    }
+
+    if (test == "group" || test == "body") {
+      auto api = server.addGroup(HTTP::Method::HTTP_ANY, "/api/.*");
+      api->setRateLimiter(new HTTP::RateLimiter(0.1, 1));
+      api->addHandler(handler);
+    }
+
+    if (test == "queued")
+      server.setLoadShedder(new HTTP::LoadShedder(0, 2));
+
+    if (test == "lag") server.setLoadShedder(new HTTP::LoadShedder(0.1, 0));
+
+    server.addHandler(handler);
+    server.bind(addr);
+
+    RateClient client(base, addr, test);
+    client.start();
+
+    base.dispatch();
+    client.join();
+
+    cout << "queued=" << server.getQueuedRequests() << endl;
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
@@ -0,0 +1,179 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+#include <cbang/event/Base.h>
+#include <cbang/http/Server.h>
+#include <cbang/http/ResourceHandler.h>
+#include <cbang/util/Resource.h>
+#include <cbang/thread/Thread.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/log/Logger.h>
+
+#include <common/HTTPTestClient.h>
+
+#include <iostream>
+
+#include <signal.h>
+
+using namespace cb;
+using namespace std;
+
+
+// Resources as the resources builder writes them, with fake encoded bodies
+namespace {
+  const char indexData[] = "<html>Index</html>";
+  const char gzipData[]  = "GZIP INDEX";
+  const char lz4Data[]   = "LZ4 INDEX";
+  const char plainData[] = "Plain text";
+
+  FileResource indexGZ("index.html", gzipData, sizeof(gzipData) - 1,
+                       "\"1234-gz\"");
+  FileResource indexLZ4("index.html", lz4Data, sizeof(lz4Data) - 1,
+                        "\"1234-lz4\"");
+  FileResource index("index.html", indexData, sizeof(indexData) - 1,
+                     "\"1234\"", "text/html", &indexGZ, &indexLZ4);
+  FileResource plain("plain.txt", plainData, sizeof(plainData) - 1,
+                     "\"5678\"", "text/plain");
+
+  const Resource *children[] = {&index, &plain, 0};
+  DirectoryResource root("", children);
+}
+
+
+class ResourceClient : public Thread {
+  Event::Base &base;
+  SockAddr addr;
+  string test;
+
+public:
+  ResourceClient(Event::Base &base, const SockAddr &addr,
+                 const string &test) :
+    base(base), addr(addr), test(test) {}
+
+
+  void request(const string &path, const string &headers = "",
+               const string &method = "GET") {
+    auto res = HTTPTest::request(addr, path, headers, method);
+
+    cout << res.code;
+
+    for (auto name: {"Content-Encoding", "Vary", "ETag", "Content-Type"}) {
+      string value = res.get(name);
+      if (!value.empty()) cout << ' ' << name << '=' << value;
+    }
+
+    if (res.code == 200) cout << ' ' << res.body;
+    cout << endl;
+  }
+
+
+  void etag() {
+    request("/index.html");
+    request("/index.html", "If-None-Match: \"1234\"\r\n");
+    request("/index.html", "If-None-Match: W/\"1234\"\r\n");
+    request("/index.html", "If-None-Match: \"abcd\", \"1234\"\r\n");
+    request("/index.html", "If-None-Match: *\r\n");
+    request("/index.html", "If-None-Match: \"abcd\"\r\n");
+    request("/index.html", "If-None-Match: \"1234\"\r\n", "HEAD");
+    request("/index.html", "If-None-Match: \"1234\"\r\n", "POST");
+
+    // Each variant has its own ETag
+    request("/index.html", "Accept-Encoding: gzip\r\n"
+            "If-None-Match: \"1234\"\r\n");
+    request("/index.html", "Accept-Encoding: gzip\r\n"
+            "If-None-Match: \"1234-gz\"\r\n");
+
+    request("/plain.txt", "If-None-Match: \"5678\"\r\n");
+    request("/missing.txt");
+  }
+
+
+  void variants() {
+    for (auto accept: {"", "gzip", "lz4", "gzip, lz4", "gzip;q=0.5, lz4",
+          "lz4;q=0, gzip;q=0.8", "gzip; q=0.2, lz4; q=0.1",
+          "gzip;q=0.5, identity", "identity", "*", "*;q=0.5, lz4;q=0.1",
+          "br", "bzip2, gzip;q=0.5", "GZIP"}) {
+      cout << "accept=" << accept << endl << "  ";
+      request("/index.html", *accept ?
+              SSTR("Accept-Encoding: " << accept << "\r\n") : string());
+    }
+
+    // Resources without variants do not vary
+    request("/plain.txt", "Accept-Encoding: gzip\r\n");
+  }
+
+
+  // From Thread
+  void run() override {
+    try {
+      if (test == "etag") etag();
+      else if (test == "variants") variants();
+      else THROW("Unknown test " << test);
+    } CATCH_ERROR;
+
+    base.loopExit();
+  }
+};
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("bind", "Server listen address and port")
+      ->setDefault("127.0.0.1:8773");
+    cmdLine.add("test", "Test to run")->setDefault("etag");
+    cmdLine.parse(argc, argv);
+
+    SockAddr addr = SockAddr::parse(cmdLine["--bind"]);
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    Event::Base base(true);
+    HTTP::Server server(base);
+    server.addHandler(new HTTP::ResourceHandler(root));
+    server.bind(addr);
+
+    ResourceClient client(base, addr, cmdLine["--test"]);
+    client.start();
+
+    base.dispatch();
+    client.join();
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
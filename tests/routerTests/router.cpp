@@ -0,0 +1,105 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Exception.h>
+#include <cbang/String.h>
+#include <cbang/http/Conn.h>
+#include <cbang/http/HandlerGroup.h>
+#include <cbang/http/MethodMatcher.h>
+#include <cbang/http/URLPatternMatcher.h>
+
+#include <exception>
+#include <iostream>
+
+using namespace cb;
+using namespace cb::HTTP;
+using namespace std;
+
+const unsigned GET    = Method::HTTP_GET;
+const unsigned POST   = Method::HTTP_POST;
+const unsigned DELETE = Method::HTTP_DELETE;
+const unsigned ANY    = Method::HTTP_ANY;
+
+
+RequestHandlerPtr handler(const string &name, bool result = true) {
+  return new RequestFunctionHandler([name, result] (Request &req) {
+    cout << ' ' << name << req.getArgs()->toString();
+    return result;
+  });
+}
+
+
+RequestHandlerPtr url(unsigned methods, const string &pattern,
+                      const RequestHandlerPtr &child) {
+  return new MethodMatcher(methods, new URLPatternMatcher(pattern, child));
+}
+
+
+int main(int argc, char *argv[]) {
+  try {
+    HandlerGroup group;
+
+    group.addHandler(url(GET, "/users/:id", handler("user", false)));
+    group.addHandler(url(GET, "/users/me", handler("me")));
+    group.addHandler(
+      url(GET | POST, "/users/:id/items/", handler("items")));
+    group.addHandler(handler("any", false));
+    group.addHandler(ANY, "/users/[0-9]+", handler("numeric"));
+    group.addHandler(GET, "/static/.*\\.css", handler("css"));
+    group.addHandler(GET, "/v1.0/status", handler("status"));
+    group.addHandler(url(ANY, "/api/:version.+", handler("api")));
+
+    auto sub = group.addGroup(ANY, "/sub/.*", "/sub");
+    sub->addHandler(url(DELETE, "/sub/:name", handler("sub")));
+
+    for (int i = 1; i < argc; i++) {
+      vector<string> parts;
+      String::tokenize(argv[i], parts, " ");
+      if (parts.size() != 2) THROW("Expected <method> <path>");
+
+      Request req(0, Method::parse(parts[0]), parts[1]);
+      cout << argv[i] << " =>";
+      if (!group(req)) cout << " none";
+      cout << endl;
+    }
+
+    return 0;
+
+  } catch (const Exception &e) {
+    cerr << "Exception: " << e << endl;
+
+  } catch (const std::exception &e) {
+    cerr << "std::exception: " << e.what() << endl;
+  }
+
+  return 1;
+}
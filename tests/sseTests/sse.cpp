@@ -0,0 +1,311 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+#include <cbang/event/Base.h>
+#include <cbang/http/Server.h>
+#include <cbang/http/Conn.h>
+#include <cbang/http/EventStream.h>
+#include <cbang/http/EventChannel.h>
+#include <cbang/json/Dict.h>
+#include <cbang/thread/Thread.h>
+#include <cbang/time/Timer.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/log/Logger.h>
+
+#include <common/HTTPTestClient.h>
+
+#include <iostream>
+
+#include <signal.h>
+
+using namespace cb;
+using namespace std;
+
+
+class SSEServer : public HTTP::Server {
+  HTTP::EventChannelPtr channel;
+  unsigned maxQueued;
+  bool disconnect;
+
+public:
+  vector<HTTP::EventStreamPtr> streams;
+
+
+  SSEServer(Event::Base &base, const HTTP::EventChannelPtr &channel,
+            unsigned maxQueued, bool disconnect) :
+    HTTP::Server(base), channel(channel), maxQueued(maxQueued),
+    disconnect(disconnect) {}
+
+
+  // From HTTP::Server
+  SmartPointer<HTTP::Request>
+  createRequest(const SmartPointer<HTTP::Conn> &conn, HTTP::Method method,
+                const URI &uri, const Version &version) override {
+    if (uri.getPath() != "/events")
+      return HTTP::Server::createRequest(conn, method, uri, version);
+
+    HTTP::EventStreamPtr stream =
+      new HTTP::EventStream(conn, method, uri, version);
+    stream->setMaxQueued(maxQueued);
+    stream->setDisconnectSlow(disconnect);
+    streams.push_back(stream);
+
+    return stream;
+  }
+
+
+  // From HTTP::RequestHandler
+  bool operator()(HTTP::Request &req) override {
+    channel->subscribe(SmartPtr(&req.cast<HTTP::EventStream>()));
+    return true;
+  }
+};
+
+
+unsigned countEvents(const string &s) {
+  unsigned count = 0;
+  for (size_t pos = s.find("\n\n"); pos != string::npos;
+       pos = s.find("\n\n", pos + 2)) count++;
+  return count;
+}
+
+
+class Subscriber {
+  HTTPTest::Connection conn;
+  size_t received = 0;
+
+public:
+  Subscriber(const SockAddr &addr, const string &lastID) : conn(addr) {
+    string headers = "Accept: text/event-stream\r\n";
+    if (!lastID.empty()) headers += "Last-Event-ID: " + lastID + "\r\n";
+    conn.write(HTTPTest::format("GET", "/events", headers, "", false));
+  }
+
+
+  // The events received so far without the HTTP headers and chunk framing
+  string getEvents() {
+    const string &input = conn.getInput();
+    size_t start = input.find("\r\n\r\n");
+    if (start == string::npos) return "";
+
+    string events;
+    HTTPTest::Response::dechunk(input.substr(start + 4), events);
+    return events;
+  }
+
+
+  // Reads until @param count more events arrive and returns them
+  string receive(unsigned count) {
+    string events;
+
+    while (true) {
+      events = getEvents().substr(received);
+      if (count <= countEvents(events)) break;
+      if (!conn.fill()) THROW("Stream ended");
+    }
+
+    received += events.length();
+    return events;
+  }
+};
+
+
+class SSEClient : public Thread {
+  Event::Base &base;
+  SockAddr addr;
+  HTTP::EventChannelPtr channel;
+  string test;
+
+public:
+  SSEClient(Event::Base &base, const SockAddr &addr,
+            const HTTP::EventChannelPtr &channel, const string &test) :
+    base(base), addr(addr), channel(channel), test(test) {}
+
+
+  SmartPointer<Subscriber> connect(const string &lastID = "") {
+    return new Subscriber(addr, lastID);
+  }
+
+
+  void waitFor(unsigned subscribers) {
+    for (unsigned i = 0; i < 500; i++) {
+      if (channel->getNumSubscribers() == subscribers) return;
+      Timer::sleep(0.01);
+    }
+
+    THROW("Timed out waiting for " << subscribers << " subscribers");
+  }
+
+
+  void broadcast() {
+    vector<SmartPointer<Subscriber> > subs;
+    for (unsigned i = 0; i < 3; i++) subs.push_back(connect());
+    waitFor(3);
+
+    channel->broadcast("hello");
+    channel->broadcast("two\nlines", "update");
+    JSON::Dict msg;
+    msg.insert("status", "ok");
+    channel->broadcast(msg, "status");
+
+    for (auto &sub: subs) cout << sub->receive(3) << "--" << endl;
+
+    subs.clear();
+    waitFor(0);
+    cout << "subscribers=0" << endl;
+  }
+
+
+  // Broadcasts while earlier events are still being written to subscribers
+  // on the server's connection threads
+  void fanout() {
+    const unsigned count = 20;
+    const unsigned rounds = 50;
+    const unsigned batch = 10;
+
+    vector<SmartPointer<Subscriber> > subs;
+    for (unsigned i = 0; i < count; i++) subs.push_back(connect());
+    waitFor(count);
+
+    string data(4 * 1024, 'x');
+    unsigned id = 0;
+    unsigned errors = 0;
+
+    for (unsigned round = 0; round < rounds; round++) {
+      string expected;
+
+      for (unsigned i = 0; i < batch; i++) {
+        channel->broadcast(data);
+        expected += HTTP::EventStream::format(data, "", ++id);
+      }
+
+      for (auto &sub: subs)
+        if (sub->receive(batch) != expected) errors++;
+    }
+
+    cout << "subscribers=" << count << " events=" << id << " errors="
+         << errors << endl;
+
+    subs.clear();
+    waitFor(0);
+  }
+
+
+  void replay() {
+    for (unsigned i = 1; i <= 5; i++) channel->broadcast(String(i));
+
+    auto sub = connect("2");
+    cout << sub->receive(min(3U, channel->getReplaySize())) << "--" << endl;
+
+    // Continues after the replay without repeating events
+    channel->broadcast("6");
+    cout << sub->receive(1) << "--" << endl;
+  }
+
+
+  void slow() {
+    auto sub = connect();
+    waitFor(1);
+
+    // Never read, the socket buffers fill and events queue on the server
+    string data(16 * 1024, 'x');
+    for (unsigned i = 0; i < 2000; i++) channel->broadcast(data);
+
+    for (unsigned i = 0; i < 500 && channel->getNumSubscribers(); i++)
+      Timer::sleep(0.01);
+
+    cout << "subscribers=" << channel->getNumSubscribers() << endl;
+  }
+
+
+  // From Thread
+  void run() override {
+    try {
+      if (test == "broadcast") broadcast();
+      else if (test == "fanout") fanout();
+      else if (test == "replay") replay();
+      else if (test == "slow") slow();
+      else THROW("Unknown test " << test);
+    } CATCH_ERROR;
+
+    Timer::sleep(0.25); // Let the server drain its queues
+    base.loopExit();
+  }
+};
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("bind", "Server listen address and port")
+      ->setDefault("127.0.0.1:8771");
+    cmdLine.add("test", "Test to run")->setDefault("broadcast");
+    cmdLine.add("threads", "Server event loop threads")->setDefault(1);
+    cmdLine.add("replay", "Number of events kept for replay")
+      ->setDefault(1024);
+    cmdLine.add("max-queued", "Bytes queued for a subscriber")
+      ->setDefault(256 * 1024);
+    cmdLine.add("disconnect", "Disconnect slow subscribers")
+      ->setDefault(false);
+    cmdLine.parse(argc, argv);
+
+    SockAddr addr = SockAddr::parse(cmdLine["--bind"]);
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    Event::Base base(true);
+    HTTP::EventChannelPtr channel =
+      new HTTP::EventChannel(cmdLine["--replay"].toInteger());
+    SSEServer server(base, channel, cmdLine["--max-queued"].toInteger(),
+                     cmdLine["--disconnect"].toBoolean());
+    server.setThreads(cmdLine["--threads"].toInteger());
+    server.bind(addr);
+
+    SSEClient client(base, addr, channel, cmdLine["--test"]);
+    client.start();
+
+    base.dispatch();
+    client.join();
+
+    uint64_t dropped = 0;
+    for (auto &stream: server.streams) dropped += stream->getDropped();
+    cout << "dropped=" << (dropped ? "some" : "none") << endl;
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
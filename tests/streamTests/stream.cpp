@@ -0,0 +1,225 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2021-2024, Cauldron Development  Oy
+                Copyright (c) 2003-2021, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+#include <cbang/event/Base.h>
+#include <cbang/event/Event.h>
+#include <cbang/http/Server.h>
+#include <cbang/http/Request.h>
+#include <cbang/thread/Thread.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/log/Logger.h>
+
+#include <common/HTTPTestClient.h>
+
+#include <iostream>
+
+#include <signal.h>
+
+using namespace cb;
+using namespace std;
+
+
+// Checksums the body as it arrives and pauses after every few parts
+class StreamRequest : public HTTP::Request {
+  SmartPointer<Event::Event> resumeEvent;
+  uint64_t limit;
+
+public:
+  uint64_t bytes = 0;
+  unsigned parts = 0;
+  unsigned maxPart = 0;
+  unsigned pauses = 0;
+  uint32_t sum = 0;
+  bool ended = false;
+
+  StreamRequest(Event::Base &base, const SmartPointer<HTTP::Conn> &conn,
+                HTTP::Method method, const URI &uri,
+                const Version &version, uint64_t limit) :
+    HTTP::Request(conn, method, uri, version),
+    resumeEvent(base.newEvent(this, &StreamRequest::resumeBody, 0)),
+    limit(limit) {
+    setBodyStream(true);
+  }
+
+
+  // From HTTP::Request
+  void onBodyData(Event::Buffer &data) override {
+    string s = data.toString();
+    data.clear();
+
+    for (unsigned char c: s) sum = sum * 31 + c;
+    bytes += s.length();
+    maxPart = max(maxPart, (unsigned)s.length());
+
+    if (limit && limit < bytes)
+      THROWX("Body too large", HTTP_REQUEST_ENTITY_TOO_LARGE);
+
+    if (++parts % 4 == 0) {
+      pauses++;
+      pauseBody();
+      resumeEvent->add(0.001);
+    }
+  }
+
+
+  void onBodyEnd() override {ended = true;}
+};
+
+
+class StreamServer : public HTTP::Server {
+  Event::Base &base;
+  uint64_t limit;
+
+public:
+  StreamServer(Event::Base &base, uint64_t limit) :
+    HTTP::Server(base), base(base), limit(limit) {}
+
+
+  // From HTTP::Server
+  SmartPointer<HTTP::Request>
+  createRequest(const SmartPointer<HTTP::Conn> &conn, HTTP::Method method,
+                const URI &uri, const Version &version) override {
+    if (uri.getPath() == "/stream")
+      return new StreamRequest(base, conn, method, uri, version, limit);
+    return HTTP::Server::createRequest(conn, method, uri, version);
+  }
+
+
+  bool operator()(HTTP::Request &req) override {
+    auto *stream = dynamic_cast<StreamRequest *>(&req);
+
+    if (stream)
+      req.reply(SSTR("bytes=" << stream->bytes << " parts=" << stream->parts
+                     << " max-part=" << stream->maxPart << " pauses="
+                     << stream->pauses << " sum=" << stream->sum
+                     << " ended=" << (stream->ended ? "true" : "false")
+                     << " buffered=" << req.getInputBuffer().getLength()));
+
+    else req.reply(SSTR("buffered=" << req.getInputBuffer().getLength()));
+
+    return true;
+  }
+};
+
+
+// Sends a body of the given size, optionally chunked, then a buffered POST
+class StreamClient : public Thread {
+  Event::Base &base;
+  SockAddr addr;
+  unsigned size;
+  unsigned chunk;
+
+public:
+  vector<string> responses;
+
+  StreamClient(Event::Base &base, const SockAddr &addr, unsigned size,
+               unsigned chunk) :
+    base(base), addr(addr), size(size), chunk(chunk) {}
+
+
+  // From Thread
+  void run() override {
+    try {
+      HTTPTest::Connection conn(addr);
+
+      string body;
+      for (unsigned i = 0; i < size; i++) body += (char)('a' + i % 26);
+
+      if (chunk) {
+        conn.write("POST /stream HTTP/1.1\r\nHost: test\r\n"
+                   "Transfer-Encoding: chunked\r\n\r\n");
+
+        for (unsigned i = 0; i < size; i += chunk) {
+          string part = body.substr(i, chunk);
+          conn.write(String::printf("%x\r\n", (unsigned)part.length()) +
+                     part + "\r\n");
+        }
+
+        conn.write("0\r\n\r\n");
+
+      } else conn.write(HTTPTest::format("POST", "/stream", SSTR(
+            "Content-Length: " << size << "\r\n"), body, false));
+
+      conn.write(HTTPTest::format("POST", "/buffered",
+                                  "Content-Length: 5\r\n", "hello"));
+
+      HTTPTest::Response res;
+      while (conn.readResponse(res))
+        responses.push_back(String(res.code) + " " + res.body);
+    } CATCH_ERROR;
+
+    base.loopExit();
+  }
+};
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("bind", "Server listen address and port")
+      ->setDefault("127.0.0.1:8768");
+    cmdLine.add("size", "Request body size")->setDefault(1000000);
+    cmdLine.add("chunk", "Send the body in chunks of this size, if non-zero")
+      ->setDefault(0);
+    cmdLine.add("buffer", "Server stream buffer size")->setDefault(16384);
+    cmdLine.add("limit", "Reject streamed bodies larger than this, if non-zero")
+      ->setDefault(0);
+    cmdLine.parse(argc, argv);
+
+    SockAddr addr = SockAddr::parse(cmdLine["--bind"]);
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    Event::Base base(true);
+    StreamServer server(base, cmdLine["--limit"].toInteger());
+    server.setStreamBufferSize(cmdLine["--buffer"].toInteger());
+    server.setMaxBodySize(1024);
+    server.bind(addr);
+
+    StreamClient client(base, addr, cmdLine["--size"].toInteger(),
+                        cmdLine["--chunk"].toInteger());
+    client.start();
+
+    base.dispatch();
+    client.join();
+
+    for (auto &response: client.responses) cout << response << endl;
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
@@ -0,0 +1,217 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2003-2024, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+
+#include <cbang/event/Base.h>
+#include <cbang/event/Event.h>
+#include <cbang/http/Server.h>
+#include <cbang/http/Client.h>
+#include <cbang/http/Request.h>
+#include <cbang/net/Socket.h>
+#include <cbang/thread/Thread.h>
+
+#include <cbang/config/CommandLine.h>
+#include <cbang/time/Timer.h>
+#include <cbang/log/Logger.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <deque>
+
+#include <signal.h>
+
+using namespace std;
+using namespace cb;
+
+
+// Measures request latency while another thread opens and closes connections
+// as fast as the target rate allows.  With an unbounded accept loop the
+// server drains the whole backlog before serving established connections.
+class StormServer : public HTTP::Server {
+public:
+  StormServer(Event::Base &base) : HTTP::Server(base) {}
+
+  // From HTTP::Server
+  bool operator()(HTTP::Request &req) override {req.reply("OK"); return true;}
+};
+
+
+class Storm : public Thread {
+  SockAddr addr;
+  unsigned rate;
+  unsigned open;
+  uint64_t connects = 0;
+  double elapsed = 0;
+
+public:
+  Storm(const SockAddr &addr, unsigned rate, unsigned open) :
+    addr(addr), rate(rate), open(open) {}
+
+  double getRate() const {return elapsed ? connects / elapsed : 0;}
+
+
+  // From Thread
+  void run() override {
+    deque<SmartPointer<Socket>> sockets;
+    double start = Timer::now();
+
+    while (!shouldShutdown()) {
+      elapsed = Timer::now() - start;
+
+      if (rate < connects / elapsed) {
+        Timer::sleep(0.0001);
+        continue;
+      }
+
+      try {
+        SmartPointer<Socket> socket = new Socket;
+        socket->open();
+        socket->setBlocking(false);
+        socket->connect(addr);
+        sockets.push_back(socket);
+        connects++;
+      } CATCH_DEBUG(4);
+
+      while (open < sockets.size()) sockets.pop_front();
+    }
+  }
+};
+
+
+class LatencyClient {
+  Event::Base &base;
+  HTTP::Client client;
+  SmartPointer<Event::Event> nextEvent;
+  HTTP::Client::RequestPtr req;
+  URI uri;
+  unsigned count;
+  unsigned failed = 0;
+  double start = 0;
+  vector<double> times;
+
+public:
+  LatencyClient(Event::Base &base, const URI &uri, unsigned count) :
+    base(base), client(base),
+    nextEvent(base.newEvent(this, &LatencyClient::next, 0)), uri(uri),
+    count(count) {}
+
+
+  void next() {
+    if (times.size() + failed == count) return base.loopExit();
+
+    start = Timer::now();
+    req = client.call(uri, HTTP::Method::HTTP_GET, this,
+                      &LatencyClient::response);
+    req->send();
+  }
+
+
+  void response(HTTP::Request &req) {
+    if (req.getResponseCode() == HTTP::Status::HTTP_OK)
+      times.push_back(Timer::now() - start);
+    else failed++;
+
+    nextEvent->activate(); // Don't free the request from its own callback
+  }
+
+
+  void report() {
+    sort(times.begin(), times.end());
+
+    double total = 0;
+    for (auto t: times) total += t;
+
+    auto pct = [this] (double p) {
+      return times.empty() ? 0 : times[(times.size() - 1) * p];
+    };
+
+    cout << "requests=" << times.size() << " failed=" << failed << endl;
+    if (!times.empty())
+      cout << "avg=" << String::printf("%.1fus", total / times.size() * 1e6)
+           << " p50=" << String::printf("%.1fus", pct(0.50) * 1e6)
+           << " p99=" << String::printf("%.1fus", pct(0.99) * 1e6)
+           << " max=" << String::printf("%.1fus", times.back() * 1e6) << endl;
+  }
+};
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0); // Suppress per request logging
+
+    cmdLine.add("bind", "Server listen address and port")
+      ->setDefault("127.0.0.1:8766");
+    cmdLine.add("count", "Number of sequential requests")->setDefault(1000);
+    cmdLine.add("rate", "Target connections per second")->setDefault(50000);
+    cmdLine.add("open", "Connections the storm holds open")->setDefault(1000);
+    cmdLine.add("accept-batch", "Connections accepted per wakeup")
+      ->setDefault(32);
+    cmdLine.add("pool", "FD pool type")->setDefault("");
+    cmdLine.parse(argc, argv);
+
+    string bind = cmdLine["--bind"];
+    unsigned count = cmdLine["--count"].toInteger();
+
+    Event::Base base(true);
+    base.setPoolType(cmdLine["--pool"]);
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    StormServer server(base);
+    server.setConnectionBacklog(4096);
+    server.setAcceptBatch(cmdLine["--accept-batch"].toInteger());
+    server.bind(SockAddr::parse(bind));
+
+    Storm storm(SockAddr::parse(bind), cmdLine["--rate"].toInteger(),
+                cmdLine["--open"].toInteger());
+    storm.start();
+
+    LatencyClient client(base, "http://" + bind + "/", count);
+    client.next();
+
+    base.dispatch();
+
+    storm.stop();
+    storm.join();
+
+    cout << "connect-rate=" << String::printf("%.0f/s", storm.getRate())
+         << endl;
+    client.report();
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
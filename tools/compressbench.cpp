@@ -0,0 +1,165 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2003-2024, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+
+#include <cbang/event/Buffer.h>
+#include <cbang/event/BufferStream.h>
+#include <cbang/event/BufferFilter.h>
+#include <cbang/comp/CompressionFilter.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/time/Timer.h>
+#include <cbang/log/Logger.h>
+
+#include <cbang/boost/StartInclude.h>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <cbang/boost/EndInclude.h>
+
+#include <iostream>
+
+using namespace std;
+using namespace cb;
+
+
+// Compresses the same response body written in handler sized pieces through
+// the iostream filter chain and through Event::BufferFilter.  Single threaded,
+// so the throughput is per core.
+string makeBody(unsigned size) {
+  string body;
+  uint32_t x = 1;
+
+  for (unsigned i = 0; body.length() < size; i++) {
+    x = x * 1103515245 + 12345;
+    body += String::printf("{\"id\": %u, \"name\": \"item-%u\", \"value\": "
+                           "%u, \"active\": %s},\n", i, (x >> 16) % 1000,
+                           x % 100000, (x & 1) ? "true" : "false");
+  }
+
+  return body.substr(0, size);
+}
+
+
+double streamPath(Compression compression, const string &body,
+                  unsigned writeSize, unsigned &outSize) {
+  double start = Timer::now();
+  Event::Buffer out;
+
+  {
+    Event::BufferStream<> target(out);
+    io::filtering_ostream stream;
+    pushCompression(compression, stream);
+    stream.push(target);
+
+    for (unsigned i = 0; i < body.length(); i += writeSize)
+      stream.write(body.data() + i,
+                   min(writeSize, (unsigned)body.length() - i));
+  }
+
+  outSize = out.getLength();
+  return Timer::now() - start;
+}
+
+
+double bufferPath(Compression compression, int level, const string &body,
+                  unsigned writeSize, unsigned &outSize) {
+  Event::Buffer in;
+  for (unsigned i = 0; i < body.length(); i += writeSize)
+    in.add(body.data() + i, min(writeSize, (unsigned)body.length() - i));
+
+  double start = Timer::now();
+  Event::Buffer out;
+
+  auto filter = Event::BufferFilter::compressor(compression, level);
+  filter->filter(in, out);
+  filter->finish(out);
+
+  double time = Timer::now() - start;
+  outSize = out.getLength();
+
+  // Check the round trip
+  Event::Buffer result;
+  auto inflate = Event::BufferFilter::decompressor(compression);
+  inflate->filter(out, result);
+  if (result.toString() != body) THROW(compression << " round trip failed");
+
+  return time;
+}
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("size", "Response body size in bytes")
+      ->setDefault(16 * 1024 * 1024);
+    cmdLine.add("write-size", "Bytes per write to the response")
+      ->setDefault(4096);
+    cmdLine.add("level", "BufferFilter compression level, negative selects "
+                "the default")->setDefault(-1);
+    cmdLine.add("rounds", "Number of times to compress the body")
+      ->setDefault(3);
+    cmdLine.parse(argc, argv);
+
+    unsigned size = cmdLine["--size"].toInteger();
+    unsigned writeSize = cmdLine["--write-size"].toInteger();
+    int level = cmdLine["--level"].toInteger();
+    unsigned rounds = cmdLine["--rounds"].toInteger();
+
+    string body = makeBody(size);
+    double mb = (double)body.length() * rounds / (1 << 20);
+
+    for (auto compression:
+           {Compression::COMPRESSION_GZIP, Compression::COMPRESSION_ZLIB,
+            Compression::COMPRESSION_BZIP2, Compression::COMPRESSION_LZ4}) {
+      double streamTime = 0;
+      double bufferTime = 0;
+      unsigned streamSize = 0;
+      unsigned bufferSize = 0;
+
+      for (unsigned i = 0; i < rounds; i++) {
+        streamTime += streamPath(compression, body, writeSize, streamSize);
+        bufferTime +=
+          bufferPath(compression, level, body, writeSize, bufferSize);
+      }
+
+      string name = String::toLower(Compression(compression).toString());
+      cout << String::printf("%-6s stream=%.1fMB/s (%u) buffer=%.1fMB/s (%u)",
+                             name.c_str(), mb / streamTime, streamSize,
+                             mb / bufferTime, bufferSize) << endl;
+    }
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
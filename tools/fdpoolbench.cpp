@@ -0,0 +1,264 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2003-2024, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+
+#include <cbang/event/Base.h>
+#include <cbang/event/Event.h>
+#include <cbang/event/FD.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/time/Timer.h>
+#include <cbang/log/Logger.h>
+#include <cbang/os/SysError.h>
+
+#include <iostream>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace cb;
+
+
+// Measures FD pool overhead with many idle connections that have read
+// timeouts pending.  Active connections do single byte round-trips through
+// the pool while the rest wait.  Commands are processed in order so a
+// completed round-trip also means all earlier commands were processed.
+//
+// With several active connections commands are queued while the pool thread
+// is busy with earlier wakeups.  A lost wakeup shows up as round-trips which
+// take as long as the pool's 100ms wait timeout.
+class PoolBench {
+  Event::Base &base;
+  unsigned count;
+  unsigned rounds;
+  unsigned timeout;
+
+  vector<SmartPointer<Event::FD> > idle;
+  vector<int> peers;
+
+  struct Active {
+    SmartPointer<Event::FD> fd;
+    int peer = -1;
+    unsigned rounds = 0;
+    double sent = 0;
+  };
+
+  vector<Active> actives;
+  unsigned running = 0;
+  SmartPointer<Event::Event> nextEvent;
+  SmartPointer<Event::Event> stallEvent;
+
+  enum {SETUP, PING, TEARDOWN, DONE} state = SETUP;
+  double start = 0;
+  double maxRoundTrip = 0;
+  unsigned stalls = 0;
+
+public:
+  PoolBench(Event::Base &base, unsigned count, unsigned active,
+            unsigned rounds, unsigned timeout) :
+    base(base), count(count), rounds(rounds), timeout(timeout),
+    actives(active), nextEvent(base.newEvent(this, &PoolBench::next, 0)),
+    stallEvent(base.newEvent(this, &PoolBench::stalled, 0)) {}
+
+
+  ~PoolBench() {
+    for (auto fd: peers) ::close(fd);
+    for (auto &a: actives) if (a.peer != -1) ::close(a.peer);
+  }
+
+
+  void socketPair(int &a, int &b) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv))
+      THROW("socketpair() failed: " << SysError());
+    a = sv[0];
+    b = sv[1];
+  }
+
+
+  void setup() {
+    vector<int> fds(count);
+    peers.resize(count);
+    for (unsigned i = 0; i < count; i++) socketPair(fds[i], peers[i]);
+
+    vector<int> activeFDs(actives.size());
+    for (unsigned i = 0; i < actives.size(); i++)
+      socketPair(activeFDs[i], actives[i].peer);
+
+    start = Timer::now();
+
+    for (unsigned i = 0; i < count; i++) {
+      SmartPointer<Event::FD> efd = new Event::FD(base, fds[i]);
+      efd->setReadTimeout(timeout);
+      efd->read([] (bool success) {}, Event::Buffer(), 1);
+      idle.push_back(efd);
+    }
+
+    for (unsigned i = 0; i < actives.size(); i++) {
+      actives[i].fd = new Event::FD(base, activeFDs[i]);
+      actives[i].fd->setReadTimeout(timeout);
+    }
+
+    stallEvent->add(60);
+    pingAll();
+  }
+
+
+  void pingAll() {
+    running = actives.size();
+    for (auto &a: actives) ping(a);
+  }
+
+
+  void ping(Active &a) {
+    a.sent = Timer::now();
+
+    a.fd->read([this, &a] (bool success) {
+      if (!success) THROW("Read failed");
+      pong(a);
+    }, Event::Buffer(), 1);
+
+    if (::write(a.peer, "x", 1) != 1)
+      THROW("write() failed: " << SysError());
+  }
+
+
+  void pong(Active &a) {
+    if (state == PING) {
+      double roundTrip = Timer::now() - a.sent;
+      if (maxRoundTrip < roundTrip) maxRoundTrip = roundTrip;
+      if (0.05 < roundTrip) stalls++;
+
+      stallEvent->add(60);
+      if (++a.rounds < rounds) return ping(a);
+    }
+
+    if (!--running) nextEvent->activate();
+  }
+
+
+  void report(const string &name, double secs, unsigned ops) {
+    cout << name << "=" << String::printf("%.2fus", secs / ops * 1e6)
+         << endl;
+  }
+
+
+  void stalled() {
+    LOG_ERROR("No progress for 60 seconds");
+    base.loopExit();
+  }
+
+
+  void next() {
+    double now = Timer::now();
+
+    switch (state) {
+    case SETUP:
+      report("setup", now - start, count);
+      state = PING;
+      start = now;
+      break;
+
+    case PING:
+      report("round-trip", now - start, rounds * actives.size());
+      report("max-round-trip", maxRoundTrip, 1);
+      cout << "stalls=" << stalls << endl;
+
+      state = TEARDOWN;
+      start = now;
+      for (auto &fd: idle) fd->close();
+      break;
+
+    case TEARDOWN:
+      report("teardown", now - start, count);
+      state = DONE;
+      stallEvent->del();
+      return base.loopExit();
+
+    case DONE: return;
+    }
+
+    pingAll();
+  }
+};
+
+
+void raiseFDLimit(unsigned count) {
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit)) return;
+
+  rlim_t want = 2 * (rlim_t)count + 1024;
+  if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < want)
+    want = limit.rlim_max;
+
+  if (limit.rlim_cur < want) {
+    limit.rlim_cur = want;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("count", "Number of idle connections")->setDefault(100000);
+    cmdLine.add("active", "Number of connections doing round-trips at once")
+      ->setDefault(1);
+    cmdLine.add("rounds", "Number of round-trips on each active connection")
+      ->setDefault(10000);
+    cmdLine.add("timeout", "Read timeout in seconds")->setDefault(3600);
+    cmdLine.add("pool", "FD pool type")->setDefault("");
+    cmdLine.parse(argc, argv);
+
+    unsigned count = cmdLine["--count"].toInteger();
+    raiseFDLimit(count);
+
+    Event::Base base(true);
+    base.setPoolType(cmdLine["--pool"]);
+
+    PoolBench bench(base, count, cmdLine["--active"].toInteger(),
+                    cmdLine["--rounds"].toInteger(),
+                    cmdLine["--timeout"].toInteger());
+    bench.setup();
+
+    base.dispatch();
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
@@ -0,0 +1,171 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2003-2024, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+
+#include <cbang/event/Base.h>
+#include <cbang/event/Event.h>
+#include <cbang/http/Server.h>
+#include <cbang/http/Client.h>
+#include <cbang/http/Request.h>
+
+#include <cbang/config/CommandLine.h>
+#include <cbang/time/Timer.h>
+#include <cbang/log/Logger.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <signal.h>
+
+using namespace std;
+using namespace cb;
+
+
+// Measures sequential request/response round-trips against a quiet server.
+// Without an immediate wakeup of the epoll thread each round-trip waits on
+// the epoll_wait() timeout.
+class LatencyServer : public HTTP::Server {
+public:
+  LatencyServer(Event::Base &base) : HTTP::Server(base) {}
+
+  // From HTTP::Server
+  bool operator()(HTTP::Request &req) override {req.reply("OK"); return true;}
+};
+
+
+class LatencyClient {
+  Event::Base &base;
+  HTTP::Client client;
+  SmartPointer<RateSet> stats = new RateSet;
+  SmartPointer<Event::Event> nextEvent;
+  HTTP::Client::RequestPtr req;
+  URI uri;
+  unsigned count;
+  unsigned failed = 0;
+  double start = 0;
+  vector<double> times;
+
+public:
+  LatencyClient(Event::Base &base, const URI &uri, unsigned count,
+                unsigned maxIdle) :
+    base(base), client(base),
+    nextEvent(base.newEvent(this, &LatencyClient::next, 0)), uri(uri),
+    count(count) {
+    client.setStats(stats);
+    client.setMaxIdle(maxIdle);
+  }
+
+
+  void next() {
+    if (times.size() + failed == count) return report();
+
+    start = Timer::now();
+    req = client.call(uri, HTTP::Method::HTTP_GET, this,
+                      &LatencyClient::response);
+    req->send();
+  }
+
+
+  void response(HTTP::Request &req) {
+    if (req.getResponseCode() == HTTP::Status::HTTP_OK)
+      times.push_back(Timer::now() - start);
+    else failed++;
+
+    nextEvent->activate(); // Don't free the request from its own callback
+  }
+
+
+  void report() {
+    sort(times.begin(), times.end());
+
+    double total = 0;
+    for (auto t: times) total += t;
+
+    auto pct = [this] (double p) {
+      return times.empty() ? 0 : times[(times.size() - 1) * p];
+    };
+
+    double reused =
+      stats->has("pool-reused") ? stats->getRate("pool-reused").getTotal() : 0;
+
+    cout << "requests=" << times.size() << " failed=" << failed
+         << " reused=" << reused << endl;
+    if (!times.empty())
+      cout << "avg=" << String::printf("%.1fus", total / times.size() * 1e6)
+           << " p50=" << String::printf("%.1fus", pct(0.50) * 1e6)
+           << " p99=" << String::printf("%.1fus", pct(0.99) * 1e6)
+           << " max=" << String::printf("%.1fus", times.back() * 1e6) << endl;
+
+    base.loopExit();
+  }
+};
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0); // Suppress per request logging
+
+    cmdLine.add("bind", "Server listen address and port")
+      ->setDefault("127.0.0.1:8765");
+    cmdLine.add("count", "Number of sequential requests")->setDefault(100);
+    cmdLine.add("pool", "FD pool type")->setDefault("");
+    cmdLine.add("threads", "Server event loop threads")->setDefault(1);
+    cmdLine.add("max-idle", "Client idle connection pool size")
+      ->setDefault(64);
+    cmdLine.parse(argc, argv);
+
+    string bind = cmdLine["--bind"];
+    unsigned count = cmdLine["--count"].toInteger();
+
+    Event::Base base(true);
+    base.setPoolType(cmdLine["--pool"]);
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    LatencyServer server(base);
+    server.setThreads(cmdLine["--threads"].toInteger());
+    server.bind(SockAddr::parse(bind));
+
+    LatencyClient client(base, "http://" + bind + "/", count,
+                         cmdLine["--max-idle"].toInteger());
+    client.next();
+
+    base.dispatch();
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
@@ -0,0 +1,97 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2003-2024, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+
+#include <cbang/event/TransferRead.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/time/Timer.h>
+#include <cbang/log/Logger.h>
+
+#include <iostream>
+
+using namespace std;
+using namespace cb;
+
+
+// Feeds an HTTP header block to a TransferRead in fixed size increments,
+// as a slow client would, until the "\r\n\r\n" delimiter is found.
+double readHeader(const string &header, unsigned increment) {
+  Event::Buffer input;
+  Event::TransferRead tran(-1, 0, 0, Event::Buffer(), header.length() + 1,
+                           "\r\n\r\n");
+
+  double start = Timer::now();
+
+  for (unsigned offset = 0; !tran.isFinished(); offset += increment) {
+    if (header.length() <= offset) THROW("Delimiter not found");
+    unsigned bytes = min(increment, (unsigned)header.length() - offset);
+    input.add(header.data() + offset, bytes);
+    tran.transferFrom(input, false);
+  }
+
+  return Timer::now() - start;
+}
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("size", "Header block size in bytes")->setDefault(64 * 1024);
+    cmdLine.add("rounds", "Number of times to read the header")
+      ->setDefault(10);
+    cmdLine.parse(argc, argv);
+
+    unsigned size = cmdLine["--size"].toInteger();
+    unsigned rounds = cmdLine["--rounds"].toInteger();
+
+    string header = "GET / HTTP/1.1\r\n";
+    for (unsigned i = 0; header.length() < size - 2; i++)
+      header += String::printf("X-Header-%u: %032u\r\n", i, i);
+    header = header.substr(0, size - 4) + "\r\n\r\n";
+
+    for (unsigned increment: {1, 1500}) {
+      double total = 0;
+      for (unsigned i = 0; i < rounds; i++)
+        total += readHeader(header, increment);
+
+      cout << "increment=" << increment << " time="
+           << String::printf("%.3fms", total / rounds * 1e3) << endl;
+    }
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
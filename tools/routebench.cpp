@@ -0,0 +1,134 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2003-2024, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+
+#include <cbang/http/Conn.h>
+#include <cbang/http/HandlerGroup.h>
+#include <cbang/http/MethodMatcher.h>
+#include <cbang/http/URLPatternMatcher.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/time/Timer.h>
+#include <cbang/log/Logger.h>
+
+#include <iostream>
+
+using namespace std;
+using namespace cb;
+using namespace cb::HTTP;
+
+
+RequestHandlerPtr endpoint(unsigned methods, const string &pattern) {
+  auto handler = new RequestFunctionHandler([] (Request &) {return true;});
+  return new MethodMatcher(methods, new URLPatternMatcher(pattern, handler));
+}
+
+
+// Endpoints nested the way API::createAPIHandler() builds them
+SmartPointer<HandlerGroup> apiGroup(unsigned groups, unsigned endpoints) {
+  SmartPointer<HandlerGroup> root = new HandlerGroup;
+
+  for (unsigned i = 0; i < groups; i++) {
+    string prefix = String::printf("/api/resource%u", i);
+    SmartPointer<HandlerGroup> children = new HandlerGroup;
+
+    for (unsigned j = 0; j < endpoints; j++)
+      children->addHandler(endpoint(Method::HTTP_GET | Method::HTTP_PUT,
+                                    prefix + String::printf("/:id/item%u", j)));
+
+    root->addHandler(new URLPatternMatcher(prefix + ".+", children));
+  }
+
+  return root;
+}
+
+
+SmartPointer<HandlerGroup> flatGroup(unsigned count) {
+  SmartPointer<HandlerGroup> group = new HandlerGroup;
+
+  for (unsigned i = 0; i < count; i++)
+    group->addHandler(
+      endpoint(Method::HTTP_GET, String::printf("/api/endpoint%u/:id", i)));
+
+  return group;
+}
+
+
+double run(HandlerGroup &group, const string &path, unsigned count) {
+  double start = Timer::now();
+
+  for (unsigned i = 0; i < count; i++) {
+    Request req(0, Method::HTTP_GET, URI(path));
+    if (!group(req)) THROW("No route for " << path);
+  }
+
+  return Timer::now() - start;
+}
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("count", "Number of requests to route per test")
+      ->setDefault(20000);
+    cmdLine.parse(argc, argv);
+
+    unsigned count = cmdLine["--count"].toInteger();
+
+    auto flat = flatGroup(400);
+    auto api = apiGroup(20, 20);
+
+    struct {
+      const char *name;
+      HandlerGroup &group;
+      const char *path;
+    } tests[] = {
+      {"flat-first", *flat, "/api/endpoint0/42"},
+      {"flat-last",  *flat, "/api/endpoint399/42"},
+      {"api-first",  *api,  "/api/resource0/42/item0"},
+      {"api-last",   *api,  "/api/resource19/42/item19"},
+    };
+
+    for (auto &test: tests) {
+      double t = run(test.group, test.path, count);
+      cout << test.name << ' '
+           << String::printf("%.2fus/req", t / count * 1e6) << endl;
+    }
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
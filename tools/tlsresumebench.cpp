@@ -0,0 +1,203 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2003-2024, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+
+#include <cbang/event/Base.h>
+#include <cbang/event/Event.h>
+#include <cbang/http/Server.h>
+#include <cbang/http/Client.h>
+#include <cbang/http/Request.h>
+#include <cbang/openssl/SSLContext.h>
+#include <cbang/openssl/KeyPair.h>
+#include <cbang/openssl/Certificate.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/time/Timer.h>
+#include <cbang/log/Logger.h>
+
+#include <iostream>
+
+#include <signal.h>
+
+using namespace std;
+using namespace cb;
+
+
+// Opens a new HTTPS connection for each sequential request and counts how
+// many of the TLS handshakes resumed a previous session.
+class ResumeServer : public HTTP::Server {
+public:
+  ResumeServer(Event::Base &base, const SmartPointer<SSLContext> &sslCtx) :
+    HTTP::Server(base, sslCtx) {}
+
+  // From HTTP::Server
+  bool operator()(HTTP::Request &req) override {req.reply("OK"); return true;}
+};
+
+
+class ResumeClient {
+  Event::Base &base;
+  HTTP::Client client;
+  SmartPointer<RateSet> stats = new RateSet;
+  SmartPointer<Event::Event> nextEvent;
+  HTTP::Client::RequestPtr req;
+  URI uri;
+  unsigned count;
+  unsigned requests = 0;
+  unsigned failed = 0;
+  double start = Timer::now();
+
+public:
+  ResumeClient(Event::Base &base, const SmartPointer<SSLContext> &sslCtx,
+               const URI &uri, unsigned count) :
+    base(base), client(base, sslCtx),
+    nextEvent(base.newEvent(this, &ResumeClient::next, 0)), uri(uri),
+    count(count) {
+    client.setStats(stats);
+    client.setMaxIdle(0); // Reconnect for every request
+  }
+
+
+  const SmartPointer<RateSet> &getStats() const {return stats;}
+
+
+  void next() {
+    if (requests + failed == count) return base.loopExit();
+
+    req = client.call(uri, HTTP::Method::HTTP_GET, this,
+                      &ResumeClient::response);
+    req->send();
+  }
+
+
+  void response(HTTP::Request &req) {
+    if (req.getResponseCode() == HTTP::Status::HTTP_OK) requests++;
+    else failed++;
+
+    nextEvent->activate(); // Don't free the request from its own callback
+  }
+
+
+  void report(const string &name, const RateSet &stats) {
+    auto total = [&stats] (const string &key) {
+      return stats.has(key) ? stats.getRate(key).getTotal() : 0;
+    };
+
+    double handshakes = total("tls-handshake");
+    double resumed = total("tls-resumed");
+
+    cout << name << ": handshakes=" << handshakes << " resumed=" << resumed
+         << " full=" << handshakes - resumed;
+    if (handshakes)
+      cout << String::printf(" rate=%.1f%%", resumed / handshakes * 100);
+    cout << endl;
+
+    double time = total("tls-handshake-time");
+    double wait = total("tls-handshake-wait");
+    if (handshakes && time)
+      cout << name << String::printf(": handshake=%.1fus wait=%.1fus",
+                                     time / handshakes * 1e6,
+                                     wait / handshakes * 1e6) << endl;
+  }
+
+
+  void report(const RateSet &serverStats) {
+    double elapsed = Timer::now() - start;
+
+    cout << "requests=" << requests << " failed=" << failed
+         << String::printf(" avg=%.1fus", elapsed / count * 1e6) << endl;
+    report("client", *stats);
+    report("server", serverStats);
+  }
+};
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0); // Suppress per request logging
+
+    cmdLine.add("bind", "Server listen address and port")
+      ->setDefault("127.0.0.1:8766");
+    cmdLine.add("count", "Number of sequential connections")->setDefault(500);
+    cmdLine.add("tickets", "Enable session tickets")->setDefault(true);
+    cmdLine.add("rotation", "Ticket key rotation in seconds")
+      ->setDefault(3600);
+    cmdLine.add("client-sessions", "Client session store size, zero disables "
+                "resumption")->setDefault(1024);
+    cmdLine.add("handshake-threads", "Server TLS handshake threads, zero "
+                "runs handshakes inline")->setDefault(0);
+    cmdLine.parse(argc, argv);
+
+    string bind = cmdLine["--bind"];
+    unsigned count = cmdLine["--count"].toInteger();
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    KeyPair key;
+    key.generateRSA(2048);
+
+    Certificate cert;
+    cert.setPublicKey(key);
+    cert.addNameEntry("CN", "localhost");
+    cert.setIssuer(cert);
+    cert.setNotBefore();
+    cert.setNotAfter(3600);
+    cert.sign(key);
+
+    SmartPointer<SSLContext> serverCtx = new SSLContext;
+    serverCtx->useCertificate(cert);
+    serverCtx->usePrivateKey(key);
+    serverCtx->setSessionTickets(cmdLine["--tickets"].toBoolean());
+    serverCtx->setTicketKeyRotation(cmdLine["--rotation"].toInteger());
+
+    SmartPointer<SSLContext> clientCtx = new SSLContext;
+    clientCtx->setMaxClientSessions(cmdLine["--client-sessions"].toInteger());
+
+    Event::Base base(true);
+
+    ResumeServer server(base, serverCtx);
+    SmartPointer<RateSet> serverStats = new RateSet;
+    server.setStats(serverStats);
+    server.setHandshakeThreads(cmdLine["--handshake-threads"].toInteger());
+    server.bind(SockAddr::parse(bind), serverCtx);
+
+    ResumeClient client(base, clientCtx, "https://" + bind + "/", count);
+    client.next();
+
+    base.dispatch();
+    client.report(*serverStats);
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}
@@ -0,0 +1,228 @@
+/******************************************************************************\
+
+          This file is part of the C! library.  A.K.A the cbang library.
+
+                Copyright (c) 2003-2024, Cauldron Development LLC
+                               All rights reserved.
+
+         The C! library is free software: you can redistribute it and/or
+        modify it under the terms of the GNU Lesser General Public License
+       as published by the Free Software Foundation, either version 2.1 of
+               the License, or (at your option) any later version.
+
+        The C! library is distributed in the hope that it will be useful,
+          but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+                 Lesser General Public License for more details.
+
+         You should have received a copy of the GNU Lesser General Public
+                 License along with the C! library.  If not, see
+                         <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+           You may request written permission by emailing the authors.
+
+                  For information regarding this software email:
+                                 Joseph Coffland
+                          joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include <cbang/Catch.h>
+#include <cbang/String.h>
+
+#include <cbang/event/TransferWrite.h>
+#include <cbang/openssl/SSL.h>
+#include <cbang/openssl/SSLContext.h>
+#include <cbang/openssl/KeyPair.h>
+#include <cbang/openssl/Certificate.h>
+#include <cbang/config/CommandLine.h>
+#include <cbang/time/Timer.h>
+#include <cbang/log/Logger.h>
+#include <cbang/os/SysError.h>
+
+#include <openssl/ssl.h>
+
+#include <iostream>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace cb;
+
+
+// Sends JSON API style responses, assembled from many small buffers, through
+// TransferWrite over TLS and counts the TLS records that reach the socket.
+class TLSWriteBench {
+  unsigned recordSize;
+  bool dynamic;
+
+  int fds[2];
+  SmartPointer<cb::SSL> server;
+  SmartPointer<cb::SSL> client;
+
+  string pending;
+  uint64_t records = 0;
+  uint64_t wireBytes = 0;
+
+public:
+  TLSWriteBench(unsigned recordSize, bool dynamic) :
+    recordSize(recordSize), dynamic(dynamic) {
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+                   fds))
+      THROW("socketpair() failed: " << SysError());
+  }
+
+
+  ~TLSWriteBench() {
+    server.release();
+    client.release();
+    ::close(fds[0]);
+    ::close(fds[1]);
+  }
+
+
+  void handshake() {
+    KeyPair key;
+    key.generateRSA(2048);
+
+    Certificate cert;
+    cert.setPublicKey(key);
+    cert.addNameEntry("CN", "localhost");
+    cert.setIssuer(cert);
+    cert.setNotBefore();
+    cert.setNotAfter(3600);
+    cert.sign(key);
+
+    SSLContext serverCtx;
+    serverCtx.useCertificate(cert);
+    serverCtx.usePrivateKey(key);
+    serverCtx.setMaxRecordSize(recordSize);
+    serverCtx.setDynamicRecords(dynamic);
+
+    SSLContext clientCtx;
+
+    server = serverCtx.createSSL();
+    server->setFD(fds[0]);
+    server->accept();
+
+    client = clientCtx.createSSL();
+    client->setFD(fds[1]);
+    client->connect();
+
+    for (unsigned i = 0; i < 100; i++) {
+      if (SSL_is_init_finished(server->getSSL()) &&
+          SSL_is_init_finished(client->getSSL())) break;
+
+      server->write(0, 0);
+      client->write(0, 0);
+    }
+
+    if (!SSL_is_init_finished(server->getSSL())) THROW("Handshake failed");
+
+    // Discard anything sent with the handshake
+    drain();
+    pending.clear();
+    records = wireBytes = 0;
+  }
+
+
+  void drain() {
+    char buf[64 * 1024];
+
+    while (true) {
+      ssize_t ret = ::read(fds[1], buf, sizeof(buf));
+      if (ret <= 0) break;
+      pending.append(buf, ret);
+    }
+
+    // Count complete records
+    while (5 <= pending.length()) {
+      unsigned length = ((uint8_t)pending[3] << 8) | (uint8_t)pending[4];
+      if (pending.length() < length + 5) break;
+
+      records++;
+      wireBytes += length + 5;
+      pending.erase(0, length + 5);
+    }
+  }
+
+
+  Event::Buffer buildResponse(unsigned fragments) {
+    Event::Buffer response;
+    response.add("{\"items\":[");
+
+    for (unsigned i = 0; i < fragments; i++) {
+      Event::Buffer fragment;
+      fragment.add(String::printf("{\"id\":%u,\"name\":\"item-%u\","
+                                  "\"value\":%u}", i, i, i * 7));
+      if (i) response.add(",");
+      response.add(fragment);
+    }
+
+    response.add("]}");
+
+    return response;
+  }
+
+
+  void send(const Event::Buffer &response) {
+    Event::TransferWrite tran(fds[0], server, 0, response);
+
+    while (!tran.isFinished()) {
+      if (tran.transfer() < 0) THROW("Write failed");
+      drain();
+    }
+  }
+
+
+  void run(unsigned fragments, unsigned responses) {
+    handshake();
+
+    uint64_t payload = 0;
+    double total = 0;
+
+    for (unsigned i = 0; i < responses; i++) {
+      Event::Buffer response = buildResponse(fragments);
+      payload += response.getLength();
+
+      double start = Timer::now();
+      send(response);
+      total += Timer::now() - start;
+    }
+
+    cout << "payload=" << payload / responses
+         << " records=" << String::printf("%.1f", (double)records / responses)
+         << " wire=" << wireBytes / responses
+         << " time=" << String::printf("%.2fus", total / responses * 1e6)
+         << endl;
+  }
+};
+
+
+int main(int argc, char *argv[]) {
+  try {
+    CommandLine cmdLine;
+    Logger::instance().setVerbosity(0);
+
+    cmdLine.add("fragments", "Number of buffers in each response")
+      ->setDefault(500);
+    cmdLine.add("responses", "Number of responses to send")->setDefault(1000);
+    cmdLine.add("record-size", "Maximum TLS record size")
+      ->setDefault(16 * 1024);
+    cmdLine.add("dynamic", "Use dynamic record sizing")->setDefault(false);
+    cmdLine.parse(argc, argv);
+
+    TLSWriteBench bench(cmdLine["--record-size"].toInteger(),
+                        cmdLine["--dynamic"].toBoolean());
+    bench.run(cmdLine["--fragments"].toInteger(),
+              cmdLine["--responses"].toInteger());
+
+    return 0;
+  } CATCH_ERROR;
+
+  return 1;
+}